@@ -24,6 +24,7 @@
 #define BITARRAY_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 // ********************************* Types **********************************
@@ -31,6 +32,12 @@
 // Abstract data type representing an array of bits.
 typedef struct bitarray bitarray_t;
 
+// Abstract data type owning reusable scratch memory for the bitarray
+// algorithms. Scratch only ever grows, so repeated operations through the
+// same context stop allocating once it has reached its high-water mark. A
+// context must not be used by two threads at once.
+typedef struct bitarray_ctx bitarray_ctx_t;
+
 // ******************************* Prototypes *******************************
 
 /**
@@ -109,4 +116,81 @@ void bitarray_rotate(bitarray_t* const bitarray,
                      const size_t bit_length,
                      const ssize_t bit_right_amount);
 
+/**
+ * @brief Allocates a context with no scratch memory.
+ *
+ * @return Pointer to the context; NULL if memory could not be allocated.
+ */
+bitarray_ctx_t* bitarray_ctx_new();
+
+/**
+ * @brief Frees a context allocated by bitarray_ctx_new, along with its
+ * scratch memory.
+ *
+ * @param ctx Pointer to a context.
+ */
+void bitarray_ctx_free(bitarray_ctx_t* const ctx);
+
+/**
+ * @brief Rotates a subarray, borrowing any scratch memory from ctx.
+ *
+ * Same as bitarray_rotate, which uses a context private to the calling
+ * thread. Only the AB and cyclic strategies use the context (see
+ * BITARRAY_ROTATE_STRATEGY in bitarray.c).
+ *
+ * @param ctx Pointer to a context; may be NULL, in which case a strategy that
+ * needs scratch memory falls back to rotating bit by bit.
+ * @param bit_offset Index of the start of the subarray.
+ * @param bit_length Length of the subarray, in bits.
+ * @param bit_right_amount Number of places to rotate the subarray right.
+ */
+void bitarray_rotate_ctx(bitarray_ctx_t* const ctx,
+                         bitarray_t* const bitarray,
+                         const size_t bit_offset,
+                         const size_t bit_length,
+                         const ssize_t bit_right_amount);
+
+/**
+ * @brief Finds the first occurrence of a bit pattern in a bitarray.
+ *
+ * Bit i of the pattern (counting from the least significant bit) is compared
+ * against bit (index + i) of the bitarray. Hence a bitstring such as "1101" is
+ * encoded as the pattern 0b1011 with pattern_len 4.
+ *
+ * @param bitarray Pointer to a bitarray.
+ * @param bit_offset Index at which to start searching (inclusive).
+ * @param pattern Bits to search for, stored in the low pattern_len bits.
+ * @param pattern_len Length of the pattern, in bits; must be in [1, 64].
+ * @return Index of the first match at or after bit_offset; -1 if none exists.
+ *
+ * @example Let ba be a bitarray containing the bits 10010110; then,
+ * bitarray_find_pattern(ba, 0, 0b10, 2) searches for the bitstring "01" and
+ * returns 2. bitarray_find_pattern(ba, 3, 0b10, 2) returns 4.
+ */
+ssize_t bitarray_find_pattern(const bitarray_t* const bitarray,
+                              const size_t bit_offset,
+                              const uint64_t pattern,
+                              const size_t pattern_len);
+
+/**
+ * @brief Finds all (possibly overlapping) occurrences of a bit pattern.
+ *
+ * Matches are encoded as in bitarray_find_pattern. Passing NULL for matches
+ * (with max_matches = 0) simply counts the number of occurrences.
+ *
+ * @param bitarray Pointer to a bitarray.
+ * @param bit_offset Index at which to start searching (inclusive).
+ * @param pattern Bits to search for, stored in the low pattern_len bits.
+ * @param pattern_len Length of the pattern, in bits; must be in [1, 64].
+ * @param matches Output array of match indices, in increasing order.
+ * @param max_matches Capacity of the matches array.
+ * @return Total number of matches; only the first max_matches are stored.
+ */
+size_t bitarray_find_pattern_all(const bitarray_t* const bitarray,
+                                 const size_t bit_offset,
+                                 const uint64_t pattern,
+                                 const size_t pattern_len,
+                                 size_t* const matches,
+                                 const size_t max_matches);
+
 #endif  // BITARRAY_H
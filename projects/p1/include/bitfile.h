@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2012 MIT License by 6.172 Staff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+// Out-of-core operations on bit arrays stored in files, for arrays too large
+// to load into memory. A file holds bits in the same packed form as a
+// bitarray_t: bit i is bit (i mod 8) of byte floor(i/8).
+
+#ifndef BITFILE_H
+#define BITFILE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+
+// ********************************* Macros *********************************
+
+// Buffer memory used when the caller does not specify a cap, in bytes.
+#define BITFILE_DEFAULT_MEMORY_CAP (64u * 1024 * 1024)
+
+// Smallest buffer memory a rotation will run with, in bytes.
+#define BITFILE_MIN_MEMORY_CAP (8u * 512)
+
+
+// ********************************* Types **********************************
+
+// Progress of a rotation. Both counters are updated while the rotation runs,
+// so another thread may poll them to report progress.
+typedef struct {
+  _Atomic uint64_t bits_done;   // bits written back to the file so far
+  _Atomic uint64_t bits_total;  // bits that will be written in total
+} bitfile_progress_t;
+
+// Tuning knobs for bitfile_rotate.
+typedef struct {
+  // Upper bound on the memory used for I/O buffers, in bytes; 0 selects
+  // BITFILE_DEFAULT_MEMORY_CAP. Values below BITFILE_MIN_MEMORY_CAP are
+  // rounded up.
+  size_t memory_cap;
+
+  // Receives progress updates; may be NULL.
+  bitfile_progress_t* progress;
+} bitfile_options_t;
+
+// ******************************* Prototypes *******************************
+
+/**
+ * @brief Rotates a subarray of a bit array stored in a file, in place.
+ *
+ * Same semantics as bitarray_rotate, but the bits are streamed through a
+ * bounded amount of memory. The rotation is performed as three reversals
+ * (see the Reversal method in README.md), so the file is read and written
+ * sequentially about twice, with reads issued ahead of and writes issued
+ * behind the bit manipulation.
+ *
+ * @param path Path of the file holding the bits.
+ * @param bit_offset Index of the start of the subarray.
+ * @param bit_length Length of the subarray, in bits.
+ * @param bit_right_amount Number of places to rotate the subarray right.
+ * @param options Memory cap and progress counter; may be NULL for defaults.
+ * @return 0 on success; -1 on error, with errno set. On error the file may
+ * hold a partially rotated subarray.
+ */
+int bitfile_rotate(const char* const path,
+                   const size_t bit_offset,
+                   const size_t bit_length,
+                   const ssize_t bit_right_amount,
+                   const bitfile_options_t* const options);
+
+#endif  // BITFILE_H
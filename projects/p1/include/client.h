@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2012 MIT License by 6.172 Staff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+// Client library for the everybit server (see server.h). Operations are queued
+// into a batch and sent together by client_flush, so that a round trip to the
+// server is amortized over many operations.
+//
+// Each client_queue_* function returns the index of the operation within the
+// current batch; after client_flush, client_result retrieves its outcome.
+
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "protocol.h"
+
+
+// ********************************* Types **********************************
+
+// Abstract data type representing a connection to the server.
+typedef struct client client_t;
+
+// ******************************* Prototypes *******************************
+
+/**
+ * @brief Connects to a server listening on a Unix domain socket.
+ *
+ * @param socket_path Filesystem path of the socket.
+ * @return Pointer to the client; NULL if the connection failed.
+ */
+client_t* client_connect(const char* const socket_path);
+
+/**
+ * @brief Wraps an existing pair of file descriptors, e.g. the ends of pipes to
+ * a server running on stdin/stdout. The client takes ownership of both.
+ *
+ * @param in_fd File descriptor from which responses are read.
+ * @param out_fd File descriptor to which requests are written.
+ * @return Pointer to the client; NULL if memory could not be allocated.
+ */
+client_t* client_new(const int in_fd, const int out_fd);
+
+/**
+ * @brief Closes the connection and frees the client.
+ *
+ * @param client Pointer to a client.
+ */
+void client_free(client_t* const client);
+
+/**
+ * @brief Queues OP_OPEN; the result value is the handle for name.
+ *
+ * @param client Pointer to a client.
+ * @param name Name of the bitarray; at most PROTOCOL_MAX_NAME bytes.
+ * @param bit_sz Size of the bitarray, in bits.
+ * @return Index of the operation in the current batch.
+ */
+size_t client_queue_open(client_t* const client,
+                         const char* const name,
+                         const size_t bit_sz);
+
+/**
+ * @brief Queues OP_CLOSE.
+ *
+ * @param client Pointer to a client.
+ * @param handle Handle of the bitarray to free.
+ * @return Index of the operation in the current batch.
+ */
+size_t client_queue_close(client_t* const client, const uint32_t handle);
+
+/**
+ * @brief Queues OP_GET; the result value is the bit.
+ *
+ * @param client Pointer to a client.
+ * @param handle Handle of a bitarray.
+ * @param bit_index Zero-based index.
+ * @return Index of the operation in the current batch.
+ */
+size_t client_queue_get(client_t* const client,
+                        const uint32_t handle,
+                        const size_t bit_index);
+
+/**
+ * @brief Queues OP_SET.
+ *
+ * @param client Pointer to a client.
+ * @param handle Handle of a bitarray.
+ * @param bit_index Zero-based index.
+ * @param value Value of bit.
+ * @return Index of the operation in the current batch.
+ */
+size_t client_queue_set(client_t* const client,
+                        const uint32_t handle,
+                        const size_t bit_index,
+                        const bool value);
+
+/**
+ * @brief Queues OP_ROTATE; see bitarray_rotate for the semantics.
+ *
+ * @param client Pointer to a client.
+ * @param handle Handle of a bitarray.
+ * @param bit_offset Index of the start of the subarray.
+ * @param bit_length Length of the subarray, in bits.
+ * @param bit_right_amount Number of places to rotate the subarray right.
+ * @return Index of the operation in the current batch.
+ */
+size_t client_queue_rotate(client_t* const client,
+                           const uint32_t handle,
+                           const size_t bit_offset,
+                           const size_t bit_length,
+                           const ssize_t bit_right_amount);
+
+/**
+ * @brief Queues OP_RANDFILL.
+ *
+ * @param client Pointer to a client.
+ * @param handle Handle of a bitarray.
+ * @param seed Seed for the pseudorandom bits.
+ * @return Index of the operation in the current batch.
+ */
+size_t client_queue_randfill(client_t* const client,
+                             const uint32_t handle,
+                             const unsigned int seed);
+
+/**
+ * @brief Queues OP_FIND; see bitarray_find_pattern for the semantics.
+ *
+ * @param client Pointer to a client.
+ * @param handle Handle of a bitarray.
+ * @param bit_offset Index at which to start searching (inclusive).
+ * @param pattern Bits to search for, stored in the low pattern_len bits.
+ * @param pattern_len Length of the pattern, in bits; must be in [1, 64].
+ * @return Index of the operation in the current batch.
+ */
+size_t client_queue_find(client_t* const client,
+                         const uint32_t handle,
+                         const size_t bit_offset,
+                         const uint64_t pattern,
+                         const size_t pattern_len);
+
+/**
+ * @brief Sends the queued batch and waits for its results.
+ *
+ * Results of the previous batch are discarded. Flushing an empty batch is a
+ * no-op.
+ *
+ * @param client Pointer to a client.
+ * @return 0 on success; -1 on an I/O error or malformed response (including
+ * running out of memory while queueing).
+ */
+int client_flush(client_t* const client);
+
+/**
+ * @param client Pointer to a client.
+ * @return Number of results available from the last flush.
+ */
+size_t client_num_results(const client_t* const client);
+
+/**
+ * @brief Retrieves the outcome of an operation from the last flushed batch.
+ *
+ * @param client Pointer to a client.
+ * @param index Index returned when the operation was queued.
+ * @return Pointer to the result, valid until the next flush.
+ */
+const result_t* client_result(const client_t* const client,
+                              const size_t index);
+
+#endif  // CLIENT_H
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2012 MIT License by 6.172 Staff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <stddef.h>
+
+
+// ******************************* Prototypes *******************************
+
+/**
+ * @brief Benchmarks the everybit server with batches of random operations.
+ *
+ * Sends num_batches batches of batch_sz random rotate, set and get operations,
+ * mirrors them on a local bitarray to check every get, and reports throughput
+ * and per-batch latency on stdout.
+ *
+ * @param socket_path Socket of a running server, or "-" to fork a private
+ * server connected over a socket pair.
+ * @param num_batches Number of batches to send.
+ * @param batch_sz Number of operations per batch.
+ * @return 0 if every operation succeeded and matched the local copy; -1
+ * otherwise.
+ */
+int loadgen_run(const char* const socket_path,
+                const size_t num_batches,
+                const size_t batch_sz);
+
+#endif  // LOADGEN_H
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2012 MIT License by 6.172 Staff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+// Wire format shared by the everybit server and its client library.
+//
+// Every message, in either direction, is a frame: a uint32_t payload length
+// (in bytes) followed by the payload. A request payload is a batch_header_t
+// followed by num_ops operations; a response payload is a batch_header_t
+// followed by one result_t per operation, in the same order. All fields are
+// in host byte order, since the server is only reachable from the local
+// machine (stdin or a Unix domain socket).
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+
+// ********************************* Macros *********************************
+
+// Largest payload either side will accept, in bytes.
+#define PROTOCOL_MAX_PAYLOAD (64u * 1024 * 1024)
+
+// Longest name a bitarray can be registered under, in bytes.
+#define PROTOCOL_MAX_NAME 255
+
+
+// ********************************* Types **********************************
+
+// Operations understood by the server.
+typedef enum {
+  // Looks up (creating if necessary) the bitarray called name, which must be
+  // arg0 bits long; the op is followed by arg1 bytes of name, zero-padded to
+  // a multiple of 8 bytes. Result value is the handle used by later ops.
+  OP_OPEN = 1,
+  // Frees the bitarray behind handle; the handle becomes invalid.
+  OP_CLOSE = 2,
+  // Result value is the number of bits in handle.
+  OP_SIZE = 3,
+  // Result value is bit arg0 of handle.
+  OP_GET = 4,
+  // Sets bit arg0 of handle to arg1 (nonzero means 1).
+  OP_SET = 5,
+  // Rotates the subarray [arg0, arg0 + arg1) of handle right by arg2 bits.
+  OP_ROTATE = 6,
+  // Refills handle with pseudorandom bits, seeding the RNG with arg0.
+  OP_RANDFILL = 7,
+  // Result value is the index of the first occurrence of the low arg2 bits of
+  // arg1 at or after arg0, or -1 if there is none.
+  OP_FIND = 8,
+} opcode_t;
+
+// Status of a single operation.
+typedef enum {
+  STATUS_OK = 0,
+  STATUS_BAD_OPCODE = 1,
+  STATUS_BAD_HANDLE = 2,
+  STATUS_OUT_OF_RANGE = 3,
+  STATUS_NO_MEMORY = 4,
+  STATUS_SIZE_MISMATCH = 5,
+} status_t;
+
+// Precedes the operations (or results) in every payload.
+typedef struct {
+  uint32_t num_ops;
+  uint32_t reserved;
+} batch_header_t;
+
+// A single request; 32 bytes, so a batch of ops is naturally aligned.
+typedef struct {
+  uint8_t opcode;       // one of opcode_t
+  uint8_t reserved[3];
+  uint32_t handle;      // bitarray to operate on, as returned by OP_OPEN
+  uint64_t arg0;
+  uint64_t arg1;
+  int64_t arg2;
+} op_t;
+
+// The outcome of a single request.
+typedef struct {
+  uint32_t status;      // one of status_t
+  uint32_t reserved;
+  int64_t value;        // op-specific; 0 if the op produces no value
+} result_t;
+
+
+// ******************************* Prototypes *******************************
+
+/**
+ * @brief Reads one frame from a file descriptor.
+ *
+ * @param fd File descriptor to read from.
+ * @param buf Buffer receiving the payload; grown with realloc as needed.
+ * @param buf_sz Capacity of *buf, in bytes; updated if *buf grows.
+ * @return Payload length; 0 on end of file before the frame; -1 on error
+ * (including an empty payload, which is never valid).
+ */
+ssize_t protocol_read_frame(const int fd, void** const buf,
+                            size_t* const buf_sz);
+
+/**
+ * @brief Writes one frame to a file descriptor.
+ *
+ * @param fd File descriptor to write to.
+ * @param payload Payload to send.
+ * @param payload_sz Payload length, in bytes.
+ * @return 0 on success; -1 on error.
+ */
+int protocol_write_frame(const int fd, const void* const payload,
+                         const size_t payload_sz);
+
+#endif  // PROTOCOL_H
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2012 MIT License by 6.172 Staff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+// Long-running everybit server. Bitarrays stay resident between requests and
+// are addressed by name (see protocol.h for the wire format), so a client pays
+// for parsing and allocation once rather than on every operation.
+
+#ifndef SERVER_H
+#define SERVER_H
+
+
+// ********************************* Types **********************************
+
+// Abstract data type holding the server's named bitarrays.
+typedef struct server server_t;
+
+// ******************************* Prototypes *******************************
+
+/**
+ * @brief Allocates a server with no bitarrays.
+ *
+ * @return Pointer to the server; NULL if memory could not be allocated.
+ */
+server_t* server_new();
+
+/**
+ * @brief Frees a server along with all of its bitarrays.
+ *
+ * @param server Pointer to a server.
+ */
+void server_free(server_t* const server);
+
+/**
+ * @brief Executes request batches from in_fd until it reaches end of file.
+ *
+ * @param server Pointer to a server.
+ * @param in_fd File descriptor from which request frames are read.
+ * @param out_fd File descriptor to which response frames are written.
+ * @return 0 on end of file; -1 on an I/O or framing error.
+ */
+int server_serve(server_t* const server, const int in_fd, const int out_fd);
+
+/**
+ * @brief Listens on a Unix domain socket, serving one client at a time.
+ *
+ * Bitarrays persist across connections. Any existing file at socket_path is
+ * replaced. This function only returns if the socket cannot be set up.
+ *
+ * @param server Pointer to a server.
+ * @param socket_path Filesystem path of the socket.
+ * @return -1 on error.
+ */
+int server_listen(server_t* const server, const char* const socket_path);
+
+#endif  // SERVER_H
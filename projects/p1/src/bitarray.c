@@ -26,12 +26,26 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 
 #include "bitarray.h"
 
+// Rotation strategies; bitarray_rotate uses BITARRAY_ROTATE_STRATEGY, which can
+// be set with EXTRA_CFLAGS=-DBITARRAY_ROTATE_STRATEGY=<value>.  Only the AB and
+// cyclic strategies borrow scratch memory from a context.
+#define BITARRAY_ROTATE_JUGGLING 0
+#define BITARRAY_ROTATE_AB 1
+#define BITARRAY_ROTATE_CYCLIC 2
+#define BITARRAY_ROTATE_RIGHT 3
+
+#ifndef BITARRAY_ROTATE_STRATEGY
+#define BITARRAY_ROTATE_STRATEGY BITARRAY_ROTATE_JUGGLING
+#endif
+
 
 const uint8_t BYTEFLIP_LOOKUP[16] = {
   0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
@@ -46,6 +60,12 @@ struct bitarray {
   char* buf;      // underlying memory buffer that stores bits in packed form
 };
 
+// Concrete data type representing reusable scratch memory.
+struct bitarray_ctx {
+  bitarray_t scratch;  // lent to one algorithm at a time
+  size_t buf_sz;       // capacity of scratch.buf, in bytes; only ever grows
+};
+
 
 // ******************** Prototypes for static functions *********************
 
@@ -83,6 +103,40 @@ static char bitmask(const size_t bit_index);
  */
 static size_t modulo(const ssize_t n, const size_t m);
 
+/**
+ * @brief Greatest common divisor, by Euclid's algorithm.
+ *
+ * @param a First operand.
+ * @param b Second operand.
+ * @returns gcd(a, b); gcd(a, 0) = a.
+ * @example gcd(12, 8) = 4
+ */
+static size_t gcd(size_t a, size_t b);
+
+/**
+ * @brief Lends out a context's scratch memory as a bitarray of bit_sz bits.
+ *
+ * The scratch buffer is reallocated only if it is smaller than any previous
+ * request; otherwise no allocation takes place. The returned bitarray stays
+ * valid until the next call on the same context, and must not be freed.
+ *
+ * @param ctx Pointer to a context; may be NULL.
+ * @param bit_sz Number of bits required.
+ * @param zeroed Whether all bits must be initialized to 0.
+ * @returns Scratch bitarray; NULL if ctx is NULL or memory ran out.
+ */
+static bitarray_t* bitarray_ctx_borrow(bitarray_ctx_t* const ctx,
+                                       const size_t bit_sz,
+                                       const bool zeroed);
+
+/**
+ * @brief Returns the context used by bitarray_rotate on the calling thread,
+ * creating it on first use.
+ *
+ * @returns Pointer to the context; NULL if memory could not be allocated.
+ */
+static bitarray_ctx_t* bitarray_ctx_default();
+
 /**
  * @brief Rotates a subarray right by one bit.
  *
@@ -125,14 +179,17 @@ static void bitarray_rotate_right(bitarray_t* const bitarray,
  * bit_length). That is, the start is inclusive, but the end is exclusive.
  *
  * NOTE: Large auxiliary array can be problematic for cache performance when
- * rotating long strings.
+ * rotating long strings. The auxiliary array is borrowed from ctx, so at
+ * least it is not reallocated on every call.
  *
+ * @param ctx Context from which the auxiliary array is borrowed.
  * @param bitarray Pointer to bitarray to be rotated.
  * @param bit_offset Index of the start of the subarray.
  * @param bit_length Length of the subarray, in bits.
  * @param bit_right_amount Number of places to rotate the subarray right.
  */
-static void bitarray_rotate_ab(bitarray_t* const bitarray,
+static void bitarray_rotate_ab(bitarray_ctx_t* const ctx,
+                               bitarray_t* const bitarray,
                                const size_t bit_offset,
                                const size_t bit_length,
                                const ssize_t bit_right_amount);
@@ -167,16 +224,49 @@ inline static bool is_final(const bitarray_t* const bitarray);
  * NOTE: Although constant auxillary space is used, the memory accesses are
  * scattered, which can adversely impact caching.
  *
+ * @param ctx Context from which the bitmap of final positions is borrowed.
  * @param bitarray Pointer to bitarray to be rotated.
  * @param bit_offset Index of the start of the subarray.
  * @param bit_length Length of the subarray, in bits.
  * @param bit_right_amount Number of places to rotate the subarray right.
  */
-static void bitarray_rotate_cyclic(bitarray_t* const bitarray,
+static void bitarray_rotate_cyclic(bitarray_ctx_t* const ctx,
+                                   bitarray_t* const bitarray,
                                    const size_t bit_offset,
                                    const size_t bit_length,
                                    const ssize_t bit_right_amount);
 
+/**
+ * @brief Rotates subarray by following each of its gcd(bit_length,
+ * bit_right_amount) cycles exactly once (the "juggling" algorithm).
+ *
+ * Rotating right by k moves the element at index i to (i + k) mod n, so the
+ * indices split into gcd(n, k) disjoint cycles, each starting at one of the
+ * first gcd(n, k) indices. Walking every cycle once, carrying a single
+ * temporary, moves every element exactly once. Unlike the cyclic method, no
+ * map of visited positions is needed to find the next cycle.
+ *
+ * If both bit_length and bit_right_amount are multiples of 64, the subarray is
+ * treated as an array of 64-bit words, and whole words are moved instead of
+ * bits; bit_offset need not be aligned.
+ *
+ * The subarray spans the half-open interval [bit_offset, bit_offset +
+ * bit_length). That is, the start is inclusive, but the end is exclusive.
+ *
+ * NOTE: Accesses within a cycle are still bit_right_amount apart, so large
+ * subarrays with word-unaligned amounts still suffer from scattered accesses.
+ *
+ * @param bitarray Pointer to bitarray to be rotated.
+ * @param bit_offset Index of the start of the subarray.
+ * @param bit_length Length of the subarray, in bits.
+ * @param bit_right_amount Number of places to rotate the subarray right; must
+ * be in the range (0, bit_length).
+ */
+static void bitarray_rotate_juggling(bitarray_t* const bitarray,
+                                     const size_t bit_offset,
+                                     const size_t bit_length,
+                                     const size_t bit_right_amount);
+
 /**
  * @brief Reverses the bitarray bit by bit.
  *
@@ -212,6 +302,54 @@ static void bitarray_reverse(bitarray_t* const bitarray,
                              const size_t bit_offset,
                              const size_t bit_length);
 
+/**
+ * @brief Retrieves the 64 bits starting at an arbitrary bit index as a word.
+ *
+ * Bit i of the returned word holds the bit at index (bit_index + i); bits past
+ * the end of the bitarray read as 0. Assumes a little-endian target, so that
+ * the packed buffer can be loaded 8 bytes at a time.
+ *
+ * @param bitarray Pointer to a bitarray.
+ * @param bit_index Zero-based index of the first bit of the word.
+ * @returns Word containing the requested bits.
+ */
+static uint64_t bitarray_get_word(const bitarray_t* const bitarray,
+                                  const size_t bit_index);
+
+/**
+ * @brief Overwrites the 64 bits starting at an arbitrary bit index.
+ *
+ * The inverse of bitarray_get_word; bits outside [bit_index, bit_index + 64)
+ * are left untouched. Assumes a little-endian target.
+ *
+ * @param bitarray Pointer to a bitarray.
+ * @param bit_index Zero-based index of the first bit to overwrite; the whole
+ * word must lie within the bitarray.
+ * @param word Bit i of word is stored at index (bit_index + i).
+ */
+static void bitarray_set_word(bitarray_t* const bitarray,
+                              const size_t bit_index,
+                              const uint64_t word);
+
+/**
+ * @brief Matches a pattern against 64 consecutive starting positions at once.
+ *
+ * Uses the bit-parallel shift-and technique: bit p of the result stays set
+ * only while every pattern bit j agrees with text bit (p + j). Since each
+ * pattern bit rules out roughly half the remaining candidates on random data,
+ * the loop usually terminates after a handful of iterations.
+ *
+ * @param lo Text bits for starting positions [base, base + 64).
+ * @param hi Text bits [base + 64, base + 128), needed by the later positions.
+ * @param pattern Bits to search for, stored in the low pattern_len bits.
+ * @param pattern_len Length of the pattern, in bits; must be in [1, 64].
+ * @returns Mask with bit p set iff the pattern occurs at position base + p.
+ */
+static uint64_t match_word(const uint64_t lo,
+                           const uint64_t hi,
+                           const uint64_t pattern,
+                           const size_t pattern_len);
+
 
 // ******************************* Functions ********************************
 
@@ -243,6 +381,55 @@ void bitarray_free(bitarray_t* const bitarray) {
   free(bitarray);
 }
 
+bitarray_ctx_t* bitarray_ctx_new() {
+  bitarray_ctx_t* const ctx =
+    (bitarray_ctx_t*) calloc(1, sizeof(struct bitarray_ctx));
+  return ctx;
+}
+
+void bitarray_ctx_free(bitarray_ctx_t* const ctx) {
+  if (ctx == NULL) {
+    return;
+  }
+  free(ctx->scratch.buf);
+  free(ctx);
+}
+
+static bitarray_t* bitarray_ctx_borrow(bitarray_ctx_t* const ctx,
+                                       const size_t bit_sz,
+                                       const bool zeroed) {
+  if (ctx == NULL) {
+    return NULL;
+  }
+
+  const size_t buf_sz = (bit_sz + 7) / 8;
+  if (buf_sz > ctx->buf_sz) {
+    // Nothing in the old buffer needs to survive, so skip realloc's copy.
+    char* const buf = (char*) malloc(buf_sz);
+    if (buf == NULL) {
+      return NULL;
+    }
+    free(ctx->scratch.buf);
+    ctx->scratch.buf = buf;
+    ctx->buf_sz = buf_sz;
+  }
+  if (zeroed) {
+    memset(ctx->scratch.buf, 0, buf_sz);
+  }
+  ctx->scratch.bit_sz = bit_sz;
+  return &ctx->scratch;
+}
+
+static bitarray_ctx_t* bitarray_ctx_default() {
+  // Lives as long as the thread; never freed, as it is reused by every
+  // bitarray_rotate on this thread.
+  static _Thread_local bitarray_ctx_t* ctx = NULL;
+  if (ctx == NULL) {
+    ctx = bitarray_ctx_new();
+  }
+  return ctx;
+}
+
 size_t bitarray_get_bit_sz(const bitarray_t* const bitarray) {
   return bitarray->bit_sz;
 }
@@ -279,9 +466,12 @@ void bitarray_set(bitarray_t* const bitarray,
 }
 
 void bitarray_randfill(bitarray_t* const bitarray){
-  int32_t* ptr = (int32_t*) bitarray->buf;
-  for (int64_t i=0; i<bitarray->bit_sz/32 + 1; i++){
-    ptr[i] = rand();
+  // Fill 4 bytes at a time, taking care not to write past the end of buf
+  // when its size is not a multiple of 4.
+  const size_t buf_sz = (bitarray->bit_sz + 7) / 8;
+  for (size_t i = 0; i < buf_sz; i += 4) {
+    const int32_t value = rand();
+    memcpy(bitarray->buf + i, &value, (buf_sz - i < 4) ? buf_sz - i : 4);
   }
 }
 
@@ -297,6 +487,15 @@ static size_t modulo(const ssize_t n, const size_t m) {
   return (size_t)result;
 }
 
+static size_t gcd(size_t a, size_t b) {
+  while (b != 0) {
+    const size_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
 static void bitarray_rotate_right_one(bitarray_t* const bitarray,
                                       const size_t bit_offset,
                                       const size_t bit_length) {
@@ -318,7 +517,8 @@ static void bitarray_rotate_right(bitarray_t* const bitarray,
   }
 }
 
-static void bitarray_rotate_ab(bitarray_t* const bitarray,
+static void bitarray_rotate_ab(bitarray_ctx_t* const ctx,
+                               bitarray_t* const bitarray,
                                const size_t bit_offset,
                                const size_t bit_length,
                                const ssize_t bit_right_amount) {
@@ -328,7 +528,12 @@ static void bitarray_rotate_ab(bitarray_t* const bitarray,
 
   // Store bits to move in auxillary array
   const size_t seperator = bit_offset + (bit_length - bit_right_amount);
-  bitarray_t* aux = bitarray_new(bit_right_amount);
+  bitarray_t* aux = bitarray_ctx_borrow(ctx, bit_right_amount, false);
+  if (aux == NULL) {
+    // Out of memory; fall back to the rotation that needs no scratch.
+    bitarray_rotate_right(bitarray, bit_offset, bit_length, bit_right_amount);
+    return;
+  }
   size_t tmp_index = 0;
   for (size_t i=seperator; i < bit_offset+bit_length; i++) {
     bitarray_set(aux, tmp_index, bitarray_get(bitarray, i));
@@ -343,8 +548,6 @@ static void bitarray_rotate_ab(bitarray_t* const bitarray,
   for (size_t i=0; i < aux->bit_sz; ++i) {
     bitarray_set(bitarray, i+bit_offset, bitarray_get(aux, i));
   }
-
-  bitarray_free(aux);
 }
 
 static long find_unoccupied_idx(const bitarray_t* const bitarray) {
@@ -376,14 +579,20 @@ inline static bool is_final(const bitarray_t* const bitarray) {
   return (find_unoccupied_idx(bitarray) == -1) ? true : false;
 }
 
-static void bitarray_rotate_cyclic(bitarray_t* const bitarray,
+static void bitarray_rotate_cyclic(bitarray_ctx_t* const ctx,
+                                   bitarray_t* const bitarray,
                                    const size_t bit_offset,
                                    const size_t bit_length,
                                    const ssize_t bit_right_amount) {
   // Are the bits in their final position? Initially, all bits are in incorrect
   // positions (represented by 0s). As the bits get placed into their correct
   // positions, they become 1.
-  bitarray_t* positions = bitarray_new(bit_length);
+  bitarray_t* positions = bitarray_ctx_borrow(ctx, bit_length, true);
+  if (positions == NULL) {
+    // Out of memory; fall back to the rotation that needs no scratch.
+    bitarray_rotate_right(bitarray, bit_offset, bit_length, bit_right_amount);
+    return;
+  }
 
   size_t old_index = bit_offset;
   size_t new_index;
@@ -412,7 +621,55 @@ static void bitarray_rotate_cyclic(bitarray_t* const bitarray,
       }
     }
   }
-  bitarray_free(positions);
+}
+
+static void bitarray_rotate_juggling(bitarray_t* const bitarray,
+                                     const size_t bit_offset,
+                                     const size_t bit_length,
+                                     const size_t bit_right_amount) {
+  assert(bit_right_amount > 0 && bit_right_amount < bit_length);
+
+  if (bit_length % 64 == 0 && bit_right_amount % 64 == 0) {
+    // Same walk as below, with words in place of bits
+    const size_t n = bit_length / 64;
+    const size_t k = bit_right_amount / 64;
+    const size_t num_cycles = gcd(n, k);
+    for (size_t start = 0; start < num_cycles; start++) {
+      const uint64_t temp = bitarray_get_word(bitarray, bit_offset + start*64);
+      size_t i = start;
+      while (true) {
+        const size_t prev = (i >= k) ? i - k : i + n - k;
+        if (prev == start) {
+          break;
+        }
+        bitarray_set_word(bitarray, bit_offset + i*64,
+                          bitarray_get_word(bitarray, bit_offset + prev*64));
+        i = prev;
+      }
+      bitarray_set_word(bitarray, bit_offset + i*64, temp);
+    }
+    return;
+  }
+
+  // Each cycle fills index i from (i - k), walking backwards from its start,
+  // so that only the start's original bit needs to be held aside.
+  const size_t n = bit_length;
+  const size_t k = bit_right_amount;
+  const size_t num_cycles = gcd(n, k);
+  for (size_t start = 0; start < num_cycles; start++) {
+    const bool temp = bitarray_get(bitarray, bit_offset + start);
+    size_t i = start;
+    while (true) {
+      const size_t prev = (i >= k) ? i - k : i + n - k;
+      if (prev == start) {
+        break;
+      }
+      bitarray_set(bitarray, bit_offset + i,
+                   bitarray_get(bitarray, bit_offset + prev));
+      i = prev;
+    }
+    bitarray_set(bitarray, bit_offset + i, temp);
+  }
 }
 
 static void bitarray_reverse_bit(bitarray_t* const bitarray,
@@ -489,6 +746,19 @@ void bitarray_rotate(bitarray_t* const bitarray,
                      const size_t bit_offset,
                      const size_t bit_length,
                      const ssize_t bit_right_amount) {
+  // Juggling needs no scratch memory, so don't create a context for it.
+  bitarray_ctx_t* const ctx =
+    (BITARRAY_ROTATE_STRATEGY == BITARRAY_ROTATE_AB ||
+     BITARRAY_ROTATE_STRATEGY == BITARRAY_ROTATE_CYCLIC)
+    ? bitarray_ctx_default() : NULL;
+  bitarray_rotate_ctx(ctx, bitarray, bit_offset, bit_length, bit_right_amount);
+}
+
+void bitarray_rotate_ctx(bitarray_ctx_t* const ctx,
+                         bitarray_t* const bitarray,
+                         const size_t bit_offset,
+                         const size_t bit_length,
+                         const ssize_t bit_right_amount) {
   assert(bit_offset + bit_length <= bitarray->bit_sz);
 
   // Don't do anything if there's nothing to rotate
@@ -502,12 +772,142 @@ void bitarray_rotate(bitarray_t* const bitarray,
   if (k == 0)
     return;
 
-  // bitarray_rotate_right(bitarray, bit_offset, bit_length, k);
-  // bitarray_rotate_ab(bitarray, bit_offset, bit_length, k);
-  bitarray_rotate_cyclic(bitarray, bit_offset, bit_length, k);
+  switch (BITARRAY_ROTATE_STRATEGY) {
+  case BITARRAY_ROTATE_AB:
+    bitarray_rotate_ab(ctx, bitarray, bit_offset, bit_length, k);
+    break;
+  case BITARRAY_ROTATE_CYCLIC:
+    bitarray_rotate_cyclic(ctx, bitarray, bit_offset, bit_length, k);
+    break;
+  case BITARRAY_ROTATE_RIGHT:
+    bitarray_rotate_right(bitarray, bit_offset, bit_length, k);
+    break;
+  default:
+    bitarray_rotate_juggling(bitarray, bit_offset, bit_length, k);
+  }
 
   // Rotate using bit reverse
   // bitarray_reverse(bitarray, bit_offset, bit_length - k);
   // bitarray_reverse(bitarray, bit_offset + bit_length - k, k);
   // bitarray_reverse(bitarray, bit_offset, bit_length);
 }
+
+static uint64_t bitarray_get_word(const bitarray_t* const bitarray,
+                                  const size_t bit_index) {
+  const size_t buf_sz = (bitarray->bit_sz + 7) / 8;
+  const size_t byte_index = bit_index / 8;
+  const size_t shift = bit_index % 8;
+
+  // Load (up to) 9 bytes, so that the word can start mid-byte.
+  uint64_t lo = 0;
+  uint8_t hi = 0;
+  if (byte_index + 8 < buf_sz) {
+    memcpy(&lo, bitarray->buf + byte_index, 8);
+    hi = (uint8_t) bitarray->buf[byte_index + 8];
+  } else if (byte_index < buf_sz) {
+    memcpy(&lo, bitarray->buf + byte_index, buf_sz - byte_index);
+  }
+  if (shift == 0) {
+    return lo;
+  }
+  return (lo >> shift) | ((uint64_t) hi << (64 - shift));
+}
+
+static void bitarray_set_word(bitarray_t* const bitarray,
+                              const size_t bit_index,
+                              const uint64_t word) {
+  assert(bit_index + 64 <= bitarray->bit_sz);
+
+  char* const bytes = bitarray->buf + bit_index / 8;
+  const size_t shift = bit_index % 8;
+  if (shift == 0) {
+    memcpy(bytes, &word, 8);
+    return;
+  }
+
+  // The word straddles 9 bytes: keep the low `shift` bits of the first and
+  // the high (8 - shift) bits of the last.
+  const uint8_t keep = (uint8_t) ((1u << shift) - 1);
+  uint64_t lo;
+  memcpy(&lo, bytes, 8);
+  lo = (lo & keep) | (word << shift);
+  memcpy(bytes, &lo, 8);
+  bytes[8] = (char) (((uint8_t) bytes[8] & (uint8_t) ~keep) |
+                     (uint8_t) (word >> (64 - shift)));
+}
+
+static uint64_t match_word(const uint64_t lo,
+                           const uint64_t hi,
+                           const uint64_t pattern,
+                           const size_t pattern_len) {
+  uint64_t candidates = ~(uint64_t) 0;
+  for (size_t j = 0; j < pattern_len && candidates != 0; j++) {
+    // Text bits (p + j) for every starting position p in the word
+    const uint64_t text = (j == 0) ? lo : (lo >> j) | (hi << (64 - j));
+    candidates &= ((pattern >> j) & 1) ? text : ~text;
+  }
+  return candidates;
+}
+
+ssize_t bitarray_find_pattern(const bitarray_t* const bitarray,
+                              const size_t bit_offset,
+                              const uint64_t pattern,
+                              const size_t pattern_len) {
+  assert(pattern_len >= 1 && pattern_len <= 64);
+
+  const size_t bit_sz = bitarray->bit_sz;
+  if (pattern_len > bit_sz || bit_offset > bit_sz - pattern_len) {
+    return -1;
+  }
+
+  // Last position (exclusive) at which the pattern still fits
+  const size_t end = bit_sz - pattern_len + 1;
+  uint64_t lo = bitarray_get_word(bitarray, bit_offset);
+  for (size_t base = bit_offset; base < end; base += 64) {
+    const uint64_t hi = bitarray_get_word(bitarray, base + 64);
+    uint64_t candidates = match_word(lo, hi, pattern, pattern_len);
+    if (end - base < 64) {
+      candidates &= ((uint64_t) 1 << (end - base)) - 1;
+    }
+    if (candidates != 0) {
+      return (ssize_t) (base + __builtin_ctzll(candidates));
+    }
+    lo = hi;
+  }
+  return -1;
+}
+
+size_t bitarray_find_pattern_all(const bitarray_t* const bitarray,
+                                 const size_t bit_offset,
+                                 const uint64_t pattern,
+                                 const size_t pattern_len,
+                                 size_t* const matches,
+                                 const size_t max_matches) {
+  assert(pattern_len >= 1 && pattern_len <= 64);
+
+  const size_t bit_sz = bitarray->bit_sz;
+  if (pattern_len > bit_sz || bit_offset > bit_sz - pattern_len) {
+    return 0;
+  }
+
+  size_t num_matches = 0;
+  const size_t end = bit_sz - pattern_len + 1;
+  uint64_t lo = bitarray_get_word(bitarray, bit_offset);
+  for (size_t base = bit_offset; base < end; base += 64) {
+    const uint64_t hi = bitarray_get_word(bitarray, base + 64);
+    uint64_t candidates = match_word(lo, hi, pattern, pattern_len);
+    if (end - base < 64) {
+      candidates &= ((uint64_t) 1 << (end - base)) - 1;
+    }
+    // Report matches in increasing order, clearing the lowest set bit each time
+    while (candidates != 0) {
+      if (num_matches < max_matches) {
+        matches[num_matches] = base + __builtin_ctzll(candidates);
+      }
+      num_matches++;
+      candidates &= candidates - 1;
+    }
+    lo = hi;
+  }
+  return num_matches;
+}
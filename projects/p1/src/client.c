@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) 2012 MIT License by 6.172 Staff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+// Implements the client library specified in client.h.
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "client.h"
+#include "protocol.h"
+
+
+// ********************************* Types **********************************
+
+// Concrete data type representing a connection to the server.
+struct client {
+  int in_fd;
+  int out_fd;
+
+  char* request;        // batch_header_t followed by the queued ops
+  size_t request_len;   // bytes of request in use
+  size_t request_sz;    // capacity of request
+  uint32_t num_ops;     // ops queued in the current batch
+  bool failed;          // set if queueing ran out of memory
+
+  void* response;       // payload of the last response
+  size_t response_sz;
+  size_t num_results;
+};
+
+
+// ******************** Prototypes for static functions *********************
+
+/**
+ * @brief Appends bytes to the current request, growing it if necessary.
+ *
+ * @param client Pointer to a client.
+ * @param data Bytes to append; NULL appends zeros.
+ * @param len Number of bytes to append.
+ */
+static void client_append(client_t* const client,
+                          const void* const data,
+                          const size_t len);
+
+/**
+ * @brief Queues a fixed-size operation.
+ *
+ * @param client Pointer to a client.
+ * @param opcode Operation to perform.
+ * @param handle Handle of a bitarray.
+ * @param arg0 First argument.
+ * @param arg1 Second argument.
+ * @param arg2 Third argument.
+ * @return Index of the operation in the current batch.
+ */
+static size_t client_queue(client_t* const client,
+                           const opcode_t opcode,
+                           const uint32_t handle,
+                           const uint64_t arg0,
+                           const uint64_t arg1,
+                           const int64_t arg2);
+
+
+// ******************************* Functions ********************************
+
+client_t* client_new(const int in_fd, const int out_fd) {
+  client_t* const client = (client_t*) calloc(1, sizeof(struct client));
+  if (client == NULL) {
+    return NULL;
+  }
+  client->in_fd = in_fd;
+  client->out_fd = out_fd;
+  client->request_len = sizeof(batch_header_t);
+  return client;
+}
+
+client_t* client_connect(const char* const socket_path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    return NULL;
+  }
+  strcpy(addr.sun_path, socket_path);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  client_t* const client = client_new(fd, fd);
+  if (client == NULL) {
+    close(fd);
+  }
+  return client;
+}
+
+void client_free(client_t* const client) {
+  if (client == NULL) {
+    return;
+  }
+  close(client->out_fd);
+  if (client->in_fd != client->out_fd) {
+    close(client->in_fd);
+  }
+  free(client->request);
+  free(client->response);
+  free(client);
+}
+
+static void client_append(client_t* const client,
+                          const void* const data,
+                          const size_t len) {
+  if (client->request_len + len > client->request_sz) {
+    size_t cap = client->request_sz ? 2 * client->request_sz : 4096;
+    while (cap < client->request_len + len) {
+      cap *= 2;
+    }
+    char* const grown = realloc(client->request, cap);
+    if (grown == NULL) {
+      client->failed = true;
+      return;
+    }
+    client->request = grown;
+    client->request_sz = cap;
+  }
+  if (data == NULL) {
+    memset(client->request + client->request_len, 0, len);
+  } else {
+    memcpy(client->request + client->request_len, data, len);
+  }
+  client->request_len += len;
+}
+
+static size_t client_queue(client_t* const client,
+                           const opcode_t opcode,
+                           const uint32_t handle,
+                           const uint64_t arg0,
+                           const uint64_t arg1,
+                           const int64_t arg2) {
+  op_t op;
+  memset(&op, 0, sizeof(op));
+  op.opcode = (uint8_t) opcode;
+  op.handle = handle;
+  op.arg0 = arg0;
+  op.arg1 = arg1;
+  op.arg2 = arg2;
+  client_append(client, &op, sizeof(op));
+  return client->num_ops++;
+}
+
+size_t client_queue_open(client_t* const client,
+                         const char* const name,
+                         const size_t bit_sz) {
+  const size_t name_len = strlen(name);
+  assert(name_len <= PROTOCOL_MAX_NAME);
+
+  const size_t index = client_queue(client, OP_OPEN, 0, bit_sz, name_len, 0);
+  const size_t padded_len = (name_len + 7) & ~(size_t) 7;
+  client_append(client, name, name_len);
+  client_append(client, NULL, padded_len - name_len);
+  return index;
+}
+
+size_t client_queue_close(client_t* const client, const uint32_t handle) {
+  return client_queue(client, OP_CLOSE, handle, 0, 0, 0);
+}
+
+size_t client_queue_get(client_t* const client,
+                        const uint32_t handle,
+                        const size_t bit_index) {
+  return client_queue(client, OP_GET, handle, bit_index, 0, 0);
+}
+
+size_t client_queue_set(client_t* const client,
+                        const uint32_t handle,
+                        const size_t bit_index,
+                        const bool value) {
+  return client_queue(client, OP_SET, handle, bit_index, value, 0);
+}
+
+size_t client_queue_rotate(client_t* const client,
+                           const uint32_t handle,
+                           const size_t bit_offset,
+                           const size_t bit_length,
+                           const ssize_t bit_right_amount) {
+  return client_queue(client, OP_ROTATE, handle, bit_offset, bit_length,
+                      bit_right_amount);
+}
+
+size_t client_queue_randfill(client_t* const client,
+                             const uint32_t handle,
+                             const unsigned int seed) {
+  return client_queue(client, OP_RANDFILL, handle, seed, 0, 0);
+}
+
+size_t client_queue_find(client_t* const client,
+                         const uint32_t handle,
+                         const size_t bit_offset,
+                         const uint64_t pattern,
+                         const size_t pattern_len) {
+  return client_queue(client, OP_FIND, handle, bit_offset, pattern,
+                      pattern_len);
+}
+
+int client_flush(client_t* const client) {
+  client->num_results = 0;
+  if (client->num_ops == 0) {
+    return 0;
+  }
+
+  const uint32_t num_ops = client->num_ops;
+  const bool failed = client->failed;
+  const size_t request_len = client->request_len;
+
+  // Start the next batch regardless of whether this one goes through.
+  client->num_ops = 0;
+  client->failed = false;
+  client->request_len = sizeof(batch_header_t);
+  if (failed) {
+    return -1;
+  }
+
+  batch_header_t header = { .num_ops = num_ops, .reserved = 0 };
+  memcpy(client->request, &header, sizeof(header));
+  if (protocol_write_frame(client->out_fd, client->request, request_len) != 0) {
+    return -1;
+  }
+
+  const ssize_t payload_sz = protocol_read_frame(client->in_fd,
+                                                 &client->response,
+                                                 &client->response_sz);
+  if (payload_sz != (ssize_t) (sizeof(batch_header_t) +
+                               num_ops * sizeof(result_t))) {
+    return -1;
+  }
+  client->num_results = num_ops;
+  return 0;
+}
+
+size_t client_num_results(const client_t* const client) {
+  return client->num_results;
+}
+
+const result_t* client_result(const client_t* const client,
+                              const size_t index) {
+  assert(index < client->num_results);
+  return (const result_t*) ((const char*) client->response +
+                            sizeof(batch_header_t)) + index;
+}
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) 2012 MIT License by 6.172 Staff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+// Load generator for the everybit server.
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bitarray.h"
+#include "client.h"
+#include "loadgen.h"
+#include "protocol.h"
+#include "server.h"
+
+
+// ********************************* Macros *********************************
+
+// Size of the bitarray the load is applied to.
+#define LOADGEN_BIT_SZ (1 << 16)
+
+// Longest subarray rotated by a single operation.
+#define LOADGEN_MAX_ROTATE 512
+
+
+// ******************** Prototypes for static functions *********************
+
+/**
+ * @brief Forks a server process connected to the returned client.
+ *
+ * @param child Receives the pid of the server process.
+ * @returns Pointer to a client; NULL on failure.
+ */
+static client_t* loadgen_spawn_server(pid_t* const child);
+
+/**
+ * @returns Wall-clock time, in seconds. Unlike ktiming (which measures CPU
+ * time), this includes the time spent waiting for the server.
+ */
+static double loadgen_now();
+
+
+// ******************************* Functions ********************************
+
+static client_t* loadgen_spawn_server(pid_t* const child) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    perror("socketpair");
+    return NULL;
+  }
+
+  *child = fork();
+  if (*child < 0) {
+    perror("fork");
+    close(fds[0]);
+    close(fds[1]);
+    return NULL;
+  }
+  if (*child == 0) {
+    close(fds[0]);
+    server_t* const server = server_new();
+    const int status = server ? server_serve(server, fds[1], fds[1]) : -1;
+    server_free(server);
+    _exit(status == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  close(fds[1]);
+  return client_new(fds[0], fds[0]);
+}
+
+static double loadgen_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + 1e-9 * now.tv_nsec;
+}
+
+int loadgen_run(const char* const socket_path,
+                const size_t num_batches,
+                const size_t batch_sz) {
+  pid_t child = -1;
+  client_t* const client = (strcmp(socket_path, "-") == 0)
+                             ? loadgen_spawn_server(&child)
+                             : client_connect(socket_path);
+  if (client == NULL) {
+    fprintf(stderr, "Could not connect to server (%s)\n", socket_path);
+    return -1;
+  }
+
+  // Local replica against which every get is checked.
+  bitarray_t* const replica = bitarray_new(LOADGEN_BIT_SZ);
+  srand(6172);
+  bitarray_randfill(replica);
+
+  int retval = 0;
+  size_t mismatches = 0;
+  uint32_t handle = 0;
+
+  // Handles are assigned by the server, so the open has to come back before
+  // the randfill can name the array.
+  client_queue_open(client, "loadgen", LOADGEN_BIT_SZ);
+  if (client_flush(client) != 0 ||
+      client_result(client, 0)->status != STATUS_OK) {
+    fprintf(stderr, "Could not open bitarray on server\n");
+    retval = -1;
+    goto cleanup;
+  }
+  handle = (uint32_t) client_result(client, 0)->value;
+
+  client_queue_randfill(client, handle, 6172);
+  if (client_flush(client) != 0 ||
+      client_result(client, 0)->status != STATUS_OK) {
+    fprintf(stderr, "Could not fill bitarray on server\n");
+    retval = -1;
+    goto cleanup;
+  }
+
+  // Expected value of each get in the current batch, indexed by op index;
+  // -1 marks ops that are not gets.
+  int8_t* const expected = malloc(batch_sz);
+  if (expected == NULL) {
+    retval = -1;
+    goto cleanup;
+  }
+
+  const double start_time = loadgen_now();
+  for (size_t batch = 0; batch < num_batches; batch++) {
+    for (size_t i = 0; i < batch_sz; i++) {
+      const size_t index = rand() % LOADGEN_BIT_SZ;
+      switch (rand() % 3) {
+      case 0: {
+        const size_t length = rand() % LOADGEN_MAX_ROTATE;
+        const size_t offset = rand() % (LOADGEN_BIT_SZ - length);
+        const ssize_t amount = rand() % LOADGEN_MAX_ROTATE -
+                               LOADGEN_MAX_ROTATE / 2;
+        client_queue_rotate(client, handle, offset, length, amount);
+        bitarray_rotate(replica, offset, length, amount);
+        expected[i] = -1;
+        break;
+      }
+      case 1: {
+        const bool value = rand() & 1;
+        client_queue_set(client, handle, index, value);
+        bitarray_set(replica, index, value);
+        expected[i] = -1;
+        break;
+      }
+      default:
+        client_queue_get(client, handle, index);
+        expected[i] = bitarray_get(replica, index);
+      }
+    }
+
+    if (client_flush(client) != 0) {
+      fprintf(stderr, "Batch %zu failed\n", batch);
+      retval = -1;
+      break;
+    }
+    for (size_t i = 0; i < batch_sz; i++) {
+      const result_t* const result = client_result(client, i);
+      if (result->status != STATUS_OK ||
+          (expected[i] >= 0 && result->value != expected[i])) {
+        mismatches++;
+      }
+    }
+  }
+  const double elapsed = loadgen_now() - start_time;
+  free(expected);
+
+  const double num_ops = (double) num_batches * batch_sz;
+  printf("---- RESULTS ----\n");
+  printf("Batches: %zu x %zu ops\n", num_batches, batch_sz);
+  printf("Elapsed: %.6fs\n", elapsed);
+  printf("Throughput: %.0f ops/s\n", num_ops / elapsed);
+  printf("Latency: %.3fus/batch, %.3fus/op\n",
+         1e6 * elapsed / num_batches, 1e6 * elapsed / num_ops);
+  printf("Mismatches: %zu\n", mismatches);
+  printf("---- END RESULTS ----\n");
+  if (mismatches > 0) {
+    retval = -1;
+  }
+
+cleanup:
+  bitarray_free(replica);
+  client_free(client);
+  if (child > 0) {
+    // Closing the connection makes the server see end of file and exit.
+    int status;
+    waitpid(child, &status, 0);
+  }
+  return retval;
+}
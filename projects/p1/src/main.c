@@ -26,8 +26,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "loadgen.h"
+#include "server.h"
 #include "tests.h"
 
 
@@ -45,7 +48,7 @@ int main(int argc, char** argv) {
   char optchar;
   opterr = 0;
   int selected_test = -1;
-  while ((optchar = getopt(argc, argv, "n:t:smla")) != -1) {
+  while ((optchar = getopt(argc, argv, "n:t:smlaS:B:")) != -1) {
     switch (optchar) {
     case 'n':
       selected_test = atoi(optarg);
@@ -79,6 +82,27 @@ int main(int argc, char** argv) {
       printf("---- END RESULTS ----\n");
       retval = EXIT_SUCCESS;
       goto cleanup;
+    case 'S': {
+      // -S path serves batched operations on a Unix domain socket; -S -
+      // serves them on stdin/stdout.
+      server_t* const server = server_new();
+      if (server == NULL) {
+        retval = EXIT_FAILURE;
+        goto cleanup;
+      }
+      const int status = (strcmp(optarg, "-") == 0)
+                           ? server_serve(server, STDIN_FILENO, STDOUT_FILENO)
+                           : server_listen(server, optarg);
+      server_free(server);
+      retval = (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+      goto cleanup;
+    }
+    case 'B':
+      // -B path runs the load generator against the server at path; -B -
+      // forks a private server for it.
+      retval = (loadgen_run(optarg, 1000, 256) == 0) ? EXIT_SUCCESS
+                                                     : EXIT_FAILURE;
+      goto cleanup;
     case 'a':
       sample_test_a();
       retval = EXIT_SUCCESS;
@@ -103,6 +127,10 @@ void print_usage(const char* const argv_0) {
           "\t    (note: the provided -[s/m/l] options only test performance\n"
           "\t     and NOT correctness.)\n"
           "\t -t tests/default\tRun alltests in the testfile tests/default\n"
-          "\t -n 1 -t tests/default\tRun test 1 in the testfile tests/default\n",
+          "\t -n 1 -t tests/default\tRun test 1 in the testfile tests/default\n"
+          "\t -S path\tServe batched operations on Unix socket path\n"
+          "\t         \t(-S - serves them on stdin/stdout)\n"
+          "\t -B path\tBenchmark the server at path with random operations\n"
+          "\t         \t(-B - forks a private server)\n",
           argv_0);
 }
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2012 MIT License by 6.172 Staff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+// Framing helpers shared by the server and the client library.
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "protocol.h"
+
+
+// ******************** Prototypes for static functions *********************
+
+/**
+ * @brief Reads exactly len bytes, retrying on short reads and EINTR.
+ *
+ * @param fd File descriptor to read from.
+ * @param buf Destination buffer.
+ * @param len Number of bytes to read.
+ * @returns Number of bytes read; less than len only on end of file; -1 on
+ * error.
+ */
+static ssize_t read_full(const int fd, void* const buf, const size_t len);
+
+
+// ******************************* Functions ********************************
+
+static ssize_t read_full(const int fd, void* const buf, const size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    const ssize_t n = read(fd, (char*) buf + done, len - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+ssize_t protocol_read_frame(const int fd, void** const buf,
+                            size_t* const buf_sz) {
+  uint32_t payload_sz;
+  const ssize_t n = read_full(fd, &payload_sz, sizeof(payload_sz));
+  if (n == 0) {
+    return 0;
+  }
+  if (n != sizeof(payload_sz) || payload_sz == 0 ||
+      payload_sz > PROTOCOL_MAX_PAYLOAD) {
+    return -1;
+  }
+
+  // Buffers only ever grow, so steady-state batches do no allocation.
+  if (payload_sz > *buf_sz) {
+    void* const grown = realloc(*buf, payload_sz);
+    if (grown == NULL) {
+      return -1;
+    }
+    *buf = grown;
+    *buf_sz = payload_sz;
+  }
+
+  if (read_full(fd, *buf, payload_sz) != (ssize_t) payload_sz) {
+    return -1;
+  }
+  return payload_sz;
+}
+
+int protocol_write_frame(const int fd, const void* const payload,
+                         const size_t payload_sz) {
+  if (payload_sz == 0 || payload_sz > PROTOCOL_MAX_PAYLOAD) {
+    return -1;
+  }
+
+  // Send the length prefix and the payload with a single system call when
+  // possible.
+  uint32_t prefix = (uint32_t) payload_sz;
+  struct iovec iov[2] = {
+    { .iov_base = &prefix, .iov_len = sizeof(prefix) },
+    { .iov_base = (void*) payload, .iov_len = payload_sz },
+  };
+  int iov_index = 0;
+  while (iov_index < 2) {
+    const ssize_t n = writev(fd, iov + iov_index, 2 - iov_index);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    // Advance past whatever was written.
+    size_t written = n;
+    while (iov_index < 2 && written >= iov[iov_index].iov_len) {
+      written -= iov[iov_index].iov_len;
+      iov_index++;
+    }
+    if (iov_index < 2) {
+      iov[iov_index].iov_base = (char*) iov[iov_index].iov_base + written;
+      iov[iov_index].iov_len -= written;
+    }
+  }
+  return 0;
+}
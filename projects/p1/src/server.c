@@ -0,0 +1,375 @@
+/**
+ * Copyright (c) 2012 MIT License by 6.172 Staff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ **/
+
+// Implements the server specified in server.h. Request and response buffers
+// are grow-only and reused across batches, so once warmed up the per-operation
+// cost is that of the bitarray operation itself plus a table lookup.
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bitarray.h"
+#include "protocol.h"
+#include "server.h"
+
+
+// ********************************* Types **********************************
+
+// A named bitarray; a closed entry has a NULL bitarray.
+typedef struct {
+  char* name;
+  bitarray_t* bitarray;
+} entry_t;
+
+// Concrete data type representing the server's state.
+struct server {
+  entry_t* entries;     // indexed by handle
+  size_t num_entries;
+  size_t cap_entries;
+
+  void* request;        // buffer for the incoming request payload
+  size_t request_sz;
+  void* response;       // buffer for the outgoing response payload
+  size_t response_sz;
+
+  bitarray_ctx_t* ctx;  // scratch memory shared by every rotation
+};
+
+
+// ******************** Prototypes for static functions *********************
+
+/**
+ * @brief Finds or creates the bitarray registered under a name.
+ *
+ * @param server Pointer to a server.
+ * @param name Name of the bitarray (need not be NUL-terminated).
+ * @param name_len Length of the name, in bytes.
+ * @param bit_sz Required size of the bitarray, in bits.
+ * @param result Receives the handle on success, or the failure status.
+ */
+static void server_open(server_t* const server,
+                        const char* const name,
+                        const size_t name_len,
+                        const size_t bit_sz,
+                        result_t* const result);
+
+/**
+ * @brief Looks up the bitarray behind a handle.
+ *
+ * @param server Pointer to a server.
+ * @param handle Handle returned by OP_OPEN.
+ * @returns The bitarray; NULL if the handle is invalid or closed.
+ */
+static bitarray_t* server_lookup(const server_t* const server,
+                                 const uint32_t handle);
+
+/**
+ * @brief Executes a single fixed-size operation (anything but OP_OPEN).
+ *
+ * @param server Pointer to a server.
+ * @param op Operation to execute.
+ * @param result Receives the outcome of the operation.
+ */
+static void server_execute(server_t* const server,
+                           const op_t* const op,
+                           result_t* const result);
+
+/**
+ * @brief Executes every operation in a request payload.
+ *
+ * @param server Pointer to a server.
+ * @param payload_sz Length of the request payload in server->request.
+ * @returns Number of results written to server->response; -1 if the payload
+ * is malformed.
+ */
+static ssize_t server_execute_batch(server_t* const server,
+                                    const size_t payload_sz);
+
+
+// ******************************* Functions ********************************
+
+server_t* server_new() {
+  server_t* const server = (server_t*) calloc(1, sizeof(struct server));
+  if (server == NULL) {
+    return NULL;
+  }
+  server->ctx = bitarray_ctx_new();
+  if (server->ctx == NULL) {
+    free(server);
+    return NULL;
+  }
+  return server;
+}
+
+void server_free(server_t* const server) {
+  if (server == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < server->num_entries; i++) {
+    free(server->entries[i].name);
+    bitarray_free(server->entries[i].bitarray);
+  }
+  free(server->entries);
+  free(server->request);
+  free(server->response);
+  bitarray_ctx_free(server->ctx);
+  free(server);
+}
+
+static void server_open(server_t* const server,
+                        const char* const name,
+                        const size_t name_len,
+                        const size_t bit_sz,
+                        result_t* const result) {
+  // Reuse the existing bitarray if this name is already open.
+  for (size_t i = 0; i < server->num_entries; i++) {
+    const entry_t* const entry = &server->entries[i];
+    if (entry->bitarray != NULL && strlen(entry->name) == name_len &&
+        memcmp(entry->name, name, name_len) == 0) {
+      if (bitarray_get_bit_sz(entry->bitarray) != bit_sz) {
+        result->status = STATUS_SIZE_MISMATCH;
+        return;
+      }
+      result->value = i;
+      return;
+    }
+  }
+
+  if (server->num_entries == server->cap_entries) {
+    const size_t cap = server->cap_entries ? 2 * server->cap_entries : 16;
+    entry_t* const grown = realloc(server->entries, cap * sizeof(entry_t));
+    if (grown == NULL) {
+      result->status = STATUS_NO_MEMORY;
+      return;
+    }
+    server->entries = grown;
+    server->cap_entries = cap;
+  }
+
+  char* const name_copy = strndup(name, name_len);
+  bitarray_t* const bitarray = bitarray_new(bit_sz);
+  if (name_copy == NULL || bitarray == NULL) {
+    free(name_copy);
+    bitarray_free(bitarray);
+    result->status = STATUS_NO_MEMORY;
+    return;
+  }
+  server->entries[server->num_entries].name = name_copy;
+  server->entries[server->num_entries].bitarray = bitarray;
+  result->value = server->num_entries;
+  server->num_entries++;
+}
+
+static bitarray_t* server_lookup(const server_t* const server,
+                                 const uint32_t handle) {
+  if (handle >= server->num_entries) {
+    return NULL;
+  }
+  return server->entries[handle].bitarray;
+}
+
+static void server_execute(server_t* const server,
+                           const op_t* const op,
+                           result_t* const result) {
+  bitarray_t* const bitarray = server_lookup(server, op->handle);
+  if (bitarray == NULL) {
+    result->status = STATUS_BAD_HANDLE;
+    return;
+  }
+  const size_t bit_sz = bitarray_get_bit_sz(bitarray);
+
+  switch (op->opcode) {
+  case OP_CLOSE:
+    bitarray_free(bitarray);
+    server->entries[op->handle].bitarray = NULL;
+    free(server->entries[op->handle].name);
+    server->entries[op->handle].name = NULL;
+    break;
+  case OP_SIZE:
+    result->value = bit_sz;
+    break;
+  case OP_GET:
+    if (op->arg0 >= bit_sz) {
+      result->status = STATUS_OUT_OF_RANGE;
+      break;
+    }
+    result->value = bitarray_get(bitarray, op->arg0);
+    break;
+  case OP_SET:
+    if (op->arg0 >= bit_sz) {
+      result->status = STATUS_OUT_OF_RANGE;
+      break;
+    }
+    bitarray_set(bitarray, op->arg0, op->arg1 != 0);
+    break;
+  case OP_ROTATE:
+    if (op->arg0 > bit_sz || op->arg1 > bit_sz - op->arg0) {
+      result->status = STATUS_OUT_OF_RANGE;
+      break;
+    }
+    bitarray_rotate_ctx(server->ctx, bitarray, op->arg0, op->arg1, op->arg2);
+    break;
+  case OP_RANDFILL:
+    srand((unsigned int) op->arg0);
+    bitarray_randfill(bitarray);
+    break;
+  case OP_FIND:
+    if (op->arg2 < 1 || op->arg2 > 64) {
+      result->status = STATUS_OUT_OF_RANGE;
+      break;
+    }
+    result->value = bitarray_find_pattern(bitarray, op->arg0, op->arg1,
+                                          op->arg2);
+    break;
+  default:
+    result->status = STATUS_BAD_OPCODE;
+  }
+}
+
+static ssize_t server_execute_batch(server_t* const server,
+                                    const size_t payload_sz) {
+  const char* cursor = (const char*) server->request;
+  const char* const end = cursor + payload_sz;
+
+  if (payload_sz < sizeof(batch_header_t)) {
+    return -1;
+  }
+  batch_header_t header;
+  memcpy(&header, cursor, sizeof(header));
+  cursor += sizeof(header);
+
+  // Each op occupies at least sizeof(op_t) bytes, which bounds num_ops.
+  if (header.num_ops > (size_t) (end - cursor) / sizeof(op_t)) {
+    return -1;
+  }
+  const size_t response_sz =
+    sizeof(batch_header_t) + header.num_ops * sizeof(result_t);
+  if (response_sz > server->response_sz) {
+    void* const grown = realloc(server->response, response_sz);
+    if (grown == NULL) {
+      return -1;
+    }
+    server->response = grown;
+    server->response_sz = response_sz;
+  }
+
+  // The response echoes the header, followed by one result per op.
+  memcpy(server->response, &header, sizeof(header));
+  result_t* const out =
+    (result_t*) ((char*) server->response + sizeof(batch_header_t));
+
+  for (uint32_t i = 0; i < header.num_ops; i++) {
+    if ((size_t) (end - cursor) < sizeof(op_t)) {
+      return -1;
+    }
+    op_t op;
+    memcpy(&op, cursor, sizeof(op));
+    cursor += sizeof(op);
+
+    result_t result = { .status = STATUS_OK, .reserved = 0, .value = 0 };
+    if (op.opcode == OP_OPEN) {
+      // The name follows the op, padded to a multiple of 8 bytes.
+      const size_t padded_len = (op.arg1 + 7) & ~(size_t) 7;
+      if (op.arg1 > PROTOCOL_MAX_NAME ||
+          padded_len > (size_t) (end - cursor)) {
+        return -1;
+      }
+      server_open(server, cursor, op.arg1, op.arg0, &result);
+      cursor += padded_len;
+    } else {
+      server_execute(server, &op, &result);
+    }
+    memcpy(&out[i], &result, sizeof(result));
+  }
+  return header.num_ops;
+}
+
+int server_serve(server_t* const server, const int in_fd, const int out_fd) {
+  while (true) {
+    const ssize_t payload_sz =
+      protocol_read_frame(in_fd, &server->request, &server->request_sz);
+    if (payload_sz == 0) {
+      return 0;
+    }
+    if (payload_sz < 0) {
+      return -1;
+    }
+
+    const ssize_t num_results = server_execute_batch(server, payload_sz);
+    if (num_results < 0) {
+      fprintf(stderr, "everybit server: malformed batch\n");
+      return -1;
+    }
+    if (protocol_write_frame(out_fd, server->response,
+                             sizeof(batch_header_t) +
+                             num_results * sizeof(result_t)) != 0) {
+      return -1;
+    }
+  }
+}
+
+int server_listen(server_t* const server, const char* const socket_path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "everybit server: socket path too long\n");
+    return -1;
+  }
+  strcpy(addr.sun_path, socket_path);
+
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    perror("socket");
+    return -1;
+  }
+  unlink(socket_path);
+  if (bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, 8) != 0) {
+    perror("bind");
+    close(listen_fd);
+    return -1;
+  }
+
+  // A client hanging up mid-response should not take the server down.
+  signal(SIGPIPE, SIG_IGN);
+
+  while (true) {
+    const int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      perror("accept");
+      continue;
+    }
+    server_serve(server, fd, fd);
+    close(fd);
+  }
+}
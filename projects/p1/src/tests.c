@@ -23,12 +23,15 @@
 #define _GNU_SOURCE
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "bitarray.h"
+#include "bitfile.h"
 #include "ktiming.h"
 #include "tests.h"
 
@@ -52,6 +55,13 @@ void testutil_rotate(const size_t bit_offset,
                      const size_t bit_length,
                      const ssize_t bit_right_shift_amount);
 
+// Rotates test_bitarray by writing it to a temporary file, rotating the file
+// out-of-core with the smallest allowed memory cap, and reading it back.
+// Requires that test_bitarray is not NULL.
+void testutil_rotate_file(const size_t bit_offset,
+                          const size_t bit_length,
+                          const ssize_t bit_right_shift_amount);
+
 // Checks that the rotation is valid given the size of test_bitarray.
 // Causes a test suite failure if the input is invalid.
 void testutil_require_valid_input(const size_t bit_offset,
@@ -79,6 +89,18 @@ static void testutil_expect_internal(const char* const bitstring,
                                      const char* const func_name,
                                      const int line);
 
+// Verifies that the first occurrence of the pattern bitstring at or after
+// bit_offset in test_bitarray is at expected_index (-1 if there is none), and
+// that the find-all variant reports expected_count occurrences.
+// Outputs FAIL or PASS as appropriate.
+// Requires that test_bitarray is not NULL.
+static void testutil_expect_find_internal(const size_t bit_offset,
+                                          const char* const bitstring,
+                                          const ssize_t expected_index,
+                                          const size_t expected_count,
+                                          const char* const func_name,
+                                          const int line);
+
 // Converts a character into a boolean.  The character '1' converts to true;
 // the character '0' converts to false.
 static bool boolfromchar(const char c);
@@ -236,6 +258,45 @@ static void testutil_expect_internal(const char* bitstring,
   free(actual_bitstring);
 }
 
+static void testutil_expect_find_internal(const size_t bit_offset,
+                                          const char* const bitstring,
+                                          const ssize_t expected_index,
+                                          const size_t expected_count,
+                                          const char* const func_name,
+                                          const int line) {
+  assert(test_bitarray != NULL);
+
+  // Pack the bitstring into a word; character i becomes bit i.
+  const size_t pattern_len = strlen(bitstring);
+  assert(pattern_len >= 1 && pattern_len <= 64);
+  uint64_t pattern = 0;
+  for (size_t i = 0; i < pattern_len; i++) {
+    pattern |= (uint64_t) boolfromchar(bitstring[i]) << i;
+  }
+
+  const ssize_t actual_index =
+    bitarray_find_pattern(test_bitarray, bit_offset, pattern, pattern_len);
+  if (actual_index != expected_index) {
+    TEST_FAIL_WITH_NAME(func_name, line, " Incorrect find index.\n    "
+                        "Expected: %zd\n    Actual:   %zd",
+                        expected_index, actual_index);
+    return;
+  }
+
+  // The find-all variant must agree with the first match and the count.
+  size_t first_match = 0;
+  const size_t actual_count = bitarray_find_pattern_all(
+    test_bitarray, bit_offset, pattern, pattern_len, &first_match, 1);
+  if (actual_count != expected_count ||
+      (actual_count > 0 && (ssize_t) first_match != expected_index)) {
+    TEST_FAIL_WITH_NAME(func_name, line, " Incorrect find count.\n    "
+                        "Expected: %zu\n    Actual:   %zu",
+                        expected_count, actual_count);
+    return;
+  }
+  TEST_PASS_WITH_NAME(func_name, line);
+}
+
 void testutil_rotate(const size_t bit_offset,
                      const size_t bit_length,
                      const ssize_t bit_right_shift_amount) {
@@ -248,6 +309,61 @@ void testutil_rotate(const size_t bit_offset,
   }
 }
 
+void testutil_rotate_file(const size_t bit_offset,
+                          const size_t bit_length,
+                          const ssize_t bit_right_shift_amount) {
+  assert(test_bitarray != NULL);
+
+  // Pack the bits the same way bitarray does, so the file is in the format
+  // bitfile_rotate expects.
+  const size_t bit_sz = bitarray_get_bit_sz(test_bitarray);
+  const size_t buf_sz = (bit_sz + 7) / 8;
+  uint8_t* const buf = calloc(1, buf_sz + 1);
+  for (size_t i = 0; i < bit_sz; i++) {
+    buf[i / 8] |= bitarray_get(test_bitarray, i) << (i % 8);
+  }
+
+  char path[] = "/tmp/everybit-XXXXXX";
+  const int fd = mkstemp(path);
+  assert(fd >= 0);
+  if (write(fd, buf, buf_sz) != (ssize_t) buf_sz) {
+    TEST_FAIL("Could not write %s", path);
+  }
+  close(fd);
+
+  bitfile_progress_t progress;
+  const bitfile_options_t options = {
+    .memory_cap = BITFILE_MIN_MEMORY_CAP,
+    .progress = &progress,
+  };
+  if (bitfile_rotate(path, bit_offset, bit_length, bit_right_shift_amount,
+                     &options) != 0) {
+    TEST_FAIL("Could not rotate %s", path);
+  }
+
+  FILE* const f = fopen(path, "rb");
+  if (f == NULL || fread(buf, 1, buf_sz, f) != buf_sz) {
+    TEST_FAIL("Could not read %s", path);
+  }
+  if (f != NULL) {
+    fclose(f);
+  }
+  unlink(path);
+
+  for (size_t i = 0; i < bit_sz; i++) {
+    bitarray_set(test_bitarray, i, (buf[i / 8] >> (i % 8)) & 1);
+  }
+  free(buf);
+
+  if (test_verbose) {
+    bitarray_fprint(stdout, test_bitarray);
+    fprintf(stdout, " rotate_file off=%zu, len=%zu, amnt=%zd, bits=%lu/%lu\n",
+            bit_offset, bit_length, bit_right_shift_amount,
+            (unsigned long) progress.bits_done,
+            (unsigned long) progress.bits_total);
+  }
+}
+
 void testutil_require_valid_input(const size_t bit_offset,
                                   const size_t bit_length,
                                   const ssize_t bit_right_shift_amount,
@@ -263,7 +379,7 @@ void testutil_require_valid_input(const size_t bit_offset,
 }
 
 // Precomputed array of fibonacci numbers
-const int FIB_SIZE = 53;
+#define FIB_SIZE 53
 const double fibs[FIB_SIZE] = {
   1, 2, 3, 5, 8, 13, 21, 34, 55, 89, 144, 233, 377, 610, 987, 1597, 2584, 4181,
   6765, 10946, 17711, 28657, 46368, 75025, 121393, 196418, 317811, 514229,
@@ -397,6 +513,31 @@ void parse_and_run_tests(const char* filename, int selected_test) {
         testutil_rotate(offset, length, amount);
       }
       break;
+    case 'x':
+      if (!ready_to_run) {
+        continue;
+      }
+      {
+        size_t offset = (size_t) NEXT_ARG_LONG();
+        size_t length = (size_t) NEXT_ARG_LONG();
+        ssize_t amount = (ssize_t) NEXT_ARG_LONG();
+        testutil_require_valid_input(offset, length, amount, filename, line);
+        testutil_rotate_file(offset, length, amount);
+      }
+      break;
+    case 'f':
+      if (!ready_to_run) {
+        continue;
+      }
+      {
+        size_t offset = (size_t) NEXT_ARG_LONG();
+        char* pattern = strtok(NULL, " ");
+        ssize_t index = (ssize_t) NEXT_ARG_LONG();
+        size_t count = (size_t) NEXT_ARG_LONG();
+        testutil_expect_find_internal(offset, pattern, index, count,
+                                      filename, line);
+      }
+      break;
     default:
       fprintf(stderr, "Unknown command %s", buf);
     }
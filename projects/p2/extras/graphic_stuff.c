@@ -47,7 +47,7 @@ int windowwidth;
 int windowheight;
 
 static void drawLineSegments(Display *display, Drawable drawable) {
-  Line *line;
+  Line line;
   unsigned int nsegments;
   window_dimension px1;
   window_dimension py1;
@@ -85,10 +85,10 @@ static void drawLineSegments(Display *display, Drawable drawable) {
     line = LineDemo_getLine(gLineDemo, i);
 
     // Convert box coordinates to window coordinates.
-    boxToWindow(&px1, &py1, line->p1.x, line->p1.y);
-    boxToWindow(&px2, &py2, line->p2.x, line->p2.y);
+    boxToWindow(&px1, &py1, line.p1.x, line.p1.y);
+    boxToWindow(&px2, &py2, line.p2.x, line.p2.y);
     // Set line color.
-    switch (line->color) {
+    switch (line.color) {
       case RED:
         // Convert doubles to short ints and store into segments.
         segments[red_segments_count].x1 = (int16_t) px1;
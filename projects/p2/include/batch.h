@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Throughput mode: simulating many independent worlds at once.  A manifest
+// lists the jobs, one per line, as an input file (text or binary scene) and
+// a number of frames:
+//
+//   # comments and blank lines are ignored
+//   data/box.in 1000
+//   scenes/gas-100000-1.scn 200
+//
+// Every job gets a LineDemo of its own, and the jobs are handed out to a
+// fixed pool of worker threads, each running one world at a time on a
+// single thread.
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdbool.h>
+
+#include "collision_world.h"
+
+// A job, and its results once it has run.
+struct BatchJob {
+  char* inputFilePath;
+  unsigned int numFrames;
+
+  // Results; valid only once the batch has run.
+  bool ok;
+  unsigned int numOfLines;
+  unsigned int framesSimulated;
+  double seconds;
+  unsigned int numLineWallCollisions;
+  unsigned int numLineLineCollisions;
+};
+typedef struct BatchJob BatchJob;
+
+struct Batch {
+  BatchJob* jobs;
+  unsigned int numJobs;
+
+  // Wall time the whole batch took to run.
+  double seconds;
+};
+typedef struct Batch Batch;
+
+// Reads the jobs listed in a manifest.  Prints a message to stderr and
+// returns NULL if the manifest cannot be read or is malformed.
+Batch* Batch_readManifest(const char* path);
+
+void Batch_delete(Batch* batch);
+
+// Runs every job with the given broad phase, pair cache and kinetic
+// settings, on numWorkers threads (0 for one per core).
+void Batch_run(Batch* batch, const BroadPhase broadPhase,
+               const bool usePairCache, const bool useKinetic,
+               const int numWorkers);
+
+// Prints each job's results, and the worlds x frames simulated per second.
+void Batch_print(const Batch* batch);
+
+// Returns the number of jobs that failed to run.
+unsigned int Batch_numFailed(const Batch* batch);
+
+#endif  // BATCH_H_
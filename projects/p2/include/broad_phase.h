@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// The broad phases: algorithms for finding the line pairs that are passed on
+// to intersect().  Every broad phase finds the same intersections; they
+// differ only in speed.
+#ifndef BROADPHASE_H_
+#define BROADPHASE_H_
+
+typedef enum {
+  // Test all n(n-1)/2 pairs.
+  BROAD_PHASE_BRUTE_FORCE,
+  // Test only pairs whose swept boxes share a cell of a uniform grid.
+  BROAD_PHASE_GRID,
+  // Test each line against the lines stored in its own quadtree node and
+  // below it.
+  BROAD_PHASE_QUADTREE,
+  // Sweep across the boxes' x-intervals, kept sorted from frame to frame.
+  BROAD_PHASE_SWEEP_AND_PRUNE,
+  // Walk a bounding volume hierarchy, refit from frame to frame, against
+  // itself.
+  BROAD_PHASE_BVH,
+  // Pick one of the above, and tune its parameters, by measuring them as the
+  // simulation runs; see broad_phase_tuner.h.
+  BROAD_PHASE_AUTO,
+  NUM_BROAD_PHASES
+} BroadPhase;
+
+// Returns the name of a broad phase, as given to the screensaver's -b.
+static inline const char* BroadPhase_name(const BroadPhase broadPhase) {
+  static const char* NAMES[NUM_BROAD_PHASES] = {
+    "brute", "grid", "quadtree", "sweep", "bvh", "auto"
+  };
+  return NAMES[broadPhase];
+}
+
+#endif  // BROADPHASE_H_
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Picks the broad phase, and its parameters, for BROAD_PHASE_AUTO by
+// measuring them on the running simulation.  The right choice depends on how
+// many lines there are, how long they are and how they cluster, all of which
+// change as a scene evolves.
+//
+// The tuner first explores: it runs each broad phase for a few frames, and
+// measures the time per frame of the broad and narrow phases together and
+// the pairs tested.  It then runs the fastest, and every
+// TUNER_SAMPLE_FRAMES frames tries a step of its parameter (the grid's
+// resolution scale or the quadtree's leaf capacity) either way, keeping the
+// step if it helped.  Every TUNER_SAMPLE_FRAMES frames it also samples the
+// line distribution, and explores again when the distribution has shifted,
+// or TUNER_EPOCH_FRAMES after the last exploration.
+#ifndef BROADPHASETUNER_H_
+#define BROADPHASETUNER_H_
+
+#include <stdbool.h>
+
+#include "broad_phase.h"
+#include "swept_box.h"
+
+// Frames between samples of the line distribution, and between parameter
+// steps.
+#ifndef TUNER_SAMPLE_FRAMES
+#define TUNER_SAMPLE_FRAMES 32
+#endif
+
+// Frames each broad phase or parameter step is measured over, after one
+// frame to build its state.
+#ifndef TUNER_TRIAL_FRAMES
+#define TUNER_TRIAL_FRAMES 8
+#endif
+
+// Frames after which the broad phases are explored again anyway.
+#ifndef TUNER_EPOCH_FRAMES
+#define TUNER_EPOCH_FRAMES 1024
+#endif
+
+// A sampled statistic that changes by more than this factor either way since
+// the last exploration sets off a new one.
+#define TUNER_SHIFT_RATIO 1.5
+
+// A broad phase more than this many times slower than the best is left out
+// of the explorations set off by TUNER_EPOCH_FRAMES, and a trial is cut short
+// once a frame is this many times slower than the best so far.
+#define TUNER_RETRY_RATIO 4.0
+
+// A parameter step is kept only if it saves at least this fraction of the
+// time per frame.
+#define TUNER_MIN_GAIN 0.05
+
+// Side of the grid of cells whose occupancy is sampled.
+#define TUNER_OCCUPANCY_RESOLUTION 32
+
+// What the tuner samples of the line distribution.  Lengths are in box
+// coordinates.
+struct TunerSample {
+  double meanLength;
+  // Mean half perimeter of the swept boxes.
+  double meanExtent;
+  // Fraction of the TUNER_OCCUPANCY_RESOLUTION^2 cells of the box holding
+  // the center of at least one swept box.
+  double occupancy;
+};
+typedef struct TunerSample TunerSample;
+
+typedef enum {
+  TUNER_EXPLORING,
+  TUNER_RUNNING,
+  TUNER_STEPPING
+} TunerState;
+
+struct BroadPhaseTuner {
+  // The broad phase to run on the coming frame, and the parameters.
+  BroadPhase broadPhase;
+  double gridScale;
+  unsigned int leafCapacity;
+
+  TunerState state;
+
+  // The broad phase the last exploration settled on.
+  BroadPhase settledBroadPhase;
+
+  // Time per frame, in seconds, and pairs tested per frame, that each broad
+  // phase last measured; 0 if it has not been measured.
+  double seconds[NUM_BROAD_PHASES];
+  double pairs[NUM_BROAD_PHASES];
+
+  // While exploring, which broad phases are still to be tried.
+  bool toExplore[NUM_BROAD_PHASES];
+
+  // The frames measured since the trial (of a broad phase, a parameter step
+  // or, while running, of the current settings) began, including the one
+  // that builds the state, and their totals.
+  unsigned int trialFrames;
+  double trialSeconds;
+  double trialPairs;
+
+  // While stepping, the parameters to go back to and the time per frame to
+  // beat, and which way the next step goes.
+  double savedGridScale;
+  unsigned int savedLeafCapacity;
+  double baselineSeconds;
+  bool stepUp;
+
+  // Frames since the last exploration, and the sample taken for it.
+  unsigned int framesSinceExploration;
+  TunerSample exploredSample;
+  TunerSample sample;
+  unsigned int framesSinceSample;
+  unsigned char occupied[TUNER_OCCUPANCY_RESOLUTION
+                         * TUNER_OCCUPANCY_RESOLUTION];
+
+  // Number of times the broad phase or a parameter has been changed.
+  unsigned long long numChanges;
+};
+typedef struct BroadPhaseTuner BroadPhaseTuner;
+
+BroadPhaseTuner* BroadPhaseTuner_new();
+
+void BroadPhaseTuner_delete(BroadPhaseTuner* tuner);
+
+// Records a frame run with tuner->broadPhase and the parameters: seconds
+// spent in the broad and narrow phases and the pairs tested, and the lines,
+// for sampling.  Picks the broad phase and parameters for the next frame.
+// Returns true if the tuner settled on a new broad phase or parameter.
+bool BroadPhaseTuner_endFrame(BroadPhaseTuner* tuner, const double seconds,
+                              const unsigned long long numPairs,
+                              const double* p1x, const double* p1y,
+                              const double* p2x, const double* p2y,
+                              const SweptBox* boxes,
+                              const unsigned int numOfLines);
+
+#endif  // BROADPHASETUNER_H_
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Bounding volume hierarchy broad phase: finds the pairs of lines whose swept
+// boxes overlap by walking a binary tree of boxes against itself.  The tree is
+// built with the binned surface area heuristic, which splits where the boxes
+// actually are, so it copes with a wide spread of line lengths that leaves a
+// grid's cells or a quadtree's nodes unbalanced.  Between rebuilds, the tree
+// keeps its shape and only its boxes are refit to the lines' new swept boxes.
+#ifndef BVH_H_
+#define BVH_H_
+
+#include <stdbool.h>
+
+#include "candidate_list.h"
+#include "line.h"
+#include "swept_box.h"
+
+// Tuning; override with -D to experiment.  A node holding at most
+// BVH_LEAF_SIZE lines is a leaf.  Splits are chosen among BVH_NUM_BINS - 1
+// planes per node.  The tree is rebuilt once refitting has made its cost
+// (see Bvh) more than BVH_REBUILD_RATIO times its cost when it was built.
+#ifndef BVH_LEAF_SIZE
+#define BVH_LEAF_SIZE 4
+#endif
+#ifndef BVH_NUM_BINS
+#define BVH_NUM_BINS 16
+#endif
+#ifndef BVH_REBUILD_RATIO
+#define BVH_REBUILD_RATIO 1.25
+#endif
+
+// A node of the tree, stored in a flat array in which every node comes before
+// its children, so that a backward pass over the array visits children first.
+struct BvhNode {
+  // Union of the swept boxes of the lines below the node.
+  SweptBox box;
+
+  // A leaf holds the count > 0 lines lines[first .. first + count); an
+  // internal node (count == 0) has its two children at first and first + 1.
+  unsigned int first;
+  unsigned int count;
+};
+typedef struct BvhNode BvhNode;
+
+struct Bvh {
+  // The nodes, and the lines of the leaves, by index into the caller's boxes.
+  BvhNode* nodes;
+  unsigned int numNodes;
+  unsigned int* lines;
+  unsigned int numOfLines;
+
+  // The tree's cost: the sum over the nodes of their half perimeters,
+  // weighted by the number of lines in leaves, relative to the root's half
+  // perimeter.  It estimates the box tests and pair tests a traversal does,
+  // and grows as refitting loosens the boxes.
+  double cost;
+  double builtCost;
+
+  // Work lists for building (node, first line, end line) and for the
+  // traversal (pairs of nodes); kept between frames.
+  unsigned int* stack;
+  unsigned int stackCapacity;
+
+  // The pairs as the traversal finds them, and where each line's pairs start
+  // once grouped by their first line; kept between frames.
+  CandidateList pairs;
+  unsigned int* pairStarts;
+};
+typedef struct Bvh Bvh;
+
+Bvh* Bvh_new();
+
+void Bvh_delete(Bvh* bvh);
+
+// Appends to candidates every pair of lines whose swept boxes overlap, each
+// pair exactly once and each line's pairs consecutively, given the swept box
+// of every line.  Refits last frame's tree to the boxes, and rebuilds it if
+// the number of lines changed or the tree's cost passed BVH_REBUILD_RATIO
+// times its cost when built.  Returns false (with candidates incomplete) if
+// memory ran out.
+bool Bvh_findCandidates(Bvh* bvh, const SweptBox* boxes,
+                        const unsigned int numOfLines,
+                        CandidateList* candidates);
+
+#endif  // BVH_H_
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Growable array of line pairs produced by a broad phase, to be checked
+// exactly by intersect().  Lines are identified by their index in the
+// collision world.
+#ifndef CANDIDATELIST_H_
+#define CANDIDATELIST_H_
+
+#include <stdbool.h>
+
+struct CandidatePair {
+  unsigned int i;
+  unsigned int j;
+};
+typedef struct CandidatePair CandidatePair;
+
+struct CandidateList {
+  CandidatePair* pairs;
+  unsigned int size;
+  // Number of pairs that fit in pairs before it must grow.  The storage is
+  // kept across CandidateList_clear, so reusing a list stops allocating once
+  // the largest frame has been seen.
+  unsigned int capacity;
+  // Whether an append could not grow the storage and dropped its pair since
+  // the last CandidateList_clear, so that the list is incomplete.
+  bool overflowed;
+};
+typedef struct CandidateList CandidateList;
+
+// Returns a new, empty list.
+CandidateList CandidateList_make();
+
+// Grows the list's storage so that it can hold at least capacity pairs.
+// Returns false if memory could not be allocated.
+bool CandidateList_reserve(CandidateList* candidateList,
+                           const unsigned int capacity);
+
+// Adds a pair to the end of the list.  If memory could not be allocated, the
+// pair is dropped and the list marked as overflowed.
+static inline void CandidateList_append(CandidateList* candidateList,
+                                        const unsigned int i,
+                                        const unsigned int j) {
+  if (candidateList->size == candidateList->capacity
+      && !CandidateList_reserve(candidateList,
+                                2 * candidateList->capacity + 64)) {
+    candidateList->overflowed = true;
+    return;
+  }
+  candidateList->pairs[candidateList->size].i = i;
+  candidateList->pairs[candidateList->size].j = j;
+  candidateList->size++;
+}
+
+// Removes every pair, keeping the storage for reuse, and clears the overflow.
+void CandidateList_clear(CandidateList* candidateList);
+
+// Frees the storage; the list is empty afterwards.
+void CandidateList_delete(CandidateList* candidateList);
+
+#endif  // CANDIDATELIST_H_
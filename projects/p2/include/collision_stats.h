@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Per-phase statistics of the collision pipeline: the wall time each phase of
+// CollisionWorld_updateLines takes, the candidate pairs handed to the narrow
+// phase, and the events of each IntersectionType.  Every frame can be written
+// as a JSON line, and the frames are aggregated into log2 histograms.  The
+// settings that BROAD_PHASE_AUTO picks are written as JSON lines too.
+//
+// Recording costs a few clock reads per frame while statistics are enabled,
+// and a NULL test per phase otherwise.  Building with -DCOLLISION_STATS=0
+// (make STATS=0) removes the recording from the collision code altogether.
+#ifndef COLLISIONSTATS_H_
+#define COLLISIONSTATS_H_
+
+#include <stdio.h>
+
+#include "broad_phase_tuner.h"
+#include "intersection_detection.h"
+#include "intersection_event_list.h"
+
+#ifndef COLLISION_STATS
+#define COLLISION_STATS 1
+#endif
+
+// The phases of a frame, in the order they run.
+typedef enum {
+  STATS_BROAD_PHASE,      // swept boxes and candidate pairs
+  STATS_NARROW_PHASE,     // intersect() on the candidate pairs
+  STATS_EVENT_SORT,       // gathering and sorting the events
+  STATS_SOLVER,           // the collision solver
+  STATS_POSITION_UPDATE,  // moving the lines
+  STATS_WALL_COLLISION,   // bouncing the lines off the walls
+  NUM_STATS_PHASES
+} StatsPhase;
+
+// Number of buckets of every histogram; bucket b counts the values in
+// [2^(b-1), 2^b), and bucket 0 counts zeros.
+#define STATS_HISTOGRAM_BUCKETS 48
+
+typedef struct CollisionStats CollisionStats;
+
+// Returns new, empty statistics, which write a JSON line per frame to output
+// unless it is NULL.  Returns NULL if memory could not be allocated.
+CollisionStats* CollisionStats_new(FILE* output);
+
+// Writes a JSON line with the histograms to the output, if any, and frees
+// the statistics; the output is not closed.
+void CollisionStats_delete(CollisionStats* stats);
+
+// Starts timing a frame.
+void CollisionStats_beginFrame(CollisionStats* stats);
+
+// Charges the time since the previous phase ended (or the frame began) to
+// phase.
+void CollisionStats_endPhase(CollisionStats* stats, const StatsPhase phase);
+
+// Records the pairs handed to the narrow phase this frame.
+void CollisionStats_countCandidates(CollisionStats* stats,
+                                    const unsigned long long numCandidates);
+
+// Records this frame's intersection events.
+void CollisionStats_countEvents(CollisionStats* stats,
+                                const IntersectionEventList* events);
+
+// Records this frame's line-wall collisions.
+void CollisionStats_countWallCollisions(CollisionStats* stats,
+                                        const unsigned int numCollisions);
+
+// Records the broad phase and parameters the tuner has settled on, with what
+// it measured and sampled, as a JSON line.
+void CollisionStats_recordTuning(CollisionStats* stats,
+                                 const BroadPhaseTuner* tuner);
+
+// Adds the frame to the histograms and writes its JSON line.
+void CollisionStats_endFrame(CollisionStats* stats);
+
+// Prints a summary of every frame so far: the time spent in each phase, with
+// approximate medians and 99th percentiles, and the mean counts.
+void CollisionStats_print(const CollisionStats* stats, FILE* out);
+
+// The collision code records its statistics through these macros, which do
+// nothing if stats is NULL or statistics are compiled out.
+#if COLLISION_STATS
+#define COLLISION_STATS_RECORD(stats, function, ...) \
+  do { \
+    if ((stats) != NULL) { \
+      function((stats), ##__VA_ARGS__); \
+    } \
+  } while (0)
+#else
+#define COLLISION_STATS_RECORD(stats, function, ...) \
+  do { \
+    (void) (stats); \
+  } while (0)
+#endif
+
+#endif  // COLLISIONSTATS_H_
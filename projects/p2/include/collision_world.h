@@ -24,16 +24,51 @@
 #ifndef COLLISIONWORLD_H_
 #define COLLISIONWORLD_H_
 
+#include "broad_phase.h"
+#include "broad_phase_tuner.h"
+#include "bvh.h"
+#include "candidate_list.h"
+#include "collision_stats.h"
+#include "frame_arena.h"
+#include "grid.h"
 #include "intersection_detection.h"
+#include "intersection_event_list.h"
+#include "kinetic.h"
 #include "line.h"
+#include "pair_cache.h"
+#include "quadtree.h"
+#include "sweep_and_prune.h"
+#include "swept_box.h"
+
+// Alignment, in bytes, of the per-attribute line arrays; enough for the
+// widest vector loads.
+#define LINE_ARRAY_ALIGNMENT 64
+
+// Frames with fewer intersection events than this are solved serially; below
+// it, the threads would spend longer waiting for each other than solving.
+#ifndef PARALLEL_SOLVER_MIN_EVENTS
+#define PARALLEL_SOLVER_MIN_EVENTS 512
+#endif
 
 struct CollisionWorld {
   // Time step used for simulation
   double timeStep;
 
-  // Container that holds all the lines as an array of Line* lines.
-  // This CollisionWorld owns the Line* lines.
-  Line** lines;
+  // Number of frames simulated so far.
+  unsigned int frame;
+
+  // The lines, stored as a structure of arrays: line i runs from (p1x[i],
+  // p1y[i]) to (p2x[i], p2y[i]) at velocity (vx[i], vy[i]).  Loops over one
+  // attribute of every line thus read contiguous, aligned memory, and can be
+  // vectorized.  Use CollisionWorld_getLine for a Line view of a line.
+  double* p1x;
+  double* p1y;
+  double* p2x;
+  double* p2y;
+  double* vx;
+  double* vy;
+  Color* color;
+  unsigned int* id;
   unsigned int numOfLines;
 
   // Record the total number of line-wall collisions.
@@ -41,6 +76,58 @@ struct CollisionWorld {
 
   // Record the total number of line-line intersections.
   unsigned int numLineLineCollisions;
+
+  // Record the total number of line pairs handed to the narrow phase.
+  unsigned long long numPairsTested;
+
+  // Broad phase used by CollisionWorld_detectIntersection.
+  BroadPhase broadPhase;
+
+  // With BROAD_PHASE_AUTO, picks the broad phase that is run and its
+  // parameters; see broad_phase_tuner.h.
+  BroadPhaseTuner* tuner;
+
+  // If true, classify and resolve collisions with intersectReference and
+  // the original, hypot-based solver; used to validate the faster ones.
+  bool reference;
+
+  // Swept box of every line, recomputed every frame for the broad phase.
+  SweptBox* boxes;
+
+  // State kept by the broad phases between frames.
+  Grid* grid;
+  QuadTree* quadTree;
+  SweepAndPrune* sweepAndPrune;
+  Bvh* bvh;
+  CandidateList candidates;
+
+  // If true (and the broad phase is the grid), the grid runs over inflated
+  // boxes and its pairs are kept across frames; see pair_cache.h.
+  bool usePairCache;
+  PairCache* pairCache;
+
+  // If true, CollisionWorld_updateLines skips the collision work of the
+  // frames that Kinetic_isQuiet shows to be quiet; see kinetic.h.
+  bool useKinetic;
+  Kinetic* kinetic;
+
+  // Events detected this frame, and the lists each thread records its events
+  // in before they are gathered; all reused between frames.
+  IntersectionEventList intersectionEvents;
+  IntersectionEventList* threadEventLists;
+  int numThreadEventLists;
+
+  // The batch of the last event seen for each line (0 if none), kept zeroed
+  // between frames, for solving the events in parallel.
+  unsigned int* lineBatch;
+
+  // Memory needed only during a frame, released at the end of
+  // CollisionWorld_updateLines; see frame_arena.h.
+  FrameArena frameArena;
+
+  // Where CollisionWorld_updateLines records its statistics; NULL if it
+  // should not.
+  CollisionStats* stats;
 };
 typedef struct CollisionWorld CollisionWorld;
 
@@ -52,12 +139,21 @@ void CollisionWorld_delete(CollisionWorld* collisionWorld);
 unsigned int CollisionWorld_getNumOfLines(CollisionWorld* collisionWorld);
 
 // Add a line into the box.  Must be under capacity.
-// This CollisionWorld becomes owner of the Line* line.
+// The line is copied; the caller keeps ownership of the Line* line.
+// Precondition: line->id must equal the number of lines added before it.
 void CollisionWorld_addLine(CollisionWorld* collisionWorld, Line *line);
 
-// Get a line from box.
-Line* CollisionWorld_getLine(CollisionWorld* collisionWorld,
-                             const unsigned int index);
+// Add n lines at once, returning the number of lines before the call; the
+// new lines are those at indices [first, first + n), and the caller must then
+// fill in their positions, velocities and colors.  Their IDs are set.  Must
+// stay under capacity.
+unsigned int CollisionWorld_appendLines(CollisionWorld* collisionWorld,
+                                        const unsigned int n);
+
+// Get a copy of a line from box.
+// Precondition: index must be less than the number of lines.
+Line CollisionWorld_getLine(CollisionWorld* collisionWorld,
+                            const unsigned int index);
 
 // Update lines' situation in the box.
 void CollisionWorld_updateLines(CollisionWorld* collisionWorld);
@@ -68,6 +164,34 @@ void CollisionWorld_updatePosition(CollisionWorld* collisionWorld);
 // Handle line-wall collision.
 void CollisionWorld_lineWallCollision(CollisionWorld* collisionWorld);
 
+// Select the broad phase used to detect line-line intersections.
+void CollisionWorld_setBroadPhase(CollisionWorld* collisionWorld,
+                                  const BroadPhase broadPhase);
+
+// Enable or disable the cache of grid broad phase pairs (enabled by
+// default).
+void CollisionWorld_setPairCache(CollisionWorld* collisionWorld,
+                                 const bool usePairCache);
+
+// Enable or disable skipping the collision work of quiet frames (disabled by
+// default).
+void CollisionWorld_setKinetic(CollisionWorld* collisionWorld,
+                               const bool useKinetic);
+
+// Get the number of frames whose collision work was skipped.
+unsigned long long CollisionWorld_getNumQuietFrames(
+    CollisionWorld* collisionWorld);
+
+// Select the original (reference) or the current intersection
+// classification and collision solver.
+void CollisionWorld_setReference(CollisionWorld* collisionWorld,
+                                 const bool reference);
+
+// Record per-phase statistics of every frame in stats, which the caller
+// keeps ownership of; NULL stops recording.
+void CollisionWorld_setStats(CollisionWorld* collisionWorld,
+                             CollisionStats* stats);
+
 // Detect line-line intersection.
 void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld);
 
@@ -79,6 +203,11 @@ unsigned int CollisionWorld_getNumLineWallCollisions(
 unsigned int CollisionWorld_getNumLineLineCollisions(
     CollisionWorld* collisionWorld);
 
+// Get total number of line pairs handed to the narrow phase, i.e. the pairs
+// that the broad phase could not rule out.
+unsigned long long CollisionWorld_getNumPairsTested(
+    CollisionWorld* collisionWorld);
+
 // Update the two lines based on their intersection event.
 // Precondition: compareLines(l1, l2) < 0 must be true.
 void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld, Line *l1,
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Bump-pointer allocator for memory that lives for a single frame.
+// Allocations come out of one block and are all released at once by
+// FrameArena_reset, in O(1).  A frame that needs more than the block holds
+// gets extra blocks from malloc; the next reset frees them and replaces the
+// block with one at least as large as the most any frame has needed (the
+// high-water mark), so once the largest frame has been seen, no frame
+// allocates from the system.  Not thread-safe.
+#ifndef FRAMEARENA_H_
+#define FRAMEARENA_H_
+
+#include <stddef.h>
+
+// Alignment, in bytes, of every allocation; enough for the widest vector
+// loads.
+#define FRAME_ARENA_ALIGNMENT 64
+
+struct FrameArenaOverflow;
+
+struct FrameArena {
+  // The block, and how many of its bytes are handed out this frame.
+  char* block;
+  size_t capacity;
+  size_t used;
+
+  // Blocks allocated this frame because the block was full.
+  struct FrameArenaOverflow* overflow;
+
+  // Bytes handed out this frame, and the most handed out in any frame.
+  size_t frameBytes;
+  size_t highWater;
+};
+typedef struct FrameArena FrameArena;
+
+// Returns an empty arena; the block is allocated by the first reset after
+// the first allocation.
+FrameArena FrameArena_make();
+
+// Returns size bytes aligned to FRAME_ARENA_ALIGNMENT, valid until the next
+// reset, or NULL if memory could not be allocated.
+void* FrameArena_allocate(FrameArena* arena, const size_t size);
+
+// Releases every allocation.
+void FrameArena_reset(FrameArena* arena);
+
+// Frees the arena's memory; the arena is empty afterwards.
+void FrameArena_delete(FrameArena* arena);
+
+#endif  // FRAMEARENA_H_
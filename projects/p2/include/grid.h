@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Uniform grid broad phase: finds the pairs of lines whose swept boxes share
+// a cell of a grid laid over the box [BOX_XMIN, BOX_XMAX] x [BOX_YMIN,
+// BOX_YMAX].
+#ifndef GRID_H_
+#define GRID_H_
+
+#include <stdbool.h>
+
+#include "candidate_list.h"
+#include "line.h"
+#include "swept_box.h"
+
+// Upper bound on the number of cells along each side of the grid.
+#define GRID_MAX_RESOLUTION 1024
+
+struct Grid {
+  // Number of cells along each side, and the side length of a cell.  Chosen
+  // anew every frame from the number and size of the lines, and multiplied by
+  // resolutionScale (1 unless tuned; see broad_phase_tuner.h).
+  unsigned int resolution;
+  double cellWidth;
+  double cellHeight;
+  double resolutionScale;
+
+  // The lines overlapping cell c are cellLines[cellStart[c]] through
+  // cellLines[cellStart[c + 1] - 1], in increasing index order.
+  unsigned int* cellStart;
+  unsigned int cellStartCapacity;
+  unsigned int* cellLines;
+  unsigned int cellLinesCapacity;
+};
+typedef struct Grid Grid;
+
+Grid* Grid_new();
+
+void Grid_delete(Grid* grid);
+
+// Appends to candidates every pair of lines whose swept boxes overlap, each
+// pair exactly once, given the swept box of every line.  The grid's buffers
+// are reused from frame to frame.
+// Returns false (with candidates incomplete) if memory ran out.
+bool Grid_findCandidates(Grid* grid, const SweptBox* boxes,
+                         const unsigned int numOfLines,
+                         CandidateList* candidates);
+
+// Appends to candidates the pair (i, j) for every line j != i whose box
+// overlaps box, each j once.  Only the lines bucketed by the last
+// Grid_findCandidates are considered, by the boxes they had then, which must
+// be passed as boxes.  If memory runs out, candidates is left marked as
+// overflowed.
+void Grid_findOverlaps(const Grid* grid, const SweptBox* boxes,
+                       const SweptBox* box, const unsigned int i,
+                       CandidateList* candidates);
+
+#endif  // GRID_H_
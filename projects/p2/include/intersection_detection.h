@@ -33,10 +33,39 @@ typedef enum {
   ALREADY_INTERSECTED
 } IntersectionType;
 
+// Number of lines intersectBlock screens at once.  Eight doubles fill two AVX
+// registers or four SSE2 ones.
+#define INTERSECT_BLOCK_SIZE 8
+
+// A block of lines packed lane by lane, so that intersectBlock can evaluate
+// all of them with the same instructions.
+struct LineBlock {
+  double p1x[INTERSECT_BLOCK_SIZE];
+  double p1y[INTERSECT_BLOCK_SIZE];
+  double p2x[INTERSECT_BLOCK_SIZE];
+  double p2y[INTERSECT_BLOCK_SIZE];
+  double vx[INTERSECT_BLOCK_SIZE];
+  double vy[INTERSECT_BLOCK_SIZE];
+  unsigned int id[INTERSECT_BLOCK_SIZE];
+};
+typedef struct LineBlock LineBlock;
+
 // Detect if line l1 and l2 will be intersected in the next time step.
 // Precondition: compareLines(l1, l2) < 0 must be true.
 IntersectionType intersect(Line *l1, Line *l2, double time);
 
+// Same as intersect, but computes the angle between the lines with atan2, as
+// the original code did.  Kept to validate intersect against.
+IntersectionType intersectReference(Line *l1, Line *l2, double time);
+
+// Screen line against every line in block.  Returns a mask with bit k set if
+// line and lane k may intersect in the next time step; if bit k is clear,
+// intersect() would return NO_INTERSECTION for the pair.  All lanes are
+// evaluated, so lanes past the ones in use must hold finite values.
+// Precondition: no lane holds line itself.
+unsigned int intersectBlock(const Line *line, const LineBlock *block,
+                            double time);
+
 // Check if a point is in the parallelogram.
 bool pointInParallelogram(Vec point, Vec p1, Vec p2, Vec p3, Vec p4);
 
@@ -20,49 +20,96 @@
  * SOFTWARE.
  **/
 
+
 #ifndef INTERSECTIONEVENTLIST_H_
 #define INTERSECTIONEVENTLIST_H_
 
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "intersection_detection.h"
 #include "line.h"
 
-struct IntersectionEventNode {
-  // This IntersectionEventNode does not own these Line* lines.
-  Line* l1;
-  Line* l2;
+// A detected intersection between the lines with IDs id1 < id2.
+struct IntersectionEvent {
+  unsigned int id1;
+  unsigned int id2;
   IntersectionType intersectionType;
-  struct IntersectionEventNode* next;
 };
-typedef struct IntersectionEventNode IntersectionEventNode;
+typedef struct IntersectionEvent IntersectionEvent;
 
-// Compares the nodes by l1's line ID, then l1's line ID.
-// -1 <=> node1 ordered before node2
-//  0 <=> node1 ordered the same as node2
-//  1 <=> node1 ordered after node2
-int IntersectionEventNode_compareData(IntersectionEventNode* node1,
-                                      IntersectionEventNode* node2);
+// Returns the key events are sorted by: (id1, id2) packed so that comparing
+// keys compares id1 first, then id2.
+static inline uint64_t IntersectionEvent_key(const IntersectionEvent* event) {
+  return ((uint64_t) event->id1 << 32) | event->id2;
+}
 
-// Swaps the node1's and node2's data (l1, l2, intersectionType).
-void IntersectionEventNode_swapData(IntersectionEventNode* node1,
-                                    IntersectionEventNode* node2);
+// Compares the events by id1, then id2.
+// -1 <=> event1 ordered before event2
+//  0 <=> event1 ordered the same as event2
+//  1 <=> event1 ordered after event2
+int IntersectionEvent_compareData(const IntersectionEvent* event1,
+                                  const IntersectionEvent* event2);
 
+// Growable array of events.  The storage is kept when the list is cleared, so
+// a list reused from frame to frame stops allocating once the busiest frame
+// has been seen.
 struct IntersectionEventList {
-  IntersectionEventNode* head;
-  IntersectionEventNode* tail;
+  IntersectionEvent* events;
+  unsigned int size;
+  unsigned int capacity;
 };
 typedef struct IntersectionEventList IntersectionEventList;
 
 // Returns an empty list.
 IntersectionEventList IntersectionEventList_make();
 
-// Appends a new node to the list with the data (l1, l2, intersectionType).
+// Grows the list's storage so that it can hold at least capacity events.
+// Returns false if memory could not be allocated.
+bool IntersectionEventList_reserve(
+    IntersectionEventList* intersectionEventList,
+    const unsigned int capacity);
+
+// Appends a new event to the list with the data (l1, l2, intersectionType).
+// Returns false, without appending, if memory could not be allocated.
 // Precondition: compareLines(l1, l2) < 0 must be true.
-void IntersectionEventList_appendNode(
+static inline bool IntersectionEventList_append(
     IntersectionEventList* intersectionEventList, Line* l1, Line* l2,
-    IntersectionType intersectionType);
+    IntersectionType intersectionType) {
+  assert(compareLines(l1, l2) < 0);
+  if (intersectionEventList->size == intersectionEventList->capacity
+      && !IntersectionEventList_reserve(
+          intersectionEventList, 2 * intersectionEventList->capacity + 64)) {
+    return false;
+  }
+  IntersectionEvent* event =
+      &intersectionEventList->events[intersectionEventList->size++];
+  event->id1 = l1->id;
+  event->id2 = l2->id;
+  event->intersectionType = intersectionType;
+  return true;
+}
+
+// Copies all of other's events to the end of the list, leaving other empty.
+// The storage grows geometrically, as for IntersectionEventList_append.
+// Returns false, leaving both lists unchanged, if memory could not be
+// allocated.
+bool IntersectionEventList_concat(
+    IntersectionEventList* intersectionEventList,
+    IntersectionEventList* other);
+
+// Sorts the events into IntersectionEvent_compareData order with an LSD
+// radix sort on IntersectionEvent_key, which ping-pongs between the list's
+// storage and scratch, a buffer of at least as many events as the list holds.
+void IntersectionEventList_sort(IntersectionEventList* intersectionEventList,
+                                IntersectionEvent* scratch);
+
+// Removes every event, keeping the storage for reuse.
+void IntersectionEventList_clear(IntersectionEventList* intersectionEventList);
 
-// Deletes all the nodes in the list.
-void IntersectionEventList_deleteNodes(
+// Frees the storage; the list is empty afterwards.
+void IntersectionEventList_delete(
     IntersectionEventList* intersectionEventList);
 
 #endif  // INTERSECTIONEVENTLIST_H_
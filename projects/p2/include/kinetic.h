@@ -0,0 +1,124 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Kinetic scheduling of the frames that need collision work.  Between
+// collisions every line moves in a straight line, so how soon a pair of lines
+// could possibly intersect, or a line reach a wall, can be bounded ahead of
+// time.  The bounds are kept in a priority queue, and a frame before the
+// earliest of them is quiet: it has no line-line or line-wall collision, so
+// it only needs its positions updated.
+//
+// The bounds are conservative, so that skipping the collision work of quiet
+// frames changes nothing: the positions are still advanced one frame at a
+// time, as in the frame-stepped simulation, and come out bit-identical.
+#ifndef KINETIC_H_
+#define KINETIC_H_
+
+#include <stdbool.h>
+
+#include "candidate_list.h"
+#include "grid.h"
+#include "swept_box.h"
+
+// Frames of motion that the pairs are searched over: a pair whose lines'
+// boxes cannot meet within this many frames gets no event, and every bound
+// is recomputed from scratch this often, which also keeps the rounding of
+// the positions well below KINETIC_SLACK.
+#ifndef KINETIC_HORIZON_FRAMES
+#define KINETIC_HORIZON_FRAMES 64
+#endif
+
+// Most frames stepped without scheduling after a collision.  When
+// rescheduling after a collision shows that the next frame needs collision
+// work anyway, the scene is busy, and scheduling is put off for twice as many
+// frames as the last time, up to this many.
+#ifndef KINETIC_MAX_BACKOFF
+#define KINETIC_MAX_BACKOFF 256
+#endif
+
+// Distance, in box coordinates, subtracted from every gap before it is
+// divided by a speed, to cover the rounding of the positions.
+#define KINETIC_SLACK 1e-9
+
+// Marks a line's wall event, in place of the second line.
+#define KINETIC_WALL 0xffffffffu
+
+// Marks the event that recomputes every bound, in place of both lines.
+#define KINETIC_RESCAN 0xfffffffeu
+
+// The earliest frame on which lines i and j might intersect, or line i (if
+// j is KINETIC_WALL) might hit a wall.
+struct KineticEvent {
+  unsigned int frame;
+  unsigned int i;
+  unsigned int j;
+};
+typedef struct KineticEvent KineticEvent;
+
+struct Kinetic {
+  // Binary min-heap of events by frame; empty if the events are out of date.
+  KineticEvent* events;
+  unsigned int numEvents;
+  unsigned int eventsCapacity;
+
+  // Frame on which every event is recomputed.  An event that would fall on
+  // or after it is left out.
+  unsigned int rescanFrame;
+
+  // Swept boxes, and the boxes inflated to cover KINETIC_HORIZON_FRAMES of
+  // motion that the grid finds the nearby pairs with; indexed like the lines.
+  SweptBox* boxes;
+  SweptBox* fatBoxes;
+  unsigned int capacity;
+  Grid* grid;
+  CandidateList pairs;
+
+  // Number of lines the events were computed for.
+  unsigned int numOfLines;
+
+  // After a collision, the events are not recomputed before frame
+  // steppedUntil, and backoff is how many frames to put it off by the next
+  // time it turns out not to pay.
+  unsigned int steppedUntil;
+  unsigned int backoff;
+
+  // Number of frames found quiet.
+  unsigned long long numQuietFrames;
+};
+typedef struct Kinetic Kinetic;
+
+Kinetic* Kinetic_new();
+
+void Kinetic_delete(Kinetic* kinetic);
+
+// Returns true if frame is known to be quiet, given the lines as they are at
+// its start.  Recomputes the events that fall due on frame, or every event if
+// they are out of date.  Returns false if memory ran out.
+bool Kinetic_isQuiet(Kinetic* kinetic, const double* p1x, const double* p1y,
+                     const double* p2x, const double* p2y, const double* vx,
+                     const double* vy, const double timeStep,
+                     const unsigned int numOfLines, const unsigned int frame);
+
+// Marks every event out of date; to be called whenever a velocity changes.
+void Kinetic_invalidate(Kinetic* kinetic);
+
+#endif  // KINETIC_H_
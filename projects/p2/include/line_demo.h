@@ -26,8 +26,12 @@
 
 #include "collision_world.h"
 #include "line.h"
+#include "raster.h"
 
 struct LineDemo {
+  // File the lines are read from
+  const char* inputFilePath;
+
   // Iteration counter
   unsigned int count;
 
@@ -36,23 +40,73 @@ struct LineDemo {
 
   // Objects for line simulation
   CollisionWorld* collisionWorld;
+
+  // Broad phase the collision world is created with
+  BroadPhase broadPhase;
+
+  // Whether the collision world runs the reference collision code
+  bool reference;
+
+  // Whether the collision world caches broad phase pairs across frames
+  bool usePairCache;
+
+  // Whether the collision world skips the collision work of quiet frames
+  bool useKinetic;
+
+  // Where the collision world records its statistics, or NULL
+  CollisionStats* stats;
 };
 typedef struct LineDemo LineDemo;
 
 LineDemo* LineDemo_new();
 void LineDemo_delete(LineDemo* lineDemo);
 
-// Add lines for line simulation at beginning.
-void LineDemo_createLines(LineDemo* lineDemo);
+// Set the file, text or binary scene, the lines are read from.
+void LineDemo_setInputFile(LineDemo* lineDemo, const char* inputFilePath);
+
+// Add lines for line simulation at beginning.  Returns false, after printing a
+// message, if the input file cannot be loaded.
+bool LineDemo_createLines(LineDemo* lineDemo);
+
+// Write the lines, as loaded, to path as a binary scene file (see scene.h).
+// Returns false on failure.
+bool LineDemo_writeScene(LineDemo* lineDemo, const char* path);
+
+// Write a checkpoint of the simulation to path (see CollisionWorld_save);
+// giving it as the input file of a new LineDemo resumes the simulation.
+// Returns false on failure.
+bool LineDemo_saveCheckpoint(LineDemo* lineDemo, const char* path);
+
+// Draw the lines as they are now with raster and write the image to path as
+// a PPM file (see raster.h).  Returns false on failure.
+bool LineDemo_render(LineDemo* lineDemo, Raster* raster, const char* path);
+
+// Set the broad phase used to detect line-line intersections.
+void LineDemo_setBroadPhase(LineDemo* lineDemo, const BroadPhase broadPhase);
+
+// Enable or disable the broad phase pair cache (see
+// CollisionWorld_setPairCache).
+void LineDemo_setPairCache(LineDemo* lineDemo, const bool usePairCache);
+
+// Enable or disable skipping the collision work of quiet frames (see
+// CollisionWorld_setKinetic).
+void LineDemo_setKinetic(LineDemo* lineDemo, const bool useKinetic);
+
+// Record per-phase statistics in stats (see CollisionWorld_setStats).
+void LineDemo_setStats(LineDemo* lineDemo, CollisionStats* stats);
+
+// Select the reference collision code (see CollisionWorld_setReference).
+void LineDemo_setReference(LineDemo* lineDemo, const bool reference);
 
 // Set number of frames to compute.
 void LineDemo_setNumFrames(LineDemo* lineDemo, const unsigned int numFrames);
 
-// Initialize line simulation.
-void LineDemo_initLine(LineDemo* lineDemo);
+// Initialize line simulation.  Returns false if the input file cannot be
+// loaded.
+bool LineDemo_initLine(LineDemo* lineDemo);
 
 // Get ith line.
-Line* LineDemo_getLine(LineDemo* lineDemo, const unsigned int index);
+Line LineDemo_getLine(LineDemo* lineDemo, const unsigned int index);
 
 // Get num of lines.
 unsigned int LineDemo_getNumOfLines(LineDemo* lineDemo);
@@ -63,9 +117,13 @@ unsigned int LineDemo_getNumLineWallCollisions(LineDemo* lineDemo);
 // Get number of line-line collisions.
 unsigned int LineDemo_getNumLineLineCollisions(LineDemo* lineDemo);
 
+// Get number of line pairs tested by the narrow phase.
+unsigned long long LineDemo_getNumPairsTested(LineDemo* lineDemo);
+
+// Get number of frames whose collision work was skipped.
+unsigned long long LineDemo_getNumQuietFrames(LineDemo* lineDemo);
+
 // Line simulation update function.
 bool LineDemo_update(LineDemo* lineDemo);
 
-void LineDemo_setInputFile(char* input_file_path);
-
 #endif  // LINEDEMO_H_
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Cache of the line pairs found by the grid broad phase, kept from frame to
+// frame.  Every line gets an inflated copy of its swept box with room for
+// several frames of motion, and the cache holds every pair whose inflated
+// boxes overlap.  While each line's swept box stays inside its inflated box,
+// no pair outside the cache can intersect, so a frame only has to check the
+// cached pairs.  Lines whose swept boxes escape (because they moved far
+// enough, or a collision changed their velocity) are re-inflated and their
+// pairs found again.
+#ifndef PAIRCACHE_H_
+#define PAIRCACHE_H_
+
+#include <stdbool.h>
+
+#include "candidate_list.h"
+#include "grid.h"
+#include "swept_box.h"
+
+// Frames of motion, at a line's current velocity, that its inflated box makes
+// room for on every side.  Larger margins mean fewer repairs, but more cached
+// pairs to check every frame.
+#ifndef PAIR_CACHE_MARGIN_FRAMES
+#define PAIR_CACHE_MARGIN_FRAMES 4
+#endif
+
+// The cache is rebuilt from scratch once more than 1 / PAIR_CACHE_MAX_MOVED
+// of the lines have been re-inflated since the last rebuild.
+#define PAIR_CACHE_MAX_MOVED 8
+
+struct PairCache {
+  // Inflated box of every line, and the inflated boxes as of the last rebuild,
+  // which the grid still holds.
+  SweptBox* fatBoxes;
+  SweptBox* builtBoxes;
+
+  // Whether each line's swept box escaped its inflated box this frame, and
+  // the lines that did.
+  unsigned char* escaped;
+  unsigned int* escapedLines;
+
+  // Whether each line has been re-inflated since the last rebuild, and the
+  // lines that have.  The main grid holds them by their old inflated boxes,
+  // so they are found with a grid of their own, over movedBoxes.
+  unsigned char* moved;
+  unsigned int* movedLines;
+  unsigned int numMoved;
+  SweptBox* movedBoxes;
+  Grid* movedGrid;
+  CandidateList movedPairs;
+
+  // Number of lines the per-line arrays hold.
+  unsigned int capacity;
+
+  // Number of lines the cache was built for; 0 if it must be rebuilt.
+  unsigned int numOfLines;
+
+  // Every pair of lines whose inflated boxes overlap.
+  CandidateList pairs;
+};
+typedef struct PairCache PairCache;
+
+PairCache* PairCache_new();
+
+void PairCache_delete(PairCache* pairCache);
+
+// Appends to candidates every pair of lines whose swept boxes overlap, each
+// pair exactly once, given the swept box and velocity of every line.  Runs the
+// grid broad phase only when the cache cannot be repaired; in between, the
+// grid must not be used for anything else.
+// Returns false (with candidates incomplete) if memory ran out.
+bool PairCache_findCandidates(PairCache* pairCache, Grid* grid,
+                              const SweptBox* boxes, const double* vx,
+                              const double* vy, const double timeStep,
+                              const unsigned int numOfLines,
+                              CandidateList* candidates);
+
+// Forces the next PairCache_findCandidates to rebuild the cache.
+void PairCache_invalidate(PairCache* pairCache);
+
+#endif  // PAIRCACHE_H_
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Quadtree broad phase: finds the pairs of lines whose swept boxes overlap by
+// storing every line in the deepest node whose region fully contains its
+// swept box.  Adapts to clustered scenes, where a uniform grid either needs
+// too many cells or ends up with long per-cell pair loops.
+#ifndef QUADTREE_H_
+#define QUADTREE_H_
+
+#include <stdbool.h>
+
+#include "candidate_list.h"
+#include "line.h"
+#include "swept_box.h"
+
+// Defaults for the shape of the tree; override with -D to experiment.
+#ifndef QUADTREE_DEFAULT_MAX_DEPTH
+#define QUADTREE_DEFAULT_MAX_DEPTH 10
+#endif
+#ifndef QUADTREE_DEFAULT_LEAF_CAPACITY
+#define QUADTREE_DEFAULT_LEAF_CAPACITY 8
+#endif
+
+// A node of the tree.  Nodes refer to each other by index into the tree's node
+// arena, which is refilled from scratch every frame.
+struct QuadTreeNode {
+  // Index of the first of the node's 4 (consecutive) children; 0 if the node
+  // is a leaf, since the root is never anybody's child.
+  unsigned int children;
+  unsigned int depth;
+
+  // Lines stored in this node, as a list linked through the tree's next
+  // array.
+  unsigned int head;
+  unsigned int count;
+
+  // Point at which the node splits into quadrants, and half the size of the
+  // node's nominal square.
+  double centerX;
+  double centerY;
+  double halfWidth;
+  double halfHeight;
+
+  // Region whose boxes may be stored in this node or below.  Unbounded on the
+  // sides that face outward from the root, so that lines outside the box
+  // still have a home.
+  SweptBox region;
+};
+typedef struct QuadTreeNode QuadTreeNode;
+
+struct QuadTree {
+  // A leaf splits once it holds more than leafCapacity lines, unless it is
+  // already maxDepth levels below the root.
+  unsigned int maxDepth;
+  unsigned int leafCapacity;
+
+  // Node arena; reset (but not freed) at the start of every frame.
+  QuadTreeNode* nodes;
+  unsigned int numNodes;
+  unsigned int nodesCapacity;
+
+  // Swept box of every line (borrowed from the caller for the duration of
+  // QuadTree_findCandidates), and the links of the per-node line lists,
+  // indexed like the lines.
+  const SweptBox* boxes;
+  unsigned int* next;
+  unsigned int linesCapacity;
+};
+typedef struct QuadTree QuadTree;
+
+QuadTree* QuadTree_new(const unsigned int maxDepth,
+                       const unsigned int leafCapacity);
+
+void QuadTree_delete(QuadTree* quadTree);
+
+// Rebuilds the tree from the swept box of every line and appends to
+// candidates every pair of lines whose boxes overlap, each pair exactly once.
+// Returns false (with candidates incomplete) if memory ran out.
+bool QuadTree_findCandidates(QuadTree* quadTree, const SweptBox* boxes,
+                             const unsigned int numOfLines,
+                             CandidateList* candidates);
+
+#endif  // QUADTREE_H_
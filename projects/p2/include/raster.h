@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Offscreen rendering of the lines into an in-memory framebuffer, written out
+// as binary PPM images, for looking at simulations without an X server.  The
+// framebuffer is split into square tiles; the lines are bucketed into the
+// tiles their pixel bounding boxes overlap, and then the tiles are drawn in
+// parallel, each by a single thread, so no two threads write the same pixel.
+// The pixels a line covers do not depend on the tiling: every tile draws the
+// pixels of the whole line that fall inside it.
+#ifndef RASTER_H_
+#define RASTER_H_
+
+#include <stdbool.h>
+
+#include "line.h"
+
+// Width and height of a tile, in pixels.
+#ifndef RASTER_TILE_SIZE
+#define RASTER_TILE_SIZE 64
+#endif
+
+// A line in pixel coordinates; x grows to the right and y downward.
+struct RasterSegment {
+  int x1;
+  int y1;
+  int x2;
+  int y2;
+  Color color;
+};
+typedef struct RasterSegment RasterSegment;
+
+struct Raster {
+  // The framebuffer: width * height RGB pixels, row by row from the top.
+  unsigned char* pixels;
+  unsigned int width;
+  unsigned int height;
+
+  // Segments of the lines being drawn, indexed like the lines.
+  RasterSegment* segments;
+  unsigned int capacity;
+
+  // The segments overlapping tile t, row by row from the top left, are
+  // tileSegments[tileStarts[t]..tileStarts[t + 1]).
+  unsigned int tilesX;
+  unsigned int tilesY;
+  unsigned int* tileStarts;
+  unsigned int* tileSegments;
+  unsigned int tileSegmentsCapacity;
+};
+typedef struct Raster Raster;
+
+// Returns a raster of width x height pixels, or NULL if memory could not be
+// allocated.
+Raster* Raster_new(const unsigned int width, const unsigned int height);
+
+void Raster_delete(Raster* raster);
+
+// Clears the framebuffer to black and draws the lines over it, scaling the
+// box to the framebuffer as boxToWindow scales it to the window: red lines
+// first and gray lines over them, as on screen.  Returns false if memory ran
+// out.
+bool Raster_draw(Raster* raster, const double* p1x, const double* p1y,
+                 const double* p2x, const double* p2y, const Color* color,
+                 const unsigned int numOfLines);
+
+// Writes the framebuffer to path as a binary (P6) PPM image.  Prints a
+// message to stderr and returns false on failure.
+bool Raster_writePpm(const Raster* raster, const char* path);
+
+#endif  // RASTER_H_
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Binary files holding a collision world's lines: scenes, which load much
+// faster than the text (.in) format, and checkpoints of a simulation in
+// progress.
+//
+// A scene file is a 16-byte header followed by the lines' attributes, one
+// column per attribute in the order of the collision world's arrays:
+//
+//   offset  size  field
+//   0       4     magic number, the bytes "LSCN"
+//   4       4     format version (SCENE_VERSION)
+//   8       4     number of lines n (at least 1)
+//   12      4     reserved, zero
+//   16      8n    p1.x of every line, as doubles in box coordinates
+//           8n    p1.y
+//           8n    p2.x
+//           8n    p2.y
+//           8n    velocity.x, in box units per time step
+//           8n    velocity.y
+//           n     color of every line, one byte each
+//
+// All integers and doubles are little-endian.  Line i gets ID i, as in the
+// text format.  Coordinates are stored already converted to box coordinates,
+// so a scene converted from a text file simulates bit-identically to it, and
+// loading one is a handful of copies from the mapped file into the collision
+// world's arrays.
+//
+// A checkpoint holds everything a simulation needs to carry on exactly where
+// it left off:
+//
+//   offset  size  field
+//   0       4     magic number, the bytes "LCKP"
+//   4       4     format version (CHECKPOINT_VERSION)
+//   8       4     number of lines n (at least 1)
+//   12      4     frames simulated so far
+//   16      8     time step, as a double
+//   24      4     line-wall collisions so far
+//   28      4     line-line collisions so far
+//   32      8     line pairs tested so far
+//   40      48n   the six double columns, as in a scene file
+//           4n    ID of every line
+//           n     color of every line, one byte each
+//
+// The broad phases' state is not saved: it only affects which pairs are
+// tested, not the result, and is rebuilt on the first frame after loading.
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include <stdbool.h>
+
+#include "collision_world.h"
+
+// Bytes 0-3 of every binary scene file.
+#define SCENE_MAGIC "LSCN"
+
+// Version written by Scene_writeBinary and accepted by Scene_readBinary.
+#define SCENE_VERSION 1
+
+// Bytes 0-3 of every checkpoint.
+#define CHECKPOINT_MAGIC "LCKP"
+
+// Version written by CollisionWorld_save and accepted by CollisionWorld_load.
+#define CHECKPOINT_VERSION 1
+
+// Return whether the file at path starts with the binary scene magic number.
+bool Scene_isBinary(const char* path);
+
+// Create a collision world holding the lines of a binary scene file.  Prints
+// a message to stderr and returns NULL if the file cannot be read or is not a
+// valid scene.
+CollisionWorld* Scene_readBinary(const char* path);
+
+// Write the lines of a collision world to path as a binary scene file.
+// Prints a message to stderr and returns false on failure.
+bool Scene_writeBinary(const char* path, CollisionWorld* collisionWorld);
+
+// Return whether the file at path starts with the checkpoint magic number.
+bool Scene_isCheckpoint(const char* path);
+
+// Write a checkpoint of a collision world to path.  Prints a message to
+// stderr and returns false on failure.
+bool CollisionWorld_save(CollisionWorld* collisionWorld, const char* path);
+
+// Create a collision world from a checkpoint, in the state it was saved in.
+// Prints a message to stderr and returns NULL if the file cannot be read or
+// is not a valid checkpoint.
+CollisionWorld* CollisionWorld_load(const char* path);
+
+#endif  // SCENE_H_
@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Sort-and-sweep (sweep and prune) broad phase: finds the pairs of lines whose
+// swept boxes overlap by sweeping across the x-endpoints of the boxes in
+// sorted order.  The sorted endpoints are kept from frame to frame; lines
+// move little per frame, so the order barely changes and is repaired with an
+// insertion sort in close to linear time.
+#ifndef SWEEPANDPRUNE_H_
+#define SWEEPANDPRUNE_H_
+
+#include <stdbool.h>
+
+#include "candidate_list.h"
+#include "line.h"
+#include "swept_box.h"
+
+// One end of a box's x-interval.
+struct SweepEndpoint {
+  double value;
+  // Index of the line, times 2, plus 1 for the right end (xmax).  At equal
+  // values, left ends sort first so that touching intervals overlap.
+  unsigned int key;
+};
+typedef struct SweepEndpoint SweepEndpoint;
+
+struct SweepAndPrune {
+  // Both endpoints of every line, sorted by (value, key & 1) as of the last
+  // frame.
+  SweepEndpoint* endpoints;
+  unsigned int numOfLines;
+
+  // Lines whose intervals contain the sweep position, and each line's index
+  // within active.
+  unsigned int* active;
+  unsigned int* activeIndex;
+};
+typedef struct SweepAndPrune SweepAndPrune;
+
+SweepAndPrune* SweepAndPrune_new();
+
+void SweepAndPrune_delete(SweepAndPrune* sweepAndPrune);
+
+// Appends to candidates every pair of lines whose swept boxes overlap, each
+// pair exactly once, given the swept box of every line.  The endpoints are
+// re-sorted starting from last frame's order, which is rebuilt from scratch
+// only if the number of lines changed.
+// Returns false (with candidates incomplete) if memory ran out.
+bool SweepAndPrune_findCandidates(SweepAndPrune* sweepAndPrune,
+                                  const SweptBox* boxes,
+                                  const unsigned int numOfLines,
+                                  CandidateList* candidates);
+
+#endif  // SWEEPANDPRUNE_H_
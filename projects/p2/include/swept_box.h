@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+// Axis-aligned bounding boxes around the area a line sweeps during a frame,
+// used by the broad phases to rule out line pairs that cannot intersect.
+#ifndef SWEPTBOX_H_
+#define SWEPTBOX_H_
+
+#include <stdbool.h>
+
+// Slack added on every side of a box.  intersect() computes positions in the
+// frame of reference of one of the lines, so its rounding differs slightly
+// from ours; the slack keeps the boxes conservative.
+#define SWEPTBOX_MARGIN 1e-10
+
+// Bounds of a line's current segment together with where it will be after
+// one time step.
+struct SweptBox {
+  double xmin;
+  double xmax;
+  double ymin;
+  double ymax;
+};
+typedef struct SweptBox SweptBox;
+
+// Returns the box swept over the next timeStep by the line from (p1x, p1y)
+// to (p2x, p2y) moving at velocity (vx, vy).  Any pair of lines that
+// intersect() reports as intersecting has overlapping boxes.
+static inline SweptBox SweptBox_make(const double p1x, const double p1y,
+                                     const double p2x, const double p2y,
+                                     const double vx, const double vy,
+                                     const double timeStep) {
+  const double dx = vx * timeStep;
+  const double dy = vy * timeStep;
+  const double x1 = p1x < p2x ? p1x : p2x;
+  const double x2 = p1x < p2x ? p2x : p1x;
+  const double y1 = p1y < p2y ? p1y : p2y;
+  const double y2 = p1y < p2y ? p2y : p1y;
+
+  SweptBox box;
+  box.xmin = (dx < 0 ? x1 + dx : x1) - SWEPTBOX_MARGIN;
+  box.xmax = (dx > 0 ? x2 + dx : x2) + SWEPTBOX_MARGIN;
+  box.ymin = (dy < 0 ? y1 + dy : y1) - SWEPTBOX_MARGIN;
+  box.ymax = (dy > 0 ? y2 + dy : y2) + SWEPTBOX_MARGIN;
+  return box;
+}
+
+// Returns true if the (closed) boxes share at least one point.
+static inline bool SweptBox_overlap(const SweptBox *a, const SweptBox *b) {
+  return a->xmin <= b->xmax && b->xmin <= a->xmax
+      && a->ymin <= b->ymax && b->ymin <= a->ymax;
+}
+
+#endif  // SWEPTBOX_H_
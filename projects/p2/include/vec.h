@@ -61,6 +61,12 @@ Vec Vec_orthogonal(Vec vector);
 // Computes the angle between vector1 and vector2.
 double Vec_angle(Vec vector1, Vec vector2);
 
+// Returns the sign (-1, 0 or 1) of Vec_angle(vector1, vector2), using only
+// sign tests and a cross product rather than atan2 except for vectors that are
+// parallel to within rounding error.
+// Precondition: neither vector is zero.
+int Vec_compareArguments(Vec vector1, Vec vector2);
+
 // Computes the scalar component of vector1 onto vector2.
 vec_dimension Vec_component(Vec vector1, Vec vector2);
 
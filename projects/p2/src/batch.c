@@ -0,0 +1,199 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "fasttime.h"
+#include "line_demo.h"
+
+// Longest manifest line accepted, in bytes.
+#define MANIFEST_LINE_LENGTH 4096
+
+Batch* Batch_readManifest(const char* path) {
+  FILE* fin = fopen(path, "r");
+  if (fin == NULL) {
+    fprintf(stderr, "Manifest not found (%s)\n", path);
+    return NULL;
+  }
+  Batch* batch = calloc(1, sizeof(Batch));
+  if (batch == NULL) {
+    fclose(fin);
+    return NULL;
+  }
+
+  char line[MANIFEST_LINE_LENGTH];
+  unsigned int lineNumber = 0;
+  unsigned int capacity = 0;
+  while (fgets(line, sizeof(line), fin) != NULL) {
+    lineNumber++;
+    char inputFilePath[MANIFEST_LINE_LENGTH];
+    unsigned int numFrames;
+    char extra;
+    const char* start = line + strspn(line, " \t\r\n");
+    if (*start == '\0' || *start == '#') {
+      continue;
+    }
+    if (sscanf(start, "%s %u %c", inputFilePath, &numFrames, &extra) != 2) {
+      fprintf(stderr, "%s:%u: expected <inputfile> <numFrames>\n", path,
+              lineNumber);
+      fclose(fin);
+      Batch_delete(batch);
+      return NULL;
+    }
+    if (batch->numJobs == capacity) {
+      capacity = 2 * capacity + 16;
+      BatchJob* jobs = realloc(batch->jobs, capacity * sizeof(BatchJob));
+      if (jobs == NULL) {
+        fclose(fin);
+        Batch_delete(batch);
+        return NULL;
+      }
+      batch->jobs = jobs;
+    }
+    BatchJob* job = &batch->jobs[batch->numJobs];
+    memset(job, 0, sizeof(BatchJob));
+    job->inputFilePath = strdup(inputFilePath);
+    job->numFrames = numFrames;
+    batch->numJobs++;
+    if (job->inputFilePath == NULL) {
+      fclose(fin);
+      Batch_delete(batch);
+      return NULL;
+    }
+  }
+  fclose(fin);
+  return batch;
+}
+
+void Batch_delete(Batch* batch) {
+  if (batch == NULL) {
+    return;
+  }
+  for (unsigned int j = 0; j < batch->numJobs; j++) {
+    free(batch->jobs[j].inputFilePath);
+  }
+  free(batch->jobs);
+  free(batch);
+}
+
+// Runs a job to completion on the calling thread.
+static void Batch_runJob(BatchJob* job, const BroadPhase broadPhase,
+                         const bool usePairCache, const bool useKinetic) {
+  LineDemo* lineDemo = LineDemo_new();
+  if (lineDemo == NULL) {
+    return;
+  }
+  LineDemo_setBroadPhase(lineDemo, broadPhase);
+  LineDemo_setPairCache(lineDemo, usePairCache);
+  LineDemo_setKinetic(lineDemo, useKinetic);
+  LineDemo_setInputFile(lineDemo, job->inputFilePath);
+  if (!LineDemo_initLine(lineDemo)) {
+    // Unreadable input fails this job alone.
+    LineDemo_delete(lineDemo);
+    return;
+  }
+  LineDemo_setNumFrames(lineDemo, job->numFrames);
+
+  // A checkpoint resumes at the frame it was saved on.
+  const unsigned int startFrame = lineDemo->count;
+  const fasttime_t start = gettime();
+  while (LineDemo_update(lineDemo)) {
+  }
+  job->seconds = tdiff(start, gettime());
+
+  job->ok = true;
+  job->numOfLines = LineDemo_getNumOfLines(lineDemo);
+  job->framesSimulated = lineDemo->count - startFrame;
+  job->numLineWallCollisions = LineDemo_getNumLineWallCollisions(lineDemo);
+  job->numLineLineCollisions = LineDemo_getNumLineLineCollisions(lineDemo);
+  LineDemo_delete(lineDemo);
+}
+
+void Batch_run(Batch* batch, const BroadPhase broadPhase,
+               const bool usePairCache, const bool useKinetic,
+               const int numWorkers) {
+  const fasttime_t start = gettime();
+
+  // Jobs differ wildly in length, so each worker takes the next job as soon
+  // as it is done with one.  Every job runs on its worker alone: parallelism
+  // comes from the jobs, and the worlds' own parallel regions run on one
+  // thread.  (glibc malloc gives each worker an arena of its own, so the
+  // workers' worlds do not contend for the allocator either.)
+#ifdef _OPENMP
+  const int numThreads = numWorkers > 0 ? numWorkers : omp_get_max_threads();
+  #pragma omp parallel num_threads(numThreads)
+  {
+    omp_set_num_threads(1);
+    #pragma omp for schedule(dynamic, 1)
+    for (unsigned int j = 0; j < batch->numJobs; j++) {
+      Batch_runJob(&batch->jobs[j], broadPhase, usePairCache, useKinetic);
+    }
+  }
+#else
+  for (unsigned int j = 0; j < batch->numJobs; j++) {
+    Batch_runJob(&batch->jobs[j], broadPhase, usePairCache, useKinetic);
+  }
+#endif
+
+  batch->seconds = tdiff(start, gettime());
+}
+
+void Batch_print(const Batch* batch) {
+  unsigned long long worldFrames = 0;
+  printf("---- BATCH RESULTS ----\n");
+  printf("%5s %8s %8s %11s %10s %10s  %s\n", "job", "frames", "lines",
+         "seconds", "line-wall", "line-line", "input");
+  for (unsigned int j = 0; j < batch->numJobs; j++) {
+    const BatchJob* job = &batch->jobs[j];
+    if (!job->ok) {
+      printf("%5u %8s %8s %11s %10s %10s  %s\n", j + 1, "-", "-", "FAILED",
+             "-", "-", job->inputFilePath);
+      continue;
+    }
+    printf("%5u %8u %8u %11.6f %10u %10u  %s\n", j + 1, job->framesSimulated,
+           job->numOfLines, job->seconds, job->numLineWallCollisions,
+           job->numLineLineCollisions, job->inputFilePath);
+    worldFrames += job->framesSimulated;
+  }
+  printf("%u jobs (%u failed), %llu world-frames in %fs: %.1f world-frames/s\n",
+         batch->numJobs, Batch_numFailed(batch), worldFrames, batch->seconds,
+         batch->seconds > 0 ? worldFrames / batch->seconds : 0);
+  printf("---- END BATCH RESULTS ----\n");
+}
+
+unsigned int Batch_numFailed(const Batch* batch) {
+  unsigned int numFailed = 0;
+  for (unsigned int j = 0; j < batch->numJobs; j++) {
+    if (!batch->jobs[j].ok) {
+      numFailed++;
+    }
+  }
+  return numFailed;
+}
@@ -0,0 +1,302 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "broad_phase_tuner.h"
+#include "line.h"
+#include "quadtree.h"
+
+// The broad phases the tuner chooses between, in the order they are tried.
+static const BroadPhase TUNER_CANDIDATES[] = {
+  BROAD_PHASE_GRID, BROAD_PHASE_QUADTREE, BROAD_PHASE_SWEEP_AND_PRUNE,
+  BROAD_PHASE_BVH
+};
+#define NUM_TUNER_CANDIDATES \
+  (sizeof(TUNER_CANDIDATES) / sizeof(TUNER_CANDIDATES[0]))
+
+// Range of the grid's resolution scale, which is stepped by a factor of
+// sqrt(2), and of the quadtree's leaf capacity, which is stepped by a factor
+// of 2.
+#define TUNER_MIN_GRID_SCALE 0.125
+#define TUNER_MAX_GRID_SCALE 8.0
+#define TUNER_MIN_LEAF_CAPACITY 2
+#define TUNER_MAX_LEAF_CAPACITY 256
+
+BroadPhaseTuner* BroadPhaseTuner_new() {
+  BroadPhaseTuner* tuner = calloc(1, sizeof(BroadPhaseTuner));
+  if (tuner == NULL) {
+    return NULL;
+  }
+
+  tuner->broadPhase = TUNER_CANDIDATES[0];
+  tuner->settledBroadPhase = TUNER_CANDIDATES[0];
+  tuner->gridScale = 1;
+  tuner->leafCapacity = QUADTREE_DEFAULT_LEAF_CAPACITY;
+  tuner->state = TUNER_EXPLORING;
+  for (unsigned int c = 0; c < NUM_TUNER_CANDIDATES; c++) {
+    tuner->toExplore[TUNER_CANDIDATES[c]] = true;
+  }
+  tuner->stepUp = true;
+  // Sample on the first frame.
+  tuner->framesSinceSample = TUNER_SAMPLE_FRAMES - 1;
+  return tuner;
+}
+
+void BroadPhaseTuner_delete(BroadPhaseTuner* tuner) {
+  free(tuner);
+}
+
+// Samples the line distribution into tuner->sample.
+static void BroadPhaseTuner_sample(BroadPhaseTuner* tuner, const double* p1x,
+                                   const double* p1y, const double* p2x,
+                                   const double* p2y, const SweptBox* boxes,
+                                   const unsigned int numOfLines) {
+  const double cellsPerX = TUNER_OCCUPANCY_RESOLUTION
+                           / ((double) BOX_XMAX - BOX_XMIN);
+  const double cellsPerY = TUNER_OCCUPANCY_RESOLUTION
+                           / ((double) BOX_YMAX - BOX_YMIN);
+  memset(tuner->occupied, 0, sizeof(tuner->occupied));
+  double length = 0;
+  double extent = 0;
+  unsigned int numOccupied = 0;
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    const double dx = p2x[i] - p1x[i];
+    const double dy = p2y[i] - p1y[i];
+    length += sqrt(dx * dx + dy * dy);
+    const SweptBox* box = &boxes[i];
+    extent += (box->xmax - box->xmin + box->ymax - box->ymin) / 2;
+
+    double x = ((box->xmin + box->xmax) / 2 - BOX_XMIN) * cellsPerX;
+    double y = ((box->ymin + box->ymax) / 2 - BOX_YMIN) * cellsPerY;
+    x = x < 0 ? 0 : x < TUNER_OCCUPANCY_RESOLUTION - 1
+        ? x : TUNER_OCCUPANCY_RESOLUTION - 1;
+    y = y < 0 ? 0 : y < TUNER_OCCUPANCY_RESOLUTION - 1
+        ? y : TUNER_OCCUPANCY_RESOLUTION - 1;
+    unsigned char* cell = &tuner->occupied[(unsigned int) y
+                                           * TUNER_OCCUPANCY_RESOLUTION
+                                           + (unsigned int) x];
+    numOccupied += !*cell;
+    *cell = 1;
+  }
+  tuner->sample.meanLength = numOfLines > 0 ? length / numOfLines : 0;
+  tuner->sample.meanExtent = numOfLines > 0 ? extent / numOfLines : 0;
+  tuner->sample.occupancy = (double) numOccupied
+      / (TUNER_OCCUPANCY_RESOLUTION * TUNER_OCCUPANCY_RESOLUTION);
+}
+
+// Returns true if a and b differ by more than TUNER_SHIFT_RATIO either way.
+static bool BroadPhaseTuner_differ(const double a, const double b) {
+  if (a <= 0 || b <= 0) {
+    return a != b;
+  }
+  return a > b * TUNER_SHIFT_RATIO || b > a * TUNER_SHIFT_RATIO;
+}
+
+// Returns true if the line distribution has shifted since the last
+// exploration.
+static bool BroadPhaseTuner_shifted(const BroadPhaseTuner* tuner) {
+  const TunerSample* now = &tuner->sample;
+  const TunerSample* then = &tuner->exploredSample;
+  return BroadPhaseTuner_differ(now->meanLength, then->meanLength)
+      || BroadPhaseTuner_differ(now->meanExtent, then->meanExtent)
+      || BroadPhaseTuner_differ(now->occupancy, then->occupancy);
+}
+
+static void BroadPhaseTuner_startTrial(BroadPhaseTuner* tuner) {
+  tuner->trialFrames = 0;
+  tuner->trialSeconds = 0;
+  tuner->trialPairs = 0;
+}
+
+// Returns the candidate with the least time per frame, of those measured.
+static BroadPhase BroadPhaseTuner_fastest(const BroadPhaseTuner* tuner) {
+  BroadPhase fastest = tuner->broadPhase;
+  for (unsigned int c = 0; c < NUM_TUNER_CANDIDATES; c++) {
+    const BroadPhase broadPhase = TUNER_CANDIDATES[c];
+    if (tuner->seconds[broadPhase] > 0
+        && (tuner->seconds[fastest] <= 0
+            || tuner->seconds[broadPhase] < tuner->seconds[fastest])) {
+      fastest = broadPhase;
+    }
+  }
+  return fastest;
+}
+
+// Starts exploring every candidate, or, unless all is true, the ones that
+// were not far slower than the current broad phase.  The current broad phase
+// goes first, since its state is already built.
+static void BroadPhaseTuner_explore(BroadPhaseTuner* tuner, const bool all) {
+  const double best = tuner->seconds[tuner->broadPhase];
+  for (unsigned int c = 0; c < NUM_TUNER_CANDIDATES; c++) {
+    const BroadPhase broadPhase = TUNER_CANDIDATES[c];
+    tuner->toExplore[broadPhase] = all || tuner->seconds[broadPhase] <= 0
+        || tuner->seconds[broadPhase] <= TUNER_RETRY_RATIO * best;
+  }
+  tuner->toExplore[tuner->broadPhase] = true;
+  tuner->state = TUNER_EXPLORING;
+  BroadPhaseTuner_startTrial(tuner);
+}
+
+// Steps the current broad phase's parameter up or down.  Returns false if it
+// has none, or it is already at the end of its range.
+static bool BroadPhaseTuner_step(BroadPhaseTuner* tuner, const bool up) {
+  switch (tuner->broadPhase) {
+    case BROAD_PHASE_GRID: {
+      const double scale = up ? tuner->gridScale * M_SQRT2
+                              : tuner->gridScale / M_SQRT2;
+      if (scale < TUNER_MIN_GRID_SCALE * 0.99
+          || scale > TUNER_MAX_GRID_SCALE * 1.01) {
+        return false;
+      }
+      tuner->gridScale = scale;
+      return true;
+    }
+    case BROAD_PHASE_QUADTREE: {
+      const unsigned int capacity = up ? 2 * tuner->leafCapacity
+                                       : tuner->leafCapacity / 2;
+      if (capacity < TUNER_MIN_LEAF_CAPACITY
+          || capacity > TUNER_MAX_LEAF_CAPACITY) {
+        return false;
+      }
+      tuner->leafCapacity = capacity;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool BroadPhaseTuner_endFrame(BroadPhaseTuner* tuner, const double seconds,
+                              const unsigned long long numPairs,
+                              const double* p1x, const double* p1y,
+                              const double* p2x, const double* p2y,
+                              const SweptBox* boxes,
+                              const unsigned int numOfLines) {
+  tuner->framesSinceExploration++;
+  const bool sampled = ++tuner->framesSinceSample >= TUNER_SAMPLE_FRAMES;
+  if (sampled) {
+    BroadPhaseTuner_sample(tuner, p1x, p1y, p2x, p2y, boxes, numOfLines);
+    tuner->framesSinceSample = 0;
+  }
+
+  // The first frame of a trial builds the broad phase's state, and is not
+  // counted.
+  if (tuner->trialFrames++ > 0) {
+    tuner->trialSeconds += seconds;
+    tuner->trialPairs += numPairs;
+  }
+  const unsigned int measured = tuner->trialFrames - 1;
+  const BroadPhase current = tuner->broadPhase;
+
+  switch (tuner->state) {
+    case TUNER_EXPLORING: {
+      const BroadPhase fastest = BroadPhaseTuner_fastest(tuner);
+      const bool slow = measured > 0 && fastest != current
+          && tuner->seconds[fastest] > 0
+          && seconds > TUNER_RETRY_RATIO * tuner->seconds[fastest];
+      if (measured < TUNER_TRIAL_FRAMES && !slow) {
+        return false;
+      }
+      if (measured > 0) {
+        tuner->seconds[current] = tuner->trialSeconds / measured;
+        tuner->pairs[current] = tuner->trialPairs / measured;
+      }
+      tuner->toExplore[current] = false;
+      BroadPhaseTuner_startTrial(tuner);
+      for (unsigned int c = 0; c < NUM_TUNER_CANDIDATES; c++) {
+        if (tuner->toExplore[TUNER_CANDIDATES[c]]) {
+          tuner->broadPhase = TUNER_CANDIDATES[c];
+          return false;
+        }
+      }
+
+      // Every candidate has been tried: run the fastest.
+      tuner->broadPhase = BroadPhaseTuner_fastest(tuner);
+      tuner->state = TUNER_RUNNING;
+      tuner->framesSinceExploration = 0;
+      tuner->exploredSample = tuner->sample;
+      if (tuner->broadPhase != tuner->settledBroadPhase
+          || tuner->numChanges == 0) {
+        tuner->settledBroadPhase = tuner->broadPhase;
+        tuner->numChanges++;
+        return true;
+      }
+      return false;
+    }
+
+    case TUNER_RUNNING:
+      if (!sampled) {
+        return false;
+      }
+      if (measured > 0) {
+        tuner->seconds[current] = tuner->trialSeconds / measured;
+        tuner->pairs[current] = tuner->trialPairs / measured;
+      }
+      if (BroadPhaseTuner_shifted(tuner)) {
+        BroadPhaseTuner_explore(tuner, true);
+        return false;
+      }
+      if (tuner->framesSinceExploration >= TUNER_EPOCH_FRAMES) {
+        BroadPhaseTuner_explore(tuner, false);
+        return false;
+      }
+
+      // Try a step of the parameter, the other way if this way is at the end
+      // of its range.
+      tuner->savedGridScale = tuner->gridScale;
+      tuner->savedLeafCapacity = tuner->leafCapacity;
+      tuner->baselineSeconds = tuner->seconds[current];
+      bool stepped = measured > 0
+          && BroadPhaseTuner_step(tuner, tuner->stepUp);
+      if (measured > 0 && !stepped) {
+        tuner->stepUp = !tuner->stepUp;
+        stepped = BroadPhaseTuner_step(tuner, tuner->stepUp);
+      }
+      if (stepped) {
+        tuner->state = TUNER_STEPPING;
+      }
+      BroadPhaseTuner_startTrial(tuner);
+      return false;
+
+    case TUNER_STEPPING: {
+      if (measured < TUNER_TRIAL_FRAMES) {
+        return false;
+      }
+      const double stepSeconds = tuner->trialSeconds / measured;
+      tuner->state = TUNER_RUNNING;
+      BroadPhaseTuner_startTrial(tuner);
+      if (stepSeconds < (1 - TUNER_MIN_GAIN) * tuner->baselineSeconds) {
+        tuner->seconds[current] = stepSeconds;
+        tuner->numChanges++;
+        return true;
+      }
+      tuner->gridScale = tuner->savedGridScale;
+      tuner->leafCapacity = tuner->savedLeafCapacity;
+      tuner->stepUp = !tuner->stepUp;
+      return false;
+    }
+  }
+  return false;
+}
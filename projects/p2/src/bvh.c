@@ -0,0 +1,433 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <assert.h>
+#include <float.h>
+#include <stdlib.h>
+
+#include "bvh.h"
+
+// Identity for Bvh_union.
+static const SweptBox BVH_EMPTY_BOX = {DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX};
+
+// Returns the smallest box containing both a and b.
+static inline SweptBox Bvh_union(const SweptBox* a, const SweptBox* b) {
+  SweptBox box;
+  box.xmin = a->xmin < b->xmin ? a->xmin : b->xmin;
+  box.xmax = a->xmax > b->xmax ? a->xmax : b->xmax;
+  box.ymin = a->ymin < b->ymin ? a->ymin : b->ymin;
+  box.ymax = a->ymax > b->ymax ? a->ymax : b->ymax;
+  return box;
+}
+
+// Returns half the perimeter of a box, which in 2D stands in for the surface
+// area of the heuristic: the chance that a random box overlaps it.
+static inline double Bvh_halfPerimeter(const SweptBox* box) {
+  return (box->xmax - box->xmin) + (box->ymax - box->ymin);
+}
+
+// Returns the bin of a center coordinate c, for bins starting at low and
+// 1 / scale wide.
+static inline unsigned int Bvh_bin(const double c, const double low,
+                                   const double scale) {
+  const unsigned int bin = (unsigned int) ((c - low) * scale);
+  return bin < BVH_NUM_BINS ? bin : BVH_NUM_BINS - 1;
+}
+
+// Grows the work list to hold at least count entries.  Returns false if
+// memory ran out.
+static bool Bvh_reserveStack(Bvh* bvh, const unsigned int count) {
+  if (count <= bvh->stackCapacity) {
+    return true;
+  }
+  const unsigned int capacity =
+      count > 2 * bvh->stackCapacity ? count : 2 * bvh->stackCapacity;
+  unsigned int* stack = realloc(bvh->stack, capacity * sizeof(unsigned int));
+  if (stack == NULL) {
+    return false;
+  }
+  bvh->stack = stack;
+  bvh->stackCapacity = capacity;
+  return true;
+}
+
+Bvh* Bvh_new() {
+  Bvh* bvh = malloc(sizeof(Bvh));
+  if (bvh == NULL) {
+    return NULL;
+  }
+
+  bvh->nodes = NULL;
+  bvh->numNodes = 0;
+  bvh->lines = NULL;
+  bvh->numOfLines = 0;
+  bvh->cost = 0;
+  bvh->builtCost = 0;
+  bvh->stack = NULL;
+  bvh->stackCapacity = 0;
+  bvh->pairs = CandidateList_make();
+  bvh->pairStarts = NULL;
+  return bvh;
+}
+
+void Bvh_delete(Bvh* bvh) {
+  if (bvh == NULL) {
+    return;
+  }
+  free(bvh->nodes);
+  free(bvh->lines);
+  free(bvh->stack);
+  CandidateList_delete(&bvh->pairs);
+  free(bvh->pairStarts);
+  free(bvh);
+}
+
+// Sets every node's box to the union of its lines' boxes, children before
+// parents, and recomputes the tree's cost.
+static void Bvh_refit(Bvh* bvh, const SweptBox* boxes) {
+  BvhNode* nodes = bvh->nodes;
+  const unsigned int* lines = bvh->lines;
+  double cost = 0;
+  for (unsigned int n = bvh->numNodes; n-- > 0;) {
+    BvhNode* node = &nodes[n];
+    SweptBox box;
+    if (node->count > 0) {
+      box = boxes[lines[node->first]];
+      for (unsigned int k = 1; k < node->count; k++) {
+        box = Bvh_union(&box, &boxes[lines[node->first + k]]);
+      }
+      cost += node->count * Bvh_halfPerimeter(&box);
+    } else {
+      box = Bvh_union(&nodes[node->first].box, &nodes[node->first + 1].box);
+      cost += Bvh_halfPerimeter(&box);
+    }
+    node->box = box;
+  }
+  const double rootHalfPerimeter = Bvh_halfPerimeter(&nodes[0].box);
+  bvh->cost = rootHalfPerimeter > 0 ? cost / rootHalfPerimeter : 0;
+}
+
+// Splits lines[begin .. end) in two with the binned surface area heuristic:
+// the boxes are binned by their centers along the axis in which the centers
+// spread most, and of the planes between bins, the one minimizing the sum
+// over both sides of the number of lines times the half perimeter of their
+// union is chosen.  Partitions the lines at that plane and returns where the
+// second side starts, which is strictly between begin and end.
+static unsigned int Bvh_split(Bvh* bvh, const SweptBox* boxes,
+                              const unsigned int begin,
+                              const unsigned int end) {
+  unsigned int* lines = bvh->lines;
+
+  // Bounds of the centers, doubled to save halving them.
+  double cxmin = DBL_MAX;
+  double cxmax = -DBL_MAX;
+  double cymin = DBL_MAX;
+  double cymax = -DBL_MAX;
+  for (unsigned int k = begin; k < end; k++) {
+    const SweptBox* box = &boxes[lines[k]];
+    const double cx = box->xmin + box->xmax;
+    const double cy = box->ymin + box->ymax;
+    cxmin = cx < cxmin ? cx : cxmin;
+    cxmax = cx > cxmax ? cx : cxmax;
+    cymin = cy < cymin ? cy : cymin;
+    cymax = cy > cymax ? cy : cymax;
+  }
+  const bool alongX = cxmax - cxmin >= cymax - cymin;
+  const double low = alongX ? cxmin : cymin;
+  const double extent = alongX ? cxmax - cxmin : cymax - cymin;
+  if (!(extent > 0)) {
+    // Every center coincides; any split is as good as another.
+    return begin + (end - begin) / 2;
+  }
+  const double scale = BVH_NUM_BINS / extent;
+
+  unsigned int binCount[BVH_NUM_BINS];
+  SweptBox binBox[BVH_NUM_BINS];
+  for (int b = 0; b < BVH_NUM_BINS; b++) {
+    binCount[b] = 0;
+    binBox[b] = BVH_EMPTY_BOX;
+  }
+  for (unsigned int k = begin; k < end; k++) {
+    const SweptBox* box = &boxes[lines[k]];
+    const double c = alongX ? box->xmin + box->xmax : box->ymin + box->ymax;
+    const unsigned int b = Bvh_bin(c, low, scale);
+    binCount[b]++;
+    binBox[b] = Bvh_union(&binBox[b], box);
+  }
+
+  // The lowest center falls in the first bin and the highest in the last, so
+  // every plane has lines on both sides.  Sweep from the top for the cost of
+  // the side above each plane, then from the bottom to pick the plane.
+  double aboveCost[BVH_NUM_BINS];
+  SweptBox box = BVH_EMPTY_BOX;
+  unsigned int count = 0;
+  for (int b = BVH_NUM_BINS - 1; b > 0; b--) {
+    box = Bvh_union(&box, &binBox[b]);
+    count += binCount[b];
+    aboveCost[b] = count * Bvh_halfPerimeter(&box);
+  }
+  box = BVH_EMPTY_BOX;
+  count = 0;
+  unsigned int bestPlane = 1;
+  double bestCost = DBL_MAX;
+  for (int b = 1; b < BVH_NUM_BINS; b++) {
+    box = Bvh_union(&box, &binBox[b - 1]);
+    count += binCount[b - 1];
+    const double cost = count * Bvh_halfPerimeter(&box) + aboveCost[b];
+    if (cost < bestCost) {
+      bestCost = cost;
+      bestPlane = b;
+    }
+  }
+
+  unsigned int i = begin;
+  unsigned int j = end;
+  while (i < j) {
+    const SweptBox* lineBox = &boxes[lines[i]];
+    const double c = alongX ? lineBox->xmin + lineBox->xmax
+                            : lineBox->ymin + lineBox->ymax;
+    if (Bvh_bin(c, low, scale) < bestPlane) {
+      i++;
+    } else {
+      j--;
+      const unsigned int temp = lines[i];
+      lines[i] = lines[j];
+      lines[j] = temp;
+    }
+  }
+  assert(begin < i && i < end);
+  return i;
+}
+
+// Builds the tree over the boxes of numOfLines >= 2 lines from scratch.
+// Returns false if memory ran out.
+static bool Bvh_build(Bvh* bvh, const SweptBox* boxes,
+                      const unsigned int numOfLines) {
+  if (numOfLines != bvh->numOfLines) {
+    free(bvh->nodes);
+    free(bvh->lines);
+    free(bvh->pairStarts);
+    // A binary tree with numOfLines nonempty leaves has at most
+    // 2 * numOfLines - 1 nodes.
+    bvh->nodes = malloc((2 * numOfLines - 1) * sizeof(BvhNode));
+    bvh->lines = malloc(numOfLines * sizeof(unsigned int));
+    bvh->pairStarts = malloc((numOfLines + 1) * sizeof(unsigned int));
+    if (bvh->nodes == NULL || bvh->lines == NULL
+        || bvh->pairStarts == NULL) {
+      bvh->numOfLines = 0;
+      return false;
+    }
+    bvh->numOfLines = numOfLines;
+  }
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    bvh->lines[i] = i;
+  }
+
+  // Build depth first from a work list of (node, begin, end) entries, the
+  // children of each node taking the next two free slots.
+  if (!Bvh_reserveStack(bvh, 3)) {
+    return false;
+  }
+  unsigned int* stack = bvh->stack;
+  unsigned int size = 0;
+  stack[size++] = 0;
+  stack[size++] = 0;
+  stack[size++] = numOfLines;
+  bvh->numNodes = 1;
+  while (size > 0) {
+    const unsigned int end = stack[--size];
+    const unsigned int begin = stack[--size];
+    BvhNode* node = &bvh->nodes[stack[--size]];
+    if (end - begin <= BVH_LEAF_SIZE) {
+      node->first = begin;
+      node->count = end - begin;
+      continue;
+    }
+
+    const unsigned int middle = Bvh_split(bvh, boxes, begin, end);
+    node->first = bvh->numNodes;
+    node->count = 0;
+    bvh->numNodes += 2;
+    if (!Bvh_reserveStack(bvh, size + 6)) {
+      return false;
+    }
+    stack = bvh->stack;
+    stack[size++] = node->first + 1;
+    stack[size++] = middle;
+    stack[size++] = end;
+    stack[size++] = node->first;
+    stack[size++] = begin;
+    stack[size++] = middle;
+  }
+
+  Bvh_refit(bvh, boxes);
+  bvh->builtCost = bvh->cost;
+  return true;
+}
+
+// Appends the overlapping pairs among the lines of leaf node.
+static inline void Bvh_leafPairs(const Bvh* bvh, const BvhNode* node,
+                                 const SweptBox* boxes,
+                                 CandidateList* candidates) {
+  const unsigned int* lines = bvh->lines;
+  for (unsigned int a = node->first; a < node->first + node->count; a++) {
+    for (unsigned int b = a + 1; b < node->first + node->count; b++) {
+      if (SweptBox_overlap(&boxes[lines[a]], &boxes[lines[b]])) {
+        CandidateList_append(candidates, lines[a], lines[b]);
+      }
+    }
+  }
+}
+
+// Appends the overlapping pairs of a line of leaf nodeA and a line of leaf
+// nodeB.
+static inline void Bvh_crossPairs(const Bvh* bvh, const BvhNode* nodeA,
+                                  const BvhNode* nodeB, const SweptBox* boxes,
+                                  CandidateList* candidates) {
+  const unsigned int* lines = bvh->lines;
+  for (unsigned int a = nodeA->first; a < nodeA->first + nodeA->count; a++) {
+    for (unsigned int b = nodeB->first; b < nodeB->first + nodeB->count;
+         b++) {
+      if (SweptBox_overlap(&boxes[lines[a]], &boxes[lines[b]])) {
+        CandidateList_append(candidates, lines[a], lines[b]);
+      }
+    }
+  }
+}
+
+// Walks the tree against itself from a work list of node pairs, where (n, n)
+// stands for the pairs within node n and (m, n) for the pairs across two
+// disjoint subtrees, and appends every overlapping pair of lines.  Returns
+// false if memory ran out.
+static bool Bvh_traverse(Bvh* bvh, const SweptBox* boxes,
+                         CandidateList* candidates) {
+  const BvhNode* nodes = bvh->nodes;
+  if (!Bvh_reserveStack(bvh, 2)) {
+    return false;
+  }
+  unsigned int* stack = bvh->stack;
+  unsigned int size = 0;
+  stack[size++] = 0;
+  stack[size++] = 0;
+  while (size > 0) {
+    const unsigned int b = stack[--size];
+    const unsigned int a = stack[--size];
+    const BvhNode* nodeA = &nodes[a];
+    const BvhNode* nodeB = &nodes[b];
+    if (a == b) {
+      if (nodeA->count > 0) {
+        Bvh_leafPairs(bvh, nodeA, boxes, candidates);
+        continue;
+      }
+      if (!Bvh_reserveStack(bvh, size + 6)) {
+        return false;
+      }
+      stack = bvh->stack;
+      stack[size++] = nodeA->first;
+      stack[size++] = nodeA->first;
+      stack[size++] = nodeA->first + 1;
+      stack[size++] = nodeA->first + 1;
+      stack[size++] = nodeA->first;
+      stack[size++] = nodeA->first + 1;
+      continue;
+    }
+
+    if (!SweptBox_overlap(&nodeA->box, &nodeB->box)) {
+      continue;
+    }
+    if (nodeA->count > 0 && nodeB->count > 0) {
+      Bvh_crossPairs(bvh, nodeA, nodeB, boxes, candidates);
+      continue;
+    }
+    if (!Bvh_reserveStack(bvh, size + 4)) {
+      return false;
+    }
+    stack = bvh->stack;
+    // Open the larger node, so that the boxes tested shrink fastest.
+    if (nodeB->count > 0
+        || (nodeA->count == 0 && Bvh_halfPerimeter(&nodeA->box)
+                                 >= Bvh_halfPerimeter(&nodeB->box))) {
+      stack[size++] = nodeA->first;
+      stack[size++] = b;
+      stack[size++] = nodeA->first + 1;
+      stack[size++] = b;
+    } else {
+      stack[size++] = a;
+      stack[size++] = nodeB->first;
+      stack[size++] = a;
+      stack[size++] = nodeB->first + 1;
+    }
+  }
+  return !candidates->overflowed;
+}
+
+bool Bvh_findCandidates(Bvh* bvh, const SweptBox* boxes,
+                        const unsigned int numOfLines,
+                        CandidateList* candidates) {
+  if (numOfLines < 2) {
+    return true;
+  }
+
+  bool built = true;
+  if (numOfLines != bvh->numOfLines) {
+    built = Bvh_build(bvh, boxes, numOfLines);
+  } else {
+    Bvh_refit(bvh, boxes);
+    if (bvh->cost > BVH_REBUILD_RATIO * bvh->builtCost) {
+      built = Bvh_build(bvh, boxes, numOfLines);
+    }
+  }
+  if (!built) {
+    // Start over next frame.
+    bvh->numOfLines = 0;
+    return false;
+  }
+  CandidateList_clear(&bvh->pairs);
+  if (!Bvh_traverse(bvh, boxes, &bvh->pairs)) {
+    return false;
+  }
+
+  // The traversal finds a line's pairs a leaf at a time; group them by their
+  // first line with a counting sort, so that the narrow phase gets long runs
+  // of pairs sharing a line.
+  const CandidatePair* pairs = bvh->pairs.pairs;
+  const unsigned int numPairs = bvh->pairs.size;
+  if (!CandidateList_reserve(candidates, candidates->size + numPairs)) {
+    return false;
+  }
+  unsigned int* pairStarts = bvh->pairStarts;
+  for (unsigned int i = 0; i <= numOfLines; i++) {
+    pairStarts[i] = 0;
+  }
+  for (unsigned int p = 0; p < numPairs; p++) {
+    pairStarts[pairs[p].i + 1]++;
+  }
+  pairStarts[0] = candidates->size;
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    pairStarts[i + 1] += pairStarts[i];
+  }
+  for (unsigned int p = 0; p < numPairs; p++) {
+    candidates->pairs[pairStarts[pairs[p].i]++] = pairs[p];
+  }
+  candidates->size += numPairs;
+  return true;
+}
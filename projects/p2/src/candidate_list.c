@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <stdlib.h>
+
+#include "candidate_list.h"
+
+CandidateList CandidateList_make() {
+  CandidateList candidateList;
+  candidateList.pairs = NULL;
+  candidateList.size = 0;
+  candidateList.capacity = 0;
+  candidateList.overflowed = false;
+  return candidateList;
+}
+
+bool CandidateList_reserve(CandidateList* candidateList,
+                           const unsigned int capacity) {
+  if (capacity <= candidateList->capacity) {
+    return true;
+  }
+  CandidatePair* pairs = realloc(candidateList->pairs,
+                                 capacity * sizeof(CandidatePair));
+  if (pairs == NULL) {
+    return false;
+  }
+  candidateList->pairs = pairs;
+  candidateList->capacity = capacity;
+  return true;
+}
+
+void CandidateList_clear(CandidateList* candidateList) {
+  candidateList->size = 0;
+  candidateList->overflowed = false;
+}
+
+void CandidateList_delete(CandidateList* candidateList) {
+  free(candidateList->pairs);
+  *candidateList = CandidateList_make();
+}
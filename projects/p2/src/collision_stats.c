@@ -0,0 +1,298 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "collision_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fasttime.h"
+
+// Names of the phases and intersection types in the output.
+static const char* PHASE_NAMES[NUM_STATS_PHASES] = {
+  "broad", "narrow", "sort", "solver", "position", "wall"
+};
+static const char* TYPE_NAMES[] = {
+  "none", "l1_with_l2", "l2_with_l1", "already_intersected"
+};
+#define NUM_INTERSECTION_TYPES (ALREADY_INTERSECTED + 1)
+
+// What is recorded about one frame.
+struct FrameRecord {
+  double seconds[NUM_STATS_PHASES];
+  unsigned long long numCandidates;
+  unsigned int numEvents[NUM_INTERSECTION_TYPES];
+  unsigned int numWallCollisions;
+};
+typedef struct FrameRecord FrameRecord;
+
+// Counts of values in power-of-two buckets.
+struct Histogram {
+  unsigned long long buckets[STATS_HISTOGRAM_BUCKETS];
+};
+typedef struct Histogram Histogram;
+
+struct CollisionStats {
+  FILE* output;
+
+  // The frame being recorded, and when its last phase ended.
+  FrameRecord frame;
+  fasttime_t mark;
+
+  // Sums and histograms over every frame so far.  Times are binned in
+  // nanoseconds.
+  unsigned long long numFrames;
+  FrameRecord total;
+  Histogram phaseNanoseconds[NUM_STATS_PHASES];
+  Histogram frameNanoseconds;
+  Histogram candidates;
+  Histogram events;
+
+  // Number of tuner settings recorded, and the broad phase of the last.
+  unsigned long long numTunings;
+  BroadPhase tunedBroadPhase;
+};
+
+// The bucket value falls in: 0 for 0, else 1 + floor(log2(value)).
+static int Histogram_bucket(const unsigned long long value) {
+  const int bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+  return bucket < STATS_HISTOGRAM_BUCKETS ? bucket
+      : STATS_HISTOGRAM_BUCKETS - 1;
+}
+
+static void Histogram_add(Histogram* histogram,
+                          const unsigned long long value) {
+  histogram->buckets[Histogram_bucket(value)]++;
+}
+
+// Upper bound of the bucket holding the value below which a fraction of the
+// values fall.
+static unsigned long long Histogram_quantile(const Histogram* histogram,
+                                             const unsigned long long count,
+                                             const double fraction) {
+  unsigned long long seen = 0;
+  for (int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++) {
+    seen += histogram->buckets[b];
+    if (seen > 0 && seen >= fraction * count) {
+      return b == 0 ? 0 : 1ULL << b;
+    }
+  }
+  return 1ULL << (STATS_HISTOGRAM_BUCKETS - 1);
+}
+
+// Writes the histogram as a JSON object mapping each bucket's lower bound to
+// its count, skipping empty buckets.
+static void Histogram_write(const Histogram* histogram, FILE* out) {
+  bool first = true;
+  fputc('{', out);
+  for (int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++) {
+    if (histogram->buckets[b] != 0) {
+      fprintf(out, "%s\"%llu\":%llu", first ? "" : ",",
+              b == 0 ? 0 : 1ULL << (b - 1), histogram->buckets[b]);
+      first = false;
+    }
+  }
+  fputc('}', out);
+}
+
+static unsigned int FrameRecord_numEvents(const FrameRecord* record) {
+  unsigned int numEvents = 0;
+  for (int type = 0; type < NUM_INTERSECTION_TYPES; type++) {
+    numEvents += record->numEvents[type];
+  }
+  return numEvents;
+}
+
+CollisionStats* CollisionStats_new(FILE* output) {
+  CollisionStats* stats = calloc(1, sizeof(CollisionStats));
+  if (stats == NULL) {
+    return NULL;
+  }
+  stats->output = output;
+  return stats;
+}
+
+void CollisionStats_delete(CollisionStats* stats) {
+  if (stats == NULL) {
+    return;
+  }
+  if (stats->output != NULL) {
+    FILE* out = stats->output;
+    fprintf(out, "{\"type\":\"summary\",\"frames\":%llu,\"seconds\":{",
+            stats->numFrames);
+    for (int p = 0; p < NUM_STATS_PHASES; p++) {
+      fprintf(out, "%s\"%s\":%.9f", p == 0 ? "" : ",", PHASE_NAMES[p],
+              stats->total.seconds[p]);
+    }
+    fprintf(out, "},\"candidates\":%llu,\"events\":{",
+            stats->total.numCandidates);
+    for (int type = L1_WITH_L2; type < NUM_INTERSECTION_TYPES; type++) {
+      fprintf(out, "%s\"%s\":%u", type == L1_WITH_L2 ? "" : ",",
+              TYPE_NAMES[type], stats->total.numEvents[type]);
+    }
+    fprintf(out, "},\"wall\":%u,\"histograms\":{\"nanoseconds\":{",
+            stats->total.numWallCollisions);
+    for (int p = 0; p < NUM_STATS_PHASES; p++) {
+      fprintf(out, "\"%s\":", PHASE_NAMES[p]);
+      Histogram_write(&stats->phaseNanoseconds[p], out);
+      fputc(',', out);
+    }
+    fprintf(out, "\"frame\":");
+    Histogram_write(&stats->frameNanoseconds, out);
+    fprintf(out, "},\"candidates\":");
+    Histogram_write(&stats->candidates, out);
+    fprintf(out, ",\"events\":");
+    Histogram_write(&stats->events, out);
+    fprintf(out, "}}\n");
+  }
+  free(stats);
+}
+
+void CollisionStats_beginFrame(CollisionStats* stats) {
+  memset(&stats->frame, 0, sizeof(stats->frame));
+  stats->mark = gettime();
+}
+
+void CollisionStats_endPhase(CollisionStats* stats, const StatsPhase phase) {
+  const fasttime_t now = gettime();
+  stats->frame.seconds[phase] += tdiff(stats->mark, now);
+  stats->mark = now;
+}
+
+void CollisionStats_countCandidates(CollisionStats* stats,
+                                    const unsigned long long numCandidates) {
+  stats->frame.numCandidates += numCandidates;
+}
+
+void CollisionStats_countEvents(CollisionStats* stats,
+                                const IntersectionEventList* events) {
+  for (unsigned int e = 0; e < events->size; e++) {
+    stats->frame.numEvents[events->events[e].intersectionType]++;
+  }
+}
+
+void CollisionStats_countWallCollisions(CollisionStats* stats,
+                                        const unsigned int numCollisions) {
+  stats->frame.numWallCollisions += numCollisions;
+}
+
+void CollisionStats_recordTuning(CollisionStats* stats,
+                                 const BroadPhaseTuner* tuner) {
+  stats->numTunings++;
+  stats->tunedBroadPhase = tuner->broadPhase;
+  if (stats->output == NULL) {
+    return;
+  }
+  FILE* out = stats->output;
+  fprintf(out, "{\"type\":\"tuning\",\"frame\":%llu,\"broad_phase\":\"%s\","
+          "\"grid_scale\":%.4f,\"leaf_capacity\":%u,\"seconds\":{",
+          stats->numFrames + 1, BroadPhase_name(tuner->broadPhase),
+          tuner->gridScale, tuner->leafCapacity);
+  bool first = true;
+  for (int b = 0; b < NUM_BROAD_PHASES; b++) {
+    if (tuner->seconds[b] > 0) {
+      fprintf(out, "%s\"%s\":%.9f", first ? "" : ",",
+              BroadPhase_name((BroadPhase) b), tuner->seconds[b]);
+      first = false;
+    }
+  }
+  fprintf(out, "},\"pairs\":{");
+  first = true;
+  for (int b = 0; b < NUM_BROAD_PHASES; b++) {
+    if (tuner->seconds[b] > 0) {
+      fprintf(out, "%s\"%s\":%.1f", first ? "" : ",",
+              BroadPhase_name((BroadPhase) b), tuner->pairs[b]);
+      first = false;
+    }
+  }
+  fprintf(out, "},\"mean_length\":%.6g,\"mean_extent\":%.6g,"
+          "\"occupancy\":%.4f}\n", tuner->sample.meanLength,
+          tuner->sample.meanExtent, tuner->sample.occupancy);
+}
+
+void CollisionStats_endFrame(CollisionStats* stats) {
+  const FrameRecord* frame = &stats->frame;
+  stats->numFrames++;
+
+  double frameSeconds = 0;
+  for (int p = 0; p < NUM_STATS_PHASES; p++) {
+    stats->total.seconds[p] += frame->seconds[p];
+    Histogram_add(&stats->phaseNanoseconds[p], frame->seconds[p] * 1e9);
+    frameSeconds += frame->seconds[p];
+  }
+  Histogram_add(&stats->frameNanoseconds, frameSeconds * 1e9);
+  stats->total.numCandidates += frame->numCandidates;
+  Histogram_add(&stats->candidates, frame->numCandidates);
+  for (int type = 0; type < NUM_INTERSECTION_TYPES; type++) {
+    stats->total.numEvents[type] += frame->numEvents[type];
+  }
+  Histogram_add(&stats->events, FrameRecord_numEvents(frame));
+  stats->total.numWallCollisions += frame->numWallCollisions;
+
+  if (stats->output == NULL) {
+    return;
+  }
+  FILE* out = stats->output;
+  fprintf(out, "{\"type\":\"frame\",\"frame\":%llu,\"seconds\":{",
+          stats->numFrames);
+  for (int p = 0; p < NUM_STATS_PHASES; p++) {
+    fprintf(out, "%s\"%s\":%.9f", p == 0 ? "" : ",", PHASE_NAMES[p],
+            frame->seconds[p]);
+  }
+  fprintf(out, "},\"candidates\":%llu,\"intersections\":%u,\"events\":{",
+          frame->numCandidates, FrameRecord_numEvents(frame));
+  for (int type = L1_WITH_L2; type < NUM_INTERSECTION_TYPES; type++) {
+    fprintf(out, "%s\"%s\":%u", type == L1_WITH_L2 ? "" : ",",
+            TYPE_NAMES[type], frame->numEvents[type]);
+  }
+  fprintf(out, "},\"wall\":%u}\n", frame->numWallCollisions);
+}
+
+void CollisionStats_print(const CollisionStats* stats, FILE* out) {
+  const unsigned long long numFrames = stats->numFrames;
+  if (numFrames == 0) {
+    return;
+  }
+  fprintf(out, "%-10s %12s %12s %12s %12s\n", "phase", "total (s)",
+          "mean (us)", "~p50 (us)", "~p99 (us)");
+  for (int p = 0; p < NUM_STATS_PHASES; p++) {
+    fprintf(out, "%-10s %12.6f %12.1f %12.1f %12.1f\n", PHASE_NAMES[p],
+            stats->total.seconds[p], stats->total.seconds[p] / numFrames * 1e6,
+            Histogram_quantile(&stats->phaseNanoseconds[p], numFrames, 0.5)
+            * 1e-3,
+            Histogram_quantile(&stats->phaseNanoseconds[p], numFrames, 0.99)
+            * 1e-3);
+  }
+  fprintf(out, "Per frame: %.1f candidate pairs, %.1f intersections (",
+          (double) stats->total.numCandidates / numFrames,
+          (double) FrameRecord_numEvents(&stats->total) / numFrames);
+  for (int type = L1_WITH_L2; type < NUM_INTERSECTION_TYPES; type++) {
+    fprintf(out, "%s%s %.1f", type == L1_WITH_L2 ? "" : ", ", TYPE_NAMES[type],
+            (double) stats->total.numEvents[type] / numFrames);
+  }
+  fprintf(out, "), %.2f wall collisions\n",
+          (double) stats->total.numWallCollisions / numFrames);
+  if (stats->numTunings > 0) {
+    fprintf(out, "Broad phase tuned %llu times, lastly to %s\n",
+            stats->numTunings, BroadPhase_name(stats->tunedBroadPhase));
+  }
+}
@@ -25,12 +25,40 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+// Without OpenMP, everything runs on a single thread.
+static inline int omp_get_max_threads() {
+  return 1;
+}
+static inline int omp_get_thread_num() {
+  return 0;
+}
+#endif
 
 #include "collision_world.h"
+#include "fasttime.h"
 #include "intersection_detection.h"
 #include "intersection_event_list.h"
 #include "line.h"
 
+// Number of candidate pairs handed to a thread at a time.
+#define CANDIDATE_CHUNK_SIZE 256
+
+
+// Allocates an array of count elements of elementSize bytes, aligned to
+// LINE_ARRAY_ALIGNMENT.  Returns NULL if memory could not be allocated.
+static void* CollisionWorld_allocateArray(const unsigned int count,
+                                          const size_t elementSize) {
+  void* array;
+  if (posix_memalign(&array, LINE_ARRAY_ALIGNMENT, count * elementSize) != 0) {
+    return NULL;
+  }
+  return array;
+}
 
 CollisionWorld* CollisionWorld_new(const unsigned int capacity) {
   assert(capacity > 0);
@@ -42,17 +70,78 @@ CollisionWorld* CollisionWorld_new(const unsigned int capacity) {
 
   collisionWorld->numLineWallCollisions = 0;
   collisionWorld->numLineLineCollisions = 0;
+  collisionWorld->numPairsTested = 0;
   collisionWorld->timeStep = 0.5;
-  collisionWorld->lines = malloc(capacity * sizeof(Line*));
+  collisionWorld->frame = 0;
+  collisionWorld->p1x = CollisionWorld_allocateArray(capacity, sizeof(double));
+  collisionWorld->p1y = CollisionWorld_allocateArray(capacity, sizeof(double));
+  collisionWorld->p2x = CollisionWorld_allocateArray(capacity, sizeof(double));
+  collisionWorld->p2y = CollisionWorld_allocateArray(capacity, sizeof(double));
+  collisionWorld->vx = CollisionWorld_allocateArray(capacity, sizeof(double));
+  collisionWorld->vy = CollisionWorld_allocateArray(capacity, sizeof(double));
+  collisionWorld->color = CollisionWorld_allocateArray(capacity, sizeof(Color));
+  collisionWorld->id = CollisionWorld_allocateArray(capacity,
+                                                    sizeof(unsigned int));
   collisionWorld->numOfLines = 0;
+  collisionWorld->boxes = CollisionWorld_allocateArray(capacity,
+                                                       sizeof(SweptBox));
+  collisionWorld->lineBatch = calloc(capacity, sizeof(unsigned int));
+  collisionWorld->frameArena = FrameArena_make();
+  collisionWorld->broadPhase = BROAD_PHASE_GRID;
+  collisionWorld->tuner = NULL;
+  collisionWorld->reference = false;
+  collisionWorld->grid = NULL;
+  collisionWorld->quadTree = NULL;
+  collisionWorld->sweepAndPrune = NULL;
+  collisionWorld->bvh = NULL;
+  collisionWorld->usePairCache = true;
+  collisionWorld->pairCache = NULL;
+  collisionWorld->useKinetic = false;
+  collisionWorld->kinetic = NULL;
+  collisionWorld->candidates = CandidateList_make();
+  collisionWorld->intersectionEvents = IntersectionEventList_make();
+  collisionWorld->threadEventLists = NULL;
+  collisionWorld->numThreadEventLists = 0;
+  collisionWorld->stats = NULL;
+  if (collisionWorld->p1x == NULL || collisionWorld->p1y == NULL
+      || collisionWorld->p2x == NULL || collisionWorld->p2y == NULL
+      || collisionWorld->vx == NULL || collisionWorld->vy == NULL
+      || collisionWorld->color == NULL || collisionWorld->id == NULL
+      || collisionWorld->boxes == NULL || collisionWorld->lineBatch == NULL) {
+    CollisionWorld_delete(collisionWorld);
+    return NULL;
+  }
   return collisionWorld;
 }
 
 void CollisionWorld_delete(CollisionWorld* collisionWorld) {
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    free(collisionWorld->lines[i]);
+  if (collisionWorld == NULL) {
+    return;
   }
-  free(collisionWorld->lines);
+  free(collisionWorld->p1x);
+  free(collisionWorld->p1y);
+  free(collisionWorld->p2x);
+  free(collisionWorld->p2y);
+  free(collisionWorld->vx);
+  free(collisionWorld->vy);
+  free(collisionWorld->color);
+  free(collisionWorld->id);
+  free(collisionWorld->boxes);
+  free(collisionWorld->lineBatch);
+  FrameArena_delete(&collisionWorld->frameArena);
+  Grid_delete(collisionWorld->grid);
+  QuadTree_delete(collisionWorld->quadTree);
+  SweepAndPrune_delete(collisionWorld->sweepAndPrune);
+  Bvh_delete(collisionWorld->bvh);
+  BroadPhaseTuner_delete(collisionWorld->tuner);
+  PairCache_delete(collisionWorld->pairCache);
+  Kinetic_delete(collisionWorld->kinetic);
+  CandidateList_delete(&collisionWorld->candidates);
+  IntersectionEventList_delete(&collisionWorld->intersectionEvents);
+  for (int t = 0; t < collisionWorld->numThreadEventLists; t++) {
+    IntersectionEventList_delete(&collisionWorld->threadEventLists[t]);
+  }
+  free(collisionWorld->threadEventLists);
   free(collisionWorld);
 }
 
@@ -61,125 +150,687 @@ unsigned int CollisionWorld_getNumOfLines(CollisionWorld* collisionWorld) {
 }
 
 void CollisionWorld_addLine(CollisionWorld* collisionWorld, Line *line) {
-  collisionWorld->lines[collisionWorld->numOfLines] = line;
+  const unsigned int i = collisionWorld->numOfLines;
+  assert(line->id == i);
+  collisionWorld->p1x[i] = line->p1.x;
+  collisionWorld->p1y[i] = line->p1.y;
+  collisionWorld->p2x[i] = line->p2.x;
+  collisionWorld->p2y[i] = line->p2.y;
+  collisionWorld->vx[i] = line->velocity.x;
+  collisionWorld->vy[i] = line->velocity.y;
+  collisionWorld->color[i] = line->color;
+  collisionWorld->id[i] = line->id;
   collisionWorld->numOfLines++;
 }
 
-Line* CollisionWorld_getLine(CollisionWorld* collisionWorld,
-                             const unsigned int index) {
-  if (index >= collisionWorld->numOfLines) {
-    return NULL;
+unsigned int CollisionWorld_appendLines(CollisionWorld* collisionWorld,
+                                        const unsigned int n) {
+  const unsigned int first = collisionWorld->numOfLines;
+  for (unsigned int i = first; i < first + n; i++) {
+    collisionWorld->id[i] = i;
   }
-  return collisionWorld->lines[index];
+  collisionWorld->numOfLines += n;
+  return first;
+}
+
+Line CollisionWorld_getLine(CollisionWorld* collisionWorld,
+                            const unsigned int index) {
+  assert(index < collisionWorld->numOfLines);
+  Line line;
+  line.p1 = Vec_make(collisionWorld->p1x[index], collisionWorld->p1y[index]);
+  line.p2 = Vec_make(collisionWorld->p2x[index], collisionWorld->p2y[index]);
+  line.velocity = Vec_make(collisionWorld->vx[index],
+                           collisionWorld->vy[index]);
+  line.color = collisionWorld->color[index];
+  line.id = collisionWorld->id[index];
+  return line;
+}
+
+// Returns true if the world is set to skip the collision work of quiet
+// frames and the coming frame is one.
+static bool CollisionWorld_isQuiet(CollisionWorld* collisionWorld) {
+  if (!collisionWorld->useKinetic) {
+    return false;
+  }
+  if (collisionWorld->kinetic == NULL) {
+    collisionWorld->kinetic = Kinetic_new();
+    if (collisionWorld->kinetic == NULL) {
+      return false;
+    }
+  }
+  return Kinetic_isQuiet(collisionWorld->kinetic, collisionWorld->p1x,
+                         collisionWorld->p1y, collisionWorld->p2x,
+                         collisionWorld->p2y, collisionWorld->vx,
+                         collisionWorld->vy, collisionWorld->timeStep,
+                         collisionWorld->numOfLines, collisionWorld->frame);
 }
 
 void CollisionWorld_updateLines(CollisionWorld* collisionWorld) {
-  CollisionWorld_detectIntersection(collisionWorld);
-  CollisionWorld_updatePosition(collisionWorld);
-  CollisionWorld_lineWallCollision(collisionWorld);
+  CollisionStats* stats = collisionWorld->stats;
+  COLLISION_STATS_RECORD(stats, CollisionStats_beginFrame);
+  if (CollisionWorld_isQuiet(collisionWorld)) {
+    // The scheduling counts as broad phase work.
+    COLLISION_STATS_RECORD(stats, CollisionStats_endPhase, STATS_BROAD_PHASE);
+    CollisionWorld_updatePosition(collisionWorld);
+    COLLISION_STATS_RECORD(stats, CollisionStats_endPhase,
+                           STATS_POSITION_UPDATE);
+  } else {
+    const unsigned int numCollisions = collisionWorld->numLineWallCollisions
+                                       + collisionWorld->numLineLineCollisions;
+    CollisionWorld_detectIntersection(collisionWorld);
+    CollisionWorld_updatePosition(collisionWorld);
+    COLLISION_STATS_RECORD(stats, CollisionStats_endPhase,
+                           STATS_POSITION_UPDATE);
+    CollisionWorld_lineWallCollision(collisionWorld);
+    COLLISION_STATS_RECORD(stats, CollisionStats_endPhase,
+                           STATS_WALL_COLLISION);
+    // Every collision changes a velocity, which puts the events out of date.
+    if (collisionWorld->kinetic != NULL
+        && collisionWorld->numLineWallCollisions
+           + collisionWorld->numLineLineCollisions != numCollisions) {
+      Kinetic_invalidate(collisionWorld->kinetic);
+    }
+  }
+  COLLISION_STATS_RECORD(stats, CollisionStats_endFrame);
+  FrameArena_reset(&collisionWorld->frameArena);
+  collisionWorld->frame++;
 }
 
 void CollisionWorld_updatePosition(CollisionWorld* collisionWorld) {
-  double t = collisionWorld->timeStep;
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    Line *line = collisionWorld->lines[i];
-    line->p1 = Vec_add(line->p1, Vec_multiply(line->velocity, t));
-    line->p2 = Vec_add(line->p2, Vec_multiply(line->velocity, t));
+  const double t = collisionWorld->timeStep;
+  const int n = collisionWorld->numOfLines;
+  double* restrict p1x = collisionWorld->p1x;
+  double* restrict p1y = collisionWorld->p1y;
+  double* restrict p2x = collisionWorld->p2x;
+  double* restrict p2y = collisionWorld->p2y;
+  const double* restrict vx = collisionWorld->vx;
+  const double* restrict vy = collisionWorld->vy;
+  for (int i = 0; i < n; i++) {
+    p1x[i] += vx[i] * t;
+    p1y[i] += vy[i] * t;
+    p2x[i] += vx[i] * t;
+    p2y[i] += vy[i] * t;
   }
 }
 
 void CollisionWorld_lineWallCollision(CollisionWorld* collisionWorld) {
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    Line *line = collisionWorld->lines[i];
-    bool collide = false;
+  const int n = collisionWorld->numOfLines;
+  const double* restrict p1x = collisionWorld->p1x;
+  const double* restrict p1y = collisionWorld->p1y;
+  const double* restrict p2x = collisionWorld->p2x;
+  const double* restrict p2y = collisionWorld->p2y;
+  double* restrict vx = collisionWorld->vx;
+  double* restrict vy = collisionWorld->vy;
+  unsigned int numCollisions = 0;
+
+  // The sides are checked in turn, each against the velocity left by the
+  // previous check, but with selects rather than branches so that the loop
+  // vectorizes.
+  for (int i = 0; i < n; i++) {
+    double x = vx[i];
+    double y = vy[i];
 
     // Right side
-    if ((line->p1.x > BOX_XMAX || line->p2.x > BOX_XMAX)
-        && (line->velocity.x > 0)) {
-      line->velocity.x = -line->velocity.x;
-      collide = true;
-    }
+    const bool right = (p1x[i] > BOX_XMAX || p2x[i] > BOX_XMAX) && x > 0;
+    x = right ? -x : x;
     // Left side
-    if ((line->p1.x < BOX_XMIN || line->p2.x < BOX_XMIN)
-        && (line->velocity.x < 0)) {
-      line->velocity.x = -line->velocity.x;
-      collide = true;
-    }
+    const bool left = (p1x[i] < BOX_XMIN || p2x[i] < BOX_XMIN) && x < 0;
+    x = left ? -x : x;
     // Top side
-    if ((line->p1.y > BOX_YMAX || line->p2.y > BOX_YMAX)
-        && (line->velocity.y > 0)) {
-      line->velocity.y = -line->velocity.y;
-      collide = true;
-    }
+    const bool top = (p1y[i] > BOX_YMAX || p2y[i] > BOX_YMAX) && y > 0;
+    y = top ? -y : y;
     // Bottom side
-    if ((line->p1.y < BOX_YMIN || line->p2.y < BOX_YMIN)
-        && (line->velocity.y < 0)) {
-      line->velocity.y = -line->velocity.y;
-      collide = true;
-    }
+    const bool bottom = (p1y[i] < BOX_YMIN || p2y[i] < BOX_YMIN) && y < 0;
+    y = bottom ? -y : y;
+
+    vx[i] = x;
+    vy[i] = y;
     // Update total number of collisions.
-    if (collide == true) {
-      collisionWorld->numLineWallCollisions++;
-    }
+    numCollisions += right | left | top | bottom;
   }
+  collisionWorld->numLineWallCollisions += numCollisions;
+  COLLISION_STATS_RECORD(collisionWorld->stats,
+                         CollisionStats_countWallCollisions, numCollisions);
 }
 
-void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld) {
-  IntersectionEventList intersectionEventList = IntersectionEventList_make();
+void CollisionWorld_setStats(CollisionWorld* collisionWorld,
+                             CollisionStats* stats) {
+  collisionWorld->stats = stats;
+}
+
+void CollisionWorld_setBroadPhase(CollisionWorld* collisionWorld,
+                                  const BroadPhase broadPhase) {
+  collisionWorld->broadPhase = broadPhase;
+}
+
+void CollisionWorld_setPairCache(CollisionWorld* collisionWorld,
+                                 const bool usePairCache) {
+  collisionWorld->usePairCache = usePairCache;
+  // The grid may be used without the cache in between.
+  if (collisionWorld->pairCache != NULL) {
+    PairCache_invalidate(collisionWorld->pairCache);
+  }
+}
+
+void CollisionWorld_setKinetic(CollisionWorld* collisionWorld,
+                               const bool useKinetic) {
+  collisionWorld->useKinetic = useKinetic;
+  // The velocities may change in between.
+  if (collisionWorld->kinetic != NULL) {
+    Kinetic_invalidate(collisionWorld->kinetic);
+  }
+}
+
+unsigned long long CollisionWorld_getNumQuietFrames(
+    CollisionWorld* collisionWorld) {
+  return collisionWorld->kinetic == NULL
+      ? 0 : collisionWorld->kinetic->numQuietFrames;
+}
+
+void CollisionWorld_setReference(CollisionWorld* collisionWorld,
+                                 const bool reference) {
+  collisionWorld->reference = reference;
+}
 
-  // Test all line-line pairs to see if they will intersect before the
-  // next time step.
-  for (int i = 0; i < collisionWorld->numOfLines; i++) {
-    Line *l1 = collisionWorld->lines[i];
+// Classify a pair of lines with intersect, or with intersectReference if the
+// world is set to use the reference code.
+static inline IntersectionType CollisionWorld_intersect(
+    const CollisionWorld* collisionWorld, Line *l1, Line *l2) {
+  return collisionWorld->reference
+      ? intersectReference(l1, l2, collisionWorld->timeStep)
+      : intersect(l1, l2, collisionWorld->timeStep);
+}
+
+// Test whether lines i and j will intersect before the next time step, and
+// if so record the event.  Returns 1 if they will and the event was recorded,
+// 0 otherwise; an event that could not be recorded for lack of memory is not
+// solved, so it is not counted either.  Does not modify the collision world,
+// so that threads may test pairs concurrently.
+static inline unsigned int CollisionWorld_testPair(
+    CollisionWorld* collisionWorld, const unsigned int i, const unsigned int j,
+    IntersectionEventList* intersectionEventList) {
+  Line l1 = CollisionWorld_getLine(collisionWorld, i);
+  Line l2 = CollisionWorld_getLine(collisionWorld, j);
+
+  // intersect expects compareLines(l1, l2) < 0 to be true.
+  // Swap l1 and l2, if necessary.
+  if (compareLines(&l1, &l2) >= 0) {
+    Line temp = l1;
+    l1 = l2;
+    l2 = temp;
+  }
 
-    for (int j = i + 1; j < collisionWorld->numOfLines; j++) {
-      Line *l2 = collisionWorld->lines[j];
+  IntersectionType intersectionType =
+      CollisionWorld_intersect(collisionWorld, &l1, &l2);
+  if (intersectionType != NO_INTERSECTION
+      && IntersectionEventList_append(intersectionEventList, &l1, &l2,
+                                      intersectionType)) {
+    return 1;
+  }
+  return 0;
+}
 
-      // intersect expects compareLines(l1, l2) < 0 to be true.
-      // Swap l1 and l2, if necessary.
-      if (compareLines(l1, l2) >= 0) {
-        Line *temp = l1;
+// Test line pairs[0].i against lines pairs[0..count).j, recording an event
+// for every pair that will intersect.  Every pair must share its first line.
+// The lines are packed into a block and screened by intersectBlock; only the
+// pairs it cannot rule out go through intersect().  Returns the number of
+// events recorded.
+static unsigned int CollisionWorld_testBlock(
+    CollisionWorld* collisionWorld, const CandidatePair* pairs,
+    const unsigned int count, IntersectionEventList* intersectionEventList) {
+  assert(count > 0 && count <= INTERSECT_BLOCK_SIZE);
+  const unsigned int i = pairs[0].i;
+  if (count == 1) {
+    return CollisionWorld_testPair(collisionWorld, i, pairs[0].j,
+                                   intersectionEventList);
+  }
+
+  // Unused lanes repeat the last line, and are masked off below.
+  LineBlock block;
+  for (unsigned int k = 0; k < INTERSECT_BLOCK_SIZE; k++) {
+    assert(k >= count || pairs[k].i == i);
+    const unsigned int j = pairs[k < count ? k : count - 1].j;
+    block.p1x[k] = collisionWorld->p1x[j];
+    block.p1y[k] = collisionWorld->p1y[j];
+    block.p2x[k] = collisionWorld->p2x[j];
+    block.p2y[k] = collisionWorld->p2y[j];
+    block.vx[k] = collisionWorld->vx[j];
+    block.vy[k] = collisionWorld->vy[j];
+    block.id[k] = collisionWorld->id[j];
+  }
+  const Line line = CollisionWorld_getLine(collisionWorld, i);
+  unsigned int mask = intersectBlock(&line, &block, collisionWorld->timeStep)
+      & ((1u << count) - 1);
+
+#ifndef NDEBUG
+  // The screen must only rule out pairs that intersect() rules out.
+  for (unsigned int k = 0; k < count; k++) {
+    if ((mask >> k & 1) == 0) {
+      Line l1 = line;
+      Line l2 = CollisionWorld_getLine(collisionWorld, pairs[k].j);
+      if (compareLines(&l1, &l2) >= 0) {
+        Line temp = l1;
         l1 = l2;
         l2 = temp;
       }
+      assert(CollisionWorld_intersect(collisionWorld, &l1, &l2)
+             == NO_INTERSECTION);
+    }
+  }
+#endif
+
+  unsigned int numCollisions = 0;
+  while (mask != 0) {
+    const unsigned int k = __builtin_ctz(mask);
+    mask &= mask - 1;
+    numCollisions += CollisionWorld_testPair(collisionWorld, i, pairs[k].j,
+                                             intersectionEventList);
+  }
+  return numCollisions;
+}
 
-      IntersectionType intersectionType =
-          intersect(l1, l2, collisionWorld->timeStep);
-      if (intersectionType != NO_INTERSECTION) {
-        IntersectionEventList_appendNode(&intersectionEventList, l1, l2,
-                                         intersectionType);
-        collisionWorld->numLineLineCollisions++;
-      }
+// Returns the broad phase to run this frame.  With BROAD_PHASE_AUTO, that is
+// the tuner's pick, and the tuner's parameters are applied.
+static BroadPhase CollisionWorld_activeBroadPhase(
+    CollisionWorld* collisionWorld) {
+  if (collisionWorld->broadPhase != BROAD_PHASE_AUTO) {
+    return collisionWorld->broadPhase;
+  }
+  if (collisionWorld->tuner == NULL) {
+    collisionWorld->tuner = BroadPhaseTuner_new();
+    if (collisionWorld->tuner == NULL) {
+      return BROAD_PHASE_GRID;
+    }
+  }
+  const BroadPhaseTuner* tuner = collisionWorld->tuner;
+  if (collisionWorld->grid != NULL
+      && collisionWorld->grid->resolutionScale != tuner->gridScale) {
+    collisionWorld->grid->resolutionScale = tuner->gridScale;
+    // The cached pairs were found at the old resolution.
+    if (collisionWorld->pairCache != NULL) {
+      PairCache_invalidate(collisionWorld->pairCache);
     }
   }
+  if (collisionWorld->quadTree != NULL) {
+    collisionWorld->quadTree->leafCapacity = tuner->leafCapacity;
+  }
+  return tuner->broadPhase;
+}
+
+// Run the given broad phase over the given boxes (one per line), appending
+// the pairs it cannot rule out to candidates.  Returns false if there is no
+// broad phase to run (brute force) or it ran out of memory.
+static bool CollisionWorld_findCandidates(CollisionWorld* collisionWorld,
+                                          const BroadPhase broadPhase,
+                                          const SweptBox* boxes,
+                                          CandidateList* candidates) {
+  const unsigned int numOfLines = collisionWorld->numOfLines;
+  switch (broadPhase) {
+    case BROAD_PHASE_GRID:
+      if (collisionWorld->grid == NULL) {
+        collisionWorld->grid = Grid_new();
+      }
+      return collisionWorld->grid != NULL
+          && Grid_findCandidates(collisionWorld->grid, boxes, numOfLines,
+                                 candidates);
+    case BROAD_PHASE_QUADTREE:
+      if (collisionWorld->quadTree == NULL) {
+        collisionWorld->quadTree = QuadTree_new(QUADTREE_DEFAULT_MAX_DEPTH,
+                                                QUADTREE_DEFAULT_LEAF_CAPACITY);
+      }
+      return collisionWorld->quadTree != NULL
+          && QuadTree_findCandidates(collisionWorld->quadTree, boxes,
+                                     numOfLines, candidates);
+    case BROAD_PHASE_SWEEP_AND_PRUNE:
+      if (collisionWorld->sweepAndPrune == NULL) {
+        collisionWorld->sweepAndPrune = SweepAndPrune_new();
+      }
+      return collisionWorld->sweepAndPrune != NULL
+          && SweepAndPrune_findCandidates(collisionWorld->sweepAndPrune,
+                                          boxes, numOfLines, candidates);
+    case BROAD_PHASE_BVH:
+      if (collisionWorld->bvh == NULL) {
+        collisionWorld->bvh = Bvh_new();
+      }
+      return collisionWorld->bvh != NULL
+          && Bvh_findCandidates(collisionWorld->bvh, boxes, numOfLines,
+                                candidates);
+    case BROAD_PHASE_BRUTE_FORCE:
+    case BROAD_PHASE_AUTO:
+    default:
+      return false;
+  }
+}
+
+// Resolves an intersection event.  Line IDs double as indices, so the solver
+// works on copies of the lines and only their new velocities need to be
+// written back.
+static void CollisionWorld_solveEvent(CollisionWorld* collisionWorld,
+                                      const IntersectionEvent* event) {
+  Line l1 = CollisionWorld_getLine(collisionWorld, event->id1);
+  Line l2 = CollisionWorld_getLine(collisionWorld, event->id2);
+  CollisionWorld_collisionSolver(collisionWorld, &l1, &l2,
+                                 event->intersectionType);
+  collisionWorld->vx[event->id1] = l1.velocity.x;
+  collisionWorld->vy[event->id1] = l1.velocity.y;
+  collisionWorld->vx[event->id2] = l2.velocity.x;
+  collisionWorld->vy[event->id2] = l2.velocity.y;
+}
+
+// Orders events by IntersectionEvent_compareData, for qsort.
+static int CollisionWorld_compareEvents(const void* event1,
+                                        const void* event2) {
+  return IntersectionEvent_compareData(event1, event2);
+}
+
+// Orders events by IntersectionEvent_compareData, last first, for qsort.
+static int CollisionWorld_compareEventsDescending(const void* event1,
+                                                  const void* event2) {
+  return IntersectionEvent_compareData(event2, event1);
+}
+
+// Solves the events that could not be gathered into the world's list, from
+// the per-thread lists and the world's list where they are.  Each list is
+// sorted in place, last event first, and the lists are merged by repeatedly
+// solving the least of their last events, which solves the events in the
+// order that sorting them all together would give.
+static void CollisionWorld_solveUngathered(
+    CollisionWorld* collisionWorld, IntersectionEventList* threadEventLists,
+    const int numThreads) {
+  CollisionStats* stats = collisionWorld->stats;
+  IntersectionEventList* gathered = &collisionWorld->intersectionEvents;
+  qsort(gathered->events, gathered->size, sizeof(IntersectionEvent),
+        CollisionWorld_compareEventsDescending);
+  for (int t = 0; t < numThreads; t++) {
+    qsort(threadEventLists[t].events, threadEventLists[t].size,
+          sizeof(IntersectionEvent), CollisionWorld_compareEventsDescending);
+  }
+  COLLISION_STATS_RECORD(stats, CollisionStats_endPhase, STATS_EVENT_SORT);
+  COLLISION_STATS_RECORD(stats, CollisionStats_countEvents, gathered);
+  for (int t = 0; t < numThreads; t++) {
+    COLLISION_STATS_RECORD(stats, CollisionStats_countEvents,
+                           &threadEventLists[t]);
+  }
 
-  // Sort the intersection event list.
-  IntersectionEventNode* startNode = intersectionEventList.head;
-  while (startNode != NULL) {
-    IntersectionEventNode* minNode = startNode;
-    IntersectionEventNode* curNode = startNode->next;
-    while (curNode != NULL) {
-      if (IntersectionEventNode_compareData(curNode, minNode) < 0) {
-        minNode = curNode;
+  while (true) {
+    IntersectionEventList* next = gathered->size > 0 ? gathered : NULL;
+    for (int t = 0; t < numThreads; t++) {
+      IntersectionEventList* list = &threadEventLists[t];
+      if (list->size > 0
+          && (next == NULL
+              || IntersectionEvent_compareData(
+                  &list->events[list->size - 1],
+                  &next->events[next->size - 1]) < 0)) {
+        next = list;
       }
-      curNode = curNode->next;
     }
-    if (minNode != startNode) {
-      IntersectionEventNode_swapData(minNode, startNode);
+    if (next == NULL) {
+      break;
     }
-    startNode = startNode->next;
+    CollisionWorld_solveEvent(collisionWorld, &next->events[--next->size]);
+  }
+  COLLISION_STATS_RECORD(stats, CollisionStats_endPhase, STATS_SOLVER);
+}
+
+// Splits this frame's sorted events into batches that can be solved in
+// parallel, in arrays from the frame arena: the batch of each event, the
+// events' indices grouped by batch, and where each batch starts, batch b being
+// batchEvents[batchStarts[b] .. batchStarts[b + 1]).  No two events of a batch
+// share a line, and each line's events fall in increasing batches in their
+// sorted order.  Solving the batches one after the other thus applies every
+// line's collisions in the same order as solving the events one by one, and
+// gives bit-identical velocities.  Each event goes in the batch after the
+// latest one holding an event of either of its lines.  Returns the number of
+// batches, or 0 if memory could not be allocated, and sets *batchEventsOut and
+// *batchStartsOut.
+static unsigned int CollisionWorld_batchEvents(CollisionWorld* collisionWorld,
+                                               unsigned int** batchEventsOut,
+                                               unsigned int** batchStartsOut) {
+  const IntersectionEventList* eventList = &collisionWorld->intersectionEvents;
+  const IntersectionEvent* events = eventList->events;
+  const unsigned int numEvents = eventList->size;
+  FrameArena* arena = &collisionWorld->frameArena;
+  unsigned int* eventBatch =
+      FrameArena_allocate(arena, numEvents * sizeof(unsigned int));
+  unsigned int* batchEvents =
+      FrameArena_allocate(arena, numEvents * sizeof(unsigned int));
+  if (eventBatch == NULL || batchEvents == NULL) {
+    return 0;
+  }
+  unsigned int* lineBatch = collisionWorld->lineBatch;
+
+  // Number the batches from 1 while assigning them, as 0 marks a line with
+  // no events yet.
+  unsigned int numBatches = 0;
+  for (unsigned int e = 0; e < numEvents; e++) {
+    const unsigned int id1 = events[e].id1;
+    const unsigned int id2 = events[e].id2;
+    const unsigned int batch = 1 + (lineBatch[id1] > lineBatch[id2]
+                                    ? lineBatch[id1] : lineBatch[id2]);
+    lineBatch[id1] = batch;
+    lineBatch[id2] = batch;
+    eventBatch[e] = batch - 1;
+    numBatches = batch > numBatches ? batch : numBatches;
+  }
+  for (unsigned int e = 0; e < numEvents; e++) {
+    lineBatch[events[e].id1] = 0;
+    lineBatch[events[e].id2] = 0;
+  }
+  unsigned int* batchStarts =
+      FrameArena_allocate(arena, (numBatches + 1) * sizeof(unsigned int));
+  if (batchStarts == NULL) {
+    return 0;
+  }
+
+  // Group the events by batch with a counting sort, which keeps them in
+  // order within each batch.  While filling the batches, batchStarts[b]
+  // points past the last event placed in batch b so far, so it ends up at
+  // the start of batch b + 1, and is shifted back afterwards.
+  memset(batchStarts, 0, (numBatches + 1) * sizeof(unsigned int));
+  for (unsigned int e = 0; e < numEvents; e++) {
+    batchStarts[eventBatch[e] + 1]++;
+  }
+  for (unsigned int b = 1; b <= numBatches; b++) {
+    batchStarts[b] += batchStarts[b - 1];
   }
+  for (unsigned int e = 0; e < numEvents; e++) {
+    batchEvents[batchStarts[eventBatch[e]]++] = e;
+  }
+  for (unsigned int b = numBatches; b > 0; b--) {
+    batchStarts[b] = batchStarts[b - 1];
+  }
+  batchStarts[0] = 0;
+  *batchEventsOut = batchEvents;
+  *batchStartsOut = batchStarts;
+  return numBatches;
+}
 
-  // Call the collision solver for each intersection event.
-  IntersectionEventNode* curNode = intersectionEventList.head;
+void CollisionWorld_detectIntersection(CollisionWorld* collisionWorld) {
+  IntersectionEventList* intersectionEventList =
+      &collisionWorld->intersectionEvents;
+  IntersectionEventList_clear(intersectionEventList);
+  CollisionStats* stats = collisionWorld->stats;
+  const int numOfLines = collisionWorld->numOfLines;
+
+  // Each thread records its events in a list of its own.  If there is no
+  // memory for the lists, a single thread records every event directly.
+  const int numThreads = omp_get_max_threads();
+  if (numThreads > collisionWorld->numThreadEventLists) {
+    IntersectionEventList* threadEventLists =
+        realloc(collisionWorld->threadEventLists,
+                numThreads * sizeof(IntersectionEventList));
+    if (threadEventLists != NULL) {
+      for (int t = collisionWorld->numThreadEventLists; t < numThreads; t++) {
+        threadEventLists[t] = IntersectionEventList_make();
+      }
+      collisionWorld->threadEventLists = threadEventLists;
+      collisionWorld->numThreadEventLists = numThreads;
+    }
+  }
+  const bool useThreadEventLists =
+      numThreads <= collisionWorld->numThreadEventLists;
+  IntersectionEventList* threadEventLists = collisionWorld->threadEventLists;
+
+  // Compute the area each line sweeps over the time step.
+  const fasttime_t start = gettime();
+  const BroadPhase broadPhase = CollisionWorld_activeBroadPhase(collisionWorld);
+  if (broadPhase != BROAD_PHASE_BRUTE_FORCE) {
+    const double* restrict p1x = collisionWorld->p1x;
+    const double* restrict p1y = collisionWorld->p1y;
+    const double* restrict p2x = collisionWorld->p2x;
+    const double* restrict p2y = collisionWorld->p2y;
+    const double* restrict vx = collisionWorld->vx;
+    const double* restrict vy = collisionWorld->vy;
+    SweptBox* restrict boxes = collisionWorld->boxes;
+    for (int i = 0; i < numOfLines; i++) {
+      boxes[i] = SweptBox_make(p1x[i], p1y[i], p2x[i], p2y[i], vx[i], vy[i],
+                               collisionWorld->timeStep);
+    }
+  }
 
-  while (curNode != NULL) {
-    CollisionWorld_collisionSolver(collisionWorld, curNode->l1, curNode->l2,
-                                   curNode->intersectionType);
-    curNode = curNode->next;
+  // Collect the pairs that the broad phase could not rule out.
+  CandidateList* candidates = &collisionWorld->candidates;
+  CandidateList_clear(candidates);
+  bool found = false;
+  if (collisionWorld->usePairCache && broadPhase == BROAD_PHASE_GRID) {
+    // Run the grid only when the cached pairs are out of date.
+    if (collisionWorld->grid == NULL) {
+      collisionWorld->grid = Grid_new();
+    }
+    if (collisionWorld->pairCache == NULL) {
+      collisionWorld->pairCache = PairCache_new();
+    }
+    found = collisionWorld->grid != NULL && collisionWorld->pairCache != NULL
+        && PairCache_findCandidates(collisionWorld->pairCache,
+                                    collisionWorld->grid,
+                                    collisionWorld->boxes, collisionWorld->vx,
+                                    collisionWorld->vy,
+                                    collisionWorld->timeStep, numOfLines,
+                                    candidates);
+  } else {
+    found = CollisionWorld_findCandidates(collisionWorld, broadPhase,
+                                          collisionWorld->boxes, candidates);
+  }
+  const unsigned long long numPairs = found ? candidates->size
+      : (unsigned long long) numOfLines * (numOfLines - 1) / 2;
+  COLLISION_STATS_RECORD(stats, CollisionStats_endPhase, STATS_BROAD_PHASE);
+  COLLISION_STATS_RECORD(stats, CollisionStats_countCandidates, numPairs);
+
+  // Test the pairs in parallel.  Chunks are handed out dynamically, since
+  // the cost of intersect() varies from pair to pair (and, for brute force,
+  // row i holds n - i - 1 pairs).
+  unsigned int numCollisions = 0;
+  #pragma omp parallel reduction(+:numCollisions) \
+      num_threads(useThreadEventLists ? numThreads : 1)
+  {
+    IntersectionEventList* threadEventList = useThreadEventLists
+        ? &threadEventLists[omp_get_thread_num()] : intersectionEventList;
+    if (found) {
+      // The broad phases emit the pairs for one line consecutively, so each
+      // run of pairs sharing a first line is tested a block at a time.
+      const CandidatePair* pairs = candidates->pairs;
+      const int numCandidates = candidates->size;
+      #pragma omp for schedule(dynamic)
+      for (int chunk = 0; chunk < numCandidates;
+           chunk += CANDIDATE_CHUNK_SIZE) {
+        const int end = chunk + CANDIDATE_CHUNK_SIZE < numCandidates
+            ? chunk + CANDIDATE_CHUNK_SIZE : numCandidates;
+        int c = chunk;
+        while (c < end) {
+          int count = 1;
+          while (c + count < end && count < INTERSECT_BLOCK_SIZE
+                 && pairs[c + count].i == pairs[c].i) {
+            count++;
+          }
+          numCollisions += CollisionWorld_testBlock(collisionWorld, &pairs[c],
+                                                    count, threadEventList);
+          c += count;
+        }
+      }
+    } else {
+      // Brute force, or the broad phase ran out of memory.
+      // Test all line-line pairs to see if they will intersect before the
+      // next time step.
+      #pragma omp for schedule(dynamic, 16)
+      for (int i = 0; i < numOfLines; i++) {
+        for (int j = i + 1; j < numOfLines; j++) {
+          numCollisions += CollisionWorld_testPair(collisionWorld, i, j,
+                                                   threadEventList);
+        }
+      }
+    }
+  }
+  collisionWorld->numLineLineCollisions += numCollisions;
+  collisionWorld->numPairsTested += numPairs;
+  if (collisionWorld->broadPhase == BROAD_PHASE_AUTO
+      && collisionWorld->tuner != NULL
+      && BroadPhaseTuner_endFrame(collisionWorld->tuner,
+                                  tdiff(start, gettime()), numPairs,
+                                  collisionWorld->p1x, collisionWorld->p1y,
+                                  collisionWorld->p2x, collisionWorld->p2y,
+                                  collisionWorld->boxes, numOfLines)) {
+    COLLISION_STATS_RECORD(stats, CollisionStats_recordTuning,
+                           collisionWorld->tuner);
+  }
+  COLLISION_STATS_RECORD(stats, CollisionStats_endPhase, STATS_NARROW_PHASE);
+
+  // Gather the events.  Which thread found which event depends on
+  // scheduling, but sorting puts them in (l1 id, l2 id) order regardless, so
+  // the solver sees the same sequence at any thread count.
+  for (int t = 0; useThreadEventLists && t < numThreads; t++) {
+    if (!IntersectionEventList_concat(intersectionEventList,
+                                      &threadEventLists[t])) {
+      CollisionWorld_solveUngathered(collisionWorld, threadEventLists,
+                                     numThreads);
+      return;
+    }
   }
 
-  IntersectionEventList_deleteNodes(&intersectionEventList);
+  // Sort the intersection event list.  No two events have the same key, so
+  // without memory for the radix sort's scratch, sorting in place with qsort
+  // gives the same order.
+  if (intersectionEventList->size > 1) {
+    IntersectionEvent* sortScratch = FrameArena_allocate(
+        &collisionWorld->frameArena,
+        intersectionEventList->size * sizeof(IntersectionEvent));
+    if (sortScratch != NULL) {
+      IntersectionEventList_sort(intersectionEventList, sortScratch);
+    } else {
+      qsort(intersectionEventList->events, intersectionEventList->size,
+            sizeof(IntersectionEvent), CollisionWorld_compareEvents);
+    }
+  }
+  COLLISION_STATS_RECORD(stats, CollisionStats_endPhase, STATS_EVENT_SORT);
+  COLLISION_STATS_RECORD(stats, CollisionStats_countEvents,
+                         intersectionEventList);
+
+  // Call the collision solver for each intersection event, in order, or
+  // batch by batch if there are enough events to share out.
+  unsigned int* batchEvents = NULL;
+  unsigned int* batchStarts = NULL;
+  const unsigned int numBatches =
+      numThreads > 1
+      && intersectionEventList->size >= PARALLEL_SOLVER_MIN_EVENTS
+      ? CollisionWorld_batchEvents(collisionWorld, &batchEvents, &batchStarts)
+      : 0;
+  if (numBatches == 0) {
+    for (unsigned int e = 0; e < intersectionEventList->size; e++) {
+      CollisionWorld_solveEvent(collisionWorld,
+                                &intersectionEventList->events[e]);
+    }
+  } else {
+    const IntersectionEvent* events = intersectionEventList->events;
+    #pragma omp parallel
+    for (unsigned int b = 0; b < numBatches; b++) {
+      // The events of a batch touch disjoint lines; the barrier at the end
+      // of the loop keeps the batches in order.
+      #pragma omp for schedule(static)
+      for (unsigned int e = batchStarts[b]; e < batchStarts[b + 1]; e++) {
+        CollisionWorld_solveEvent(collisionWorld, &events[batchEvents[e]]);
+      }
+    }
+  }
+  COLLISION_STATS_RECORD(stats, CollisionStats_endPhase, STATS_SOLVER);
 }
 
 unsigned int CollisionWorld_getNumLineWallCollisions(
@@ -192,9 +843,16 @@ unsigned int CollisionWorld_getNumLineLineCollisions(
   return collisionWorld->numLineLineCollisions;
 }
 
-void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
-                                    Line *l1, Line *l2,
-                                    IntersectionType intersectionType) {
+unsigned long long CollisionWorld_getNumPairsTested(
+    CollisionWorld* collisionWorld) {
+  return collisionWorld->numPairsTested;
+}
+
+// The collision solver as originally written, computing every length with
+// hypot.  Kept to validate CollisionWorld_collisionSolver against.
+static void CollisionWorld_collisionSolverReference(
+    CollisionWorld* collisionWorld, Line *l1, Line *l2,
+    IntersectionType intersectionType) {
   assert(compareLines(l1, l2) < 0);
   assert(intersectionType == L1_WITH_L2
          || intersectionType == L2_WITH_L1
@@ -267,3 +925,85 @@ void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
 
   return;
 }
+
+// The solver below computes the same velocities as the reference, bit for
+// bit: the collision dynamics are chaotic, so a last-bit change in one
+// velocity (say, from multiplying by a reciprocal length instead of dividing
+// by the length) changes the collision counts a few hundred frames later.
+// It saves work only where that leaves the rounding alone.
+void CollisionWorld_collisionSolver(CollisionWorld* collisionWorld,
+                                    Line *l1, Line *l2,
+                                    IntersectionType intersectionType) {
+  assert(compareLines(l1, l2) < 0);
+  assert(intersectionType == L1_WITH_L2
+         || intersectionType == L2_WITH_L1
+         || intersectionType == ALREADY_INTERSECTED);
+  if (collisionWorld->reference) {
+    CollisionWorld_collisionSolverReference(collisionWorld, l1, l2,
+                                            intersectionType);
+    return;
+  }
+
+  // Despite our efforts to determine whether lines will intersect ahead
+  // of time (and to modify their velocities appropriately), our
+  // simplified model can sometimes cause lines to intersect.  In such a
+  // case, we compute velocities so that the two lines can get unstuck in
+  // the fastest possible way, while still conserving momentum and kinetic
+  // energy.  Each line moves away from the intersection point along itself;
+  // comparing squared distances tells which way without a square root.
+  if (intersectionType == ALREADY_INTERSECTED) {
+    Vec p = getIntersectionPoint(l1->p1, l1->p2, l2->p1, l2->p2);
+
+    Vec a = Vec_subtract(l1->p1, p);
+    Vec b = Vec_subtract(l1->p2, p);
+    l1->velocity = Vec_multiply(
+        Vec_normalize(Vec_dotProduct(a, a) < Vec_dotProduct(b, b) ? b : a),
+        Vec_length(l1->velocity));
+    a = Vec_subtract(l2->p1, p);
+    b = Vec_subtract(l2->p2, p);
+    l2->velocity = Vec_multiply(
+        Vec_normalize(Vec_dotProduct(a, a) < Vec_dotProduct(b, b) ? b : a),
+        Vec_length(l2->velocity));
+    return;
+  }
+
+  // Compute the mass of each line (we simply use its length).
+  Vec v1 = Vec_makeFromLine(*l1);
+  Vec v2 = Vec_makeFromLine(*l2);
+  double m1 = Vec_length(v1);
+  double m2 = Vec_length(v2);
+
+  // Compute the collision face/normal vectors.  The face runs along one of
+  // the lines, so normalizing it reuses that line's mass.
+  Vec face;
+  Vec normal;
+  if (intersectionType == L1_WITH_L2) {
+    face = Vec_divide(v2, m2);
+  } else {
+    face = Vec_divide(v1, m1);
+  }
+  normal = Vec_orthogonal(face);
+
+  // Obtain each line's velocity components with respect to the collision
+  // face/normal vectors.
+  double v1Face = Vec_dotProduct(l1->velocity, face);
+  double v2Face = Vec_dotProduct(l2->velocity, face);
+  double v1Normal = Vec_dotProduct(l1->velocity, normal);
+  double v2Normal = Vec_dotProduct(l2->velocity, normal);
+
+  // Perform the collision calculation (computes the new velocities along
+  // the direction normal to the collision face such that momentum and
+  // kinetic energy are conserved).
+  double newV1Normal = ((m1 - m2) / (m1 + m2)) * v1Normal
+      + (2 * m2 / (m1 + m2)) * v2Normal;
+  double newV2Normal = (2 * m1 / (m1 + m2)) * v1Normal
+      + ((m2 - m1) / (m2 + m1)) * v2Normal;
+
+  // Combine the resulting velocities.
+  l1->velocity = Vec_add(Vec_multiply(normal, newV1Normal),
+                         Vec_multiply(face, v1Face));
+  l2->velocity = Vec_add(Vec_multiply(normal, newV2Normal),
+                         Vec_multiply(face, v2Face));
+
+  return;
+}
@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "frame_arena.h"
+
+#include <stdlib.h>
+
+// Header of a block allocated when the arena's block was full; the memory
+// handed out follows it.
+struct FrameArenaOverflow {
+  struct FrameArenaOverflow* next;
+};
+
+// Rounds size up to a multiple of FRAME_ARENA_ALIGNMENT.
+static size_t FrameArena_align(const size_t size) {
+  return (size + FRAME_ARENA_ALIGNMENT - 1) & ~(size_t) (FRAME_ARENA_ALIGNMENT
+                                                         - 1);
+}
+
+FrameArena FrameArena_make() {
+  FrameArena arena = {
+    .block = NULL, .capacity = 0, .used = 0, .overflow = NULL,
+    .frameBytes = 0, .highWater = 0
+  };
+  return arena;
+}
+
+void* FrameArena_allocate(FrameArena* arena, const size_t size) {
+  const size_t alignedSize = FrameArena_align(size);
+  arena->frameBytes += alignedSize;
+  if (arena->frameBytes > arena->highWater) {
+    arena->highWater = arena->frameBytes;
+  }
+  if (arena->used + alignedSize <= arena->capacity) {
+    void* memory = arena->block + arena->used;
+    arena->used += alignedSize;
+    return memory;
+  }
+
+  // The block is full: allocate this one on its own, with the header in
+  // front of it.
+  const size_t headerSize = FrameArena_align(sizeof(struct FrameArenaOverflow));
+  void* overflowBlock;
+  if (posix_memalign(&overflowBlock, FRAME_ARENA_ALIGNMENT,
+                     headerSize + alignedSize) != 0) {
+    return NULL;
+  }
+  struct FrameArenaOverflow* overflow = overflowBlock;
+  overflow->next = arena->overflow;
+  arena->overflow = overflow;
+  return (char*) overflowBlock + headerSize;
+}
+
+void FrameArena_reset(FrameArena* arena) {
+  arena->used = 0;
+  arena->frameBytes = 0;
+  if (arena->overflow == NULL) {
+    return;
+  }
+
+  // This frame outgrew the block: free the extra blocks, and make the block
+  // large enough for the largest frame so far.  It at least doubles, so that
+  // a frame size creeping up does not reallocate every frame.
+  while (arena->overflow != NULL) {
+    struct FrameArenaOverflow* next = arena->overflow->next;
+    free(arena->overflow);
+    arena->overflow = next;
+  }
+  free(arena->block);
+  const size_t capacity = arena->highWater > 2 * arena->capacity
+                          ? arena->highWater : 2 * arena->capacity;
+  void* block;
+  if (posix_memalign(&block, FRAME_ARENA_ALIGNMENT, capacity) != 0) {
+    arena->block = NULL;
+    arena->capacity = 0;
+    return;
+  }
+  arena->block = block;
+  arena->capacity = capacity;
+}
+
+void FrameArena_delete(FrameArena* arena) {
+  arena->highWater = 0;
+  FrameArena_reset(arena);
+  free(arena->block);
+  *arena = FrameArena_make();
+}
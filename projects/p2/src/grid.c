@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "grid.h"
+
+// Grows *buffer to hold at least capacity elements of elementSize bytes.  It
+// at least doubles, so that a count creeping up from frame to frame does not
+// reallocate every frame.
+static bool Grid_reserve(void** buffer, unsigned int* bufferCapacity,
+                         const unsigned int capacity,
+                         const size_t elementSize) {
+  if (capacity <= *bufferCapacity) {
+    return true;
+  }
+  const unsigned int newCapacity =
+      capacity > 2 * *bufferCapacity ? capacity : 2 * *bufferCapacity;
+  void* newBuffer = realloc(*buffer, (size_t) newCapacity * elementSize);
+  if (newBuffer == NULL) {
+    return false;
+  }
+  *buffer = newBuffer;
+  *bufferCapacity = newCapacity;
+  return true;
+}
+
+// Returns the column (or row) containing coordinate x, clamped to the grid so
+// that lines outside the box land in the cells along its edge.
+static inline unsigned int Grid_cellOf(const Grid* grid, const double x,
+                                       const double origin,
+                                       const double cellSize) {
+  const double c = (x - origin) / cellSize;
+  if (c <= 0) {
+    return 0;
+  }
+  if (c >= grid->resolution) {
+    return grid->resolution - 1;
+  }
+  return (unsigned int) c;
+}
+
+// Picks the resolution for this frame.  Roughly one line per cell keeps the
+// per-cell pair loops short, but cells much smaller than the typical line
+// only make every line land in many cells.
+static void Grid_chooseResolution(Grid* grid, const SweptBox* boxes,
+                                  const unsigned int numOfLines) {
+  double meanExtent = 0;
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    const SweptBox* box = &boxes[i];
+    const double width = box->xmax - box->xmin;
+    const double height = box->ymax - box->ymin;
+    meanExtent += width > height ? width : height;
+  }
+  meanExtent /= numOfLines;
+
+  double resolution = sqrt(numOfLines);
+  const double boxSide = (double) BOX_XMAX - BOX_XMIN;
+  if (meanExtent > 0 && boxSide / meanExtent < resolution) {
+    resolution = boxSide / meanExtent;
+  }
+  resolution *= grid->resolutionScale;
+  if (resolution > GRID_MAX_RESOLUTION) {
+    resolution = GRID_MAX_RESOLUTION;
+  }
+  grid->resolution = resolution < 1 ? 1 : (unsigned int) resolution;
+  grid->cellWidth = ((double) BOX_XMAX - BOX_XMIN) / grid->resolution;
+  grid->cellHeight = ((double) BOX_YMAX - BOX_YMIN) / grid->resolution;
+}
+
+Grid* Grid_new() {
+  Grid* grid = malloc(sizeof(Grid));
+  if (grid == NULL) {
+    return NULL;
+  }
+
+  grid->resolution = 0;
+  grid->cellWidth = 0;
+  grid->cellHeight = 0;
+  grid->resolutionScale = 1;
+  grid->cellStart = NULL;
+  grid->cellStartCapacity = 0;
+  grid->cellLines = NULL;
+  grid->cellLinesCapacity = 0;
+  return grid;
+}
+
+void Grid_delete(Grid* grid) {
+  if (grid == NULL) {
+    return;
+  }
+  free(grid->cellStart);
+  free(grid->cellLines);
+  free(grid);
+}
+
+bool Grid_findCandidates(Grid* grid, const SweptBox* boxes,
+                         const unsigned int numOfLines,
+                         CandidateList* candidates) {
+  if (numOfLines < 2) {
+    grid->resolution = 0;
+    return true;
+  }
+
+  Grid_chooseResolution(grid, boxes, numOfLines);
+  const unsigned int resolution = grid->resolution;
+  const unsigned int numCells = resolution * resolution;
+  if (!Grid_reserve((void**) &grid->cellStart, &grid->cellStartCapacity,
+                    numCells + 1, sizeof(unsigned int))) {
+    return false;
+  }
+  unsigned int* cellStart = grid->cellStart;
+
+  // Bucket the lines into cells with a counting sort: count the lines per
+  // cell, turn the counts into offsets, then place the lines.  Placing the
+  // lines in index order keeps every cell's list sorted.
+  for (unsigned int c = 0; c <= numCells; c++) {
+    cellStart[c] = 0;
+  }
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    const SweptBox* box = &boxes[i];
+    const unsigned int x0 = Grid_cellOf(grid, box->xmin, BOX_XMIN,
+                                        grid->cellWidth);
+    const unsigned int x1 = Grid_cellOf(grid, box->xmax, BOX_XMIN,
+                                        grid->cellWidth);
+    const unsigned int y0 = Grid_cellOf(grid, box->ymin, BOX_YMIN,
+                                        grid->cellHeight);
+    const unsigned int y1 = Grid_cellOf(grid, box->ymax, BOX_YMIN,
+                                        grid->cellHeight);
+    for (unsigned int y = y0; y <= y1; y++) {
+      for (unsigned int x = x0; x <= x1; x++) {
+        cellStart[y * resolution + x + 1]++;
+      }
+    }
+  }
+  for (unsigned int c = 0; c < numCells; c++) {
+    cellStart[c + 1] += cellStart[c];
+  }
+  if (!Grid_reserve((void**) &grid->cellLines, &grid->cellLinesCapacity,
+                    cellStart[numCells], sizeof(unsigned int))) {
+    return false;
+  }
+  unsigned int* cellLines = grid->cellLines;
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    const SweptBox* box = &boxes[i];
+    const unsigned int x0 = Grid_cellOf(grid, box->xmin, BOX_XMIN,
+                                        grid->cellWidth);
+    const unsigned int x1 = Grid_cellOf(grid, box->xmax, BOX_XMIN,
+                                        grid->cellWidth);
+    const unsigned int y0 = Grid_cellOf(grid, box->ymin, BOX_YMIN,
+                                        grid->cellHeight);
+    const unsigned int y1 = Grid_cellOf(grid, box->ymax, BOX_YMIN,
+                                        grid->cellHeight);
+    for (unsigned int y = y0; y <= y1; y++) {
+      for (unsigned int x = x0; x <= x1; x++) {
+        cellLines[cellStart[y * resolution + x]++] = i;
+      }
+    }
+  }
+  // Placing advanced every offset to the start of the next cell; shift them
+  // back.
+  for (unsigned int c = numCells; c > 0; c--) {
+    cellStart[c] = cellStart[c - 1];
+  }
+  cellStart[0] = 0;
+
+  // Test the pairs within every cell.  A pair whose boxes overlap shares
+  // every cell their intersection touches, so only the cell holding the
+  // intersection's lower-left corner reports it.
+  for (unsigned int y = 0; y < resolution; y++) {
+    for (unsigned int x = 0; x < resolution; x++) {
+      const unsigned int c = y * resolution + x;
+      for (unsigned int a = cellStart[c]; a < cellStart[c + 1]; a++) {
+        const unsigned int i = cellLines[a];
+        const SweptBox* boxI = &boxes[i];
+        for (unsigned int b = a + 1; b < cellStart[c + 1]; b++) {
+          const unsigned int j = cellLines[b];
+          const SweptBox* boxJ = &boxes[j];
+          if (!SweptBox_overlap(boxI, boxJ)) {
+            continue;
+          }
+          const double cornerX = boxI->xmin > boxJ->xmin ? boxI->xmin
+                                                          : boxJ->xmin;
+          const double cornerY = boxI->ymin > boxJ->ymin ? boxI->ymin
+                                                          : boxJ->ymin;
+          if (Grid_cellOf(grid, cornerX, BOX_XMIN, grid->cellWidth) != x
+              || Grid_cellOf(grid, cornerY, BOX_YMIN, grid->cellHeight) != y) {
+            continue;
+          }
+          CandidateList_append(candidates, i, j);
+        }
+      }
+    }
+  }
+  return !candidates->overflowed;
+}
+
+void Grid_findOverlaps(const Grid* grid, const SweptBox* boxes,
+                       const SweptBox* box, const unsigned int i,
+                       CandidateList* candidates) {
+  const unsigned int resolution = grid->resolution;
+  if (resolution == 0) {
+    return;
+  }
+  const unsigned int* cellStart = grid->cellStart;
+  const unsigned int* cellLines = grid->cellLines;
+  const unsigned int x0 = Grid_cellOf(grid, box->xmin, BOX_XMIN,
+                                      grid->cellWidth);
+  const unsigned int x1 = Grid_cellOf(grid, box->xmax, BOX_XMIN,
+                                      grid->cellWidth);
+  const unsigned int y0 = Grid_cellOf(grid, box->ymin, BOX_YMIN,
+                                      grid->cellHeight);
+  const unsigned int y1 = Grid_cellOf(grid, box->ymax, BOX_YMIN,
+                                      grid->cellHeight);
+
+  // As in Grid_findCandidates, a line overlapping box in several cells is
+  // reported by the cell holding the lower-left corner of the overlap.
+  for (unsigned int y = y0; y <= y1; y++) {
+    for (unsigned int x = x0; x <= x1; x++) {
+      const unsigned int c = y * resolution + x;
+      for (unsigned int a = cellStart[c]; a < cellStart[c + 1]; a++) {
+        const unsigned int j = cellLines[a];
+        const SweptBox* boxJ = &boxes[j];
+        if (j == i || !SweptBox_overlap(box, boxJ)) {
+          continue;
+        }
+        const double cornerX = box->xmin > boxJ->xmin ? box->xmin
+                                                      : boxJ->xmin;
+        const double cornerY = box->ymin > boxJ->ymin ? box->ymin
+                                                      : boxJ->ymin;
+        if (Grid_cellOf(grid, cornerX, BOX_XMIN, grid->cellWidth) != x
+            || Grid_cellOf(grid, cornerY, BOX_YMIN, grid->cellHeight) != y) {
+          continue;
+        }
+        CandidateList_append(candidates, i, j);
+      }
+    }
+  }
+}
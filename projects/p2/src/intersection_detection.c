@@ -26,8 +26,16 @@
 #include "line.h"
 #include "vec.h"
 
+// Sign of Vec_angle(vector1, vector2), from the angle itself.
+static int compareArgumentsReference(Vec vector1, Vec vector2) {
+  const double angle = Vec_angle(vector1, vector2);
+  return (angle > 0) - (angle < 0);
+}
+
 // Detect if lines l1 and l2 will intersect between now and the next time step.
-IntersectionType intersect(Line *l1, Line *l2, double time) {
+// compareArguments gives the sign of the angle between the lines.
+static inline IntersectionType intersectWith(
+    Line *l1, Line *l2, double time, int (*compareArguments)(Vec, Vec)) {
   assert(compareLines(l1, l2) < 0);
 
   Vec velocity;
@@ -75,7 +83,7 @@ IntersectionType intersect(Line *l1, Line *l2, double time) {
     return NO_INTERSECTION;
   }
 
-  double angle = Vec_angle(v1, v2);
+  int angle = compareArguments(v1, v2);
 
   if (top_intersected) {
     if (angle < 0) {
@@ -96,6 +104,107 @@ IntersectionType intersect(Line *l1, Line *l2, double time) {
   return L1_WITH_L2;
 }
 
+IntersectionType intersect(Line *l1, Line *l2, double time) {
+  return intersectWith(l1, l2, time, Vec_compareArguments);
+}
+
+IntersectionType intersectReference(Line *l1, Line *l2, double time) {
+  return intersectWith(l1, l2, time, compareArgumentsReference);
+}
+
+// The cross products below are the ones intersect() computes, written out so
+// that they round identically: direction(pi, pj, pk) is
+// (pk - pi) x (pj - pi).
+static inline double directionOf(double pix, double piy, double pjx,
+                                 double pjy, double pkx, double pky) {
+  return (pkx - pix) * (pjy - piy) - (pjx - pix) * (pky - piy);
+}
+
+// True if a and b are both nonzero and of opposite sign.
+static inline bool straddles(double a, double b) {
+  return ((a > 0) & (b < 0)) | ((a < 0) & (b > 0));
+}
+
+// Screen line against every line in block.
+//
+// intersect() runs four intersectLines tests of segment l1 against the edges
+// of the parallelogram l2 sweeps relative to l1, then two
+// pointInParallelogram tests that reuse the same cross products.  A pair
+// certainly does not intersect if none of those twelve cross products is zero
+// (so no onSegment test can fire), no edge straddles l1 and vice versa, and
+// at least one endpoint of l1 lies outside the strip between l2 and its
+// swept copy.  The lanes are computed without branches, so the loop
+// vectorizes; only lanes that fail the test need the full classification.
+unsigned int intersectBlock(const Line *line, const LineBlock *block,
+                            double time) {
+  // Stored as doubles rather than bools: GCC will only vectorize the loop
+  // with SSE2 if every lane value is as wide as the coordinates.
+  double mayIntersect[INTERSECT_BLOCK_SIZE];
+
+  for (int k = 0; k < INTERSECT_BLOCK_SIZE; k++) {
+    const double p1x = block->p1x[k];
+    const double p1y = block->p1y[k];
+    const double p2x = block->p2x[k];
+    const double p2y = block->p2y[k];
+    const double vx = block->vx[k];
+    const double vy = block->vy[k];
+
+    // intersect() wants the line with the lower ID as l1.
+    const bool first = line->id < block->id[k];
+    const double ax = first ? line->p1.x : p1x;
+    const double ay = first ? line->p1.y : p1y;
+    const double bx = first ? line->p2.x : p2x;
+    const double by = first ? line->p2.y : p2y;
+    const double v1x = first ? line->velocity.x : vx;
+    const double v1y = first ? line->velocity.y : vy;
+    const double cx = first ? p1x : line->p1.x;
+    const double cy = first ? p1y : line->p1.y;
+    const double dx = first ? p2x : line->p2.x;
+    const double dy = first ? p2y : line->p2.y;
+    const double v2x = first ? vx : line->velocity.x;
+    const double v2y = first ? vy : line->velocity.y;
+
+    // Segment (a, b) is l1; segment (c, d) is l2, and (e, f) is l2 moved by
+    // the relative velocity.
+    const double ex = cx + (v2x - v1x) * time;
+    const double ey = cy + (v2y - v1y) * time;
+    const double fx = dx + (v2x - v1x) * time;
+    const double fy = dy + (v2y - v1y) * time;
+
+    // Which side of l1 each corner of the parallelogram lies on.
+    const double sc = directionOf(ax, ay, bx, by, cx, cy);
+    const double sd = directionOf(ax, ay, bx, by, dx, dy);
+    const double se = directionOf(ax, ay, bx, by, ex, ey);
+    const double sf = directionOf(ax, ay, bx, by, fx, fy);
+
+    // Which side of each edge the endpoints of l1 lie on.
+    const double cdA = directionOf(cx, cy, dx, dy, ax, ay);
+    const double cdB = directionOf(cx, cy, dx, dy, bx, by);
+    const double efA = directionOf(ex, ey, fx, fy, ax, ay);
+    const double efB = directionOf(ex, ey, fx, fy, bx, by);
+    const double ecA = directionOf(ex, ey, cx, cy, ax, ay);
+    const double ecB = directionOf(ex, ey, cx, cy, bx, by);
+    const double fdA = directionOf(fx, fy, dx, dy, ax, ay);
+    const double fdB = directionOf(fx, fy, dx, dy, bx, by);
+
+    const bool anyZero = (sc == 0) | (sd == 0) | (se == 0) | (sf == 0)
+        | (cdA == 0) | (cdB == 0) | (efA == 0) | (efB == 0)
+        | (ecA == 0) | (ecB == 0) | (fdA == 0) | (fdB == 0);
+    const bool crosses = (straddles(cdA, cdB) & straddles(sc, sd))
+        | (straddles(efA, efB) & straddles(se, sf))
+        | (straddles(ecA, ecB) & straddles(se, sc))
+        | (straddles(fdA, fdB) & straddles(sf, sd));
+    const bool inside = straddles(cdA, efA) & straddles(cdB, efB);
+    mayIntersect[k] = (anyZero | crosses | inside) ? 1.0 : 0.0;
+  }
+
+  unsigned int mask = 0;
+  for (int k = 0; k < INTERSECT_BLOCK_SIZE; k++) {
+    mask |= (unsigned int) (mayIntersect[k] != 0) << k;
+  }
+  return mask;
+}
+
 // Check if a point is in the parallelogram.
 bool pointInParallelogram(Vec point, Vec p1, Vec p2, Vec p3, Vec p4) {
   double d1 = direction(p1, p2, point);
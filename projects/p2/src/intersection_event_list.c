@@ -20,19 +20,26 @@
  * SOFTWARE.
  **/
 
+
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "intersection_event_list.h"
 
-int IntersectionEventNode_compareData(IntersectionEventNode* node1,
-                                      IntersectionEventNode* node2) {
-  if (compareLines(node1->l1, node2->l1) < 0) {
+// The radix sort consumes the 64-bit key one byte at a time.
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+
+int IntersectionEvent_compareData(const IntersectionEvent* event1,
+                                  const IntersectionEvent* event2) {
+  if (event1->id1 < event2->id1) {
     return -1;
-  } else if (compareLines(node1->l1, node2->l1) == 0) {
-    if (compareLines(node1->l2, node2->l2) < 0) {
+  } else if (event1->id1 == event2->id1) {
+    if (event1->id2 < event2->id2) {
       return -1;
-    } else if (compareLines(node1->l2, node2->l2) == 0) {
+    } else if (event1->id2 == event2->id2) {
       return 0;
     } else {
       return 1;
@@ -42,63 +49,113 @@ int IntersectionEventNode_compareData(IntersectionEventNode* node1,
   }
 }
 
-void IntersectionEventNode_swapData(IntersectionEventNode* node1,
-                                    IntersectionEventNode* node2) {
-  {
-    Line* temp = node1->l1;
-    node1->l1 = node2->l1;
-    node2->l1 = temp;
-  }
-  {
-    Line* temp = node1->l2;
-    node1->l2 = node2->l2;
-    node2->l2 = temp;
-  }
-  {
-    IntersectionType temp = node1->intersectionType;
-    node1->intersectionType = node2->intersectionType;
-    node2->intersectionType = temp;
-  }
-}
-
 IntersectionEventList IntersectionEventList_make() {
   IntersectionEventList intersectionEventList;
-  intersectionEventList.head = NULL;
-  intersectionEventList.tail = NULL;
+  intersectionEventList.events = NULL;
+  intersectionEventList.size = 0;
+  intersectionEventList.capacity = 0;
   return intersectionEventList;
 }
 
-void IntersectionEventList_appendNode(
-    IntersectionEventList* intersectionEventList, Line* l1, Line* l2,
-    IntersectionType intersectionType) {
-  assert(compareLines(l1, l2) < 0);
+bool IntersectionEventList_reserve(
+    IntersectionEventList* intersectionEventList,
+    const unsigned int capacity) {
+  if (capacity <= intersectionEventList->capacity) {
+    return true;
+  }
+  IntersectionEvent* events = realloc(intersectionEventList->events,
+                                      capacity * sizeof(IntersectionEvent));
+  if (events == NULL) {
+    return false;
+  }
+  intersectionEventList->events = events;
+  intersectionEventList->capacity = capacity;
+  return true;
+}
+
+bool IntersectionEventList_concat(
+    IntersectionEventList* intersectionEventList,
+    IntersectionEventList* other) {
+  if (other->size == 0) {
+    return true;
+  }
+  const unsigned int size = intersectionEventList->size + other->size;
+  const unsigned int capacity = intersectionEventList->capacity;
+  if (size > capacity
+      && !IntersectionEventList_reserve(
+          intersectionEventList, size > 2 * capacity ? size : 2 * capacity)) {
+    return false;
+  }
+  memcpy(intersectionEventList->events + intersectionEventList->size,
+         other->events, other->size * sizeof(IntersectionEvent));
+  intersectionEventList->size = size;
+  other->size = 0;
+  return true;
+}
 
-  IntersectionEventNode* newNode = malloc(sizeof(IntersectionEventNode));
-  if (newNode == NULL) {
+void IntersectionEventList_sort(IntersectionEventList* intersectionEventList,
+                                IntersectionEvent* scratch) {
+  const unsigned int size = intersectionEventList->size;
+  if (size < 2) {
     return;
   }
 
-  newNode->l1 = l1;
-  newNode->l2 = l2;
-  newNode->intersectionType = intersectionType;
-  newNode->next = NULL;
-  if (intersectionEventList->head == NULL) {
-    intersectionEventList->head = newNode;
-  } else {
-    intersectionEventList->tail->next = newNode;
+  // Histogram every byte of the key in a single pass.
+  unsigned int counts[RADIX_PASSES][RADIX_BUCKETS];
+  memset(counts, 0, sizeof(counts));
+  IntersectionEvent* events = intersectionEventList->events;
+  for (unsigned int i = 0; i < size; i++) {
+    const uint64_t key = IntersectionEvent_key(&events[i]);
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+      counts[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+  }
+
+  // Stable counting sort by each byte, least significant first.  A byte that
+  // is the same in every key (such as the high bytes of IDs when there are
+  // fewer than 2^24 lines) does not reorder anything, so skip its pass.
+  for (int pass = 0; pass < RADIX_PASSES; pass++) {
+    const int shift = pass * RADIX_BITS;
+    unsigned int* count = counts[pass];
+    const uint64_t firstKey = IntersectionEvent_key(&events[0]);
+    if (count[(firstKey >> shift) & (RADIX_BUCKETS - 1)] == size) {
+      continue;
+    }
+
+    unsigned int offset = 0;
+    for (int b = 0; b < RADIX_BUCKETS; b++) {
+      const unsigned int bucketSize = count[b];
+      count[b] = offset;
+      offset += bucketSize;
+    }
+    for (unsigned int i = 0; i < size; i++) {
+      const uint64_t key = IntersectionEvent_key(&events[i]);
+      scratch[count[(key >> shift) & (RADIX_BUCKETS - 1)]++] = events[i];
+    }
+    IntersectionEvent* temp = events;
+    events = scratch;
+    scratch = temp;
+  }
+  // After an odd number of passes the events are in scratch; copy them back.
+  if (events != intersectionEventList->events) {
+    memcpy(intersectionEventList->events, events,
+           size * sizeof(IntersectionEvent));
+    events = intersectionEventList->events;
+  }
+
+#ifndef NDEBUG
+  for (unsigned int i = 1; i < size; i++) {
+    assert(IntersectionEvent_compareData(&events[i - 1], &events[i]) <= 0);
   }
-  intersectionEventList->tail = newNode;
+#endif
 }
 
-void IntersectionEventList_deleteNodes(
+void IntersectionEventList_clear(IntersectionEventList* intersectionEventList) {
+  intersectionEventList->size = 0;
+}
+
+void IntersectionEventList_delete(
     IntersectionEventList* intersectionEventList) {
-  IntersectionEventNode* curNode = intersectionEventList->head;
-  IntersectionEventNode* nextNode = NULL;
-  while (curNode != NULL) {
-    nextNode = curNode->next;
-    free(curNode);
-    curNode = nextNode;
-  }
-  intersectionEventList->head = NULL;
-  intersectionEventList->tail = NULL;
+  free(intersectionEventList->events);
+  *intersectionEventList = IntersectionEventList_make();
 }
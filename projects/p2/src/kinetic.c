@@ -0,0 +1,327 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "kinetic.h"
+#include "line.h"
+
+// Returns how many frames a gap closing by closing per frame stays open for,
+// at most KINETIC_HORIZON_FRAMES.  Rounds down, and treats a gap within
+// KINETIC_SLACK of closing as closed.
+static inline unsigned int Kinetic_framesToClose(const double gap,
+                                                 const double closing) {
+  const double openGap = gap - KINETIC_SLACK;
+  if (!(openGap > 0)) {
+    return 0;
+  }
+  const double frames = openGap / closing;
+  return frames < KINETIC_HORIZON_FRAMES ? (unsigned int) frames
+                                         : KINETIC_HORIZON_FRAMES;
+}
+
+// Returns how many frames, starting with the current one, lines with swept
+// boxes a and b and relative velocity (dvx, dvy) certainly cannot intersect
+// on, at most KINETIC_HORIZON_FRAMES.  intersect() only reports pairs whose
+// swept boxes overlap, and while the velocities hold, the boxes move by the
+// velocity every frame, so it is enough that the boxes stay apart along
+// either axis.
+static unsigned int Kinetic_pairFrames(const SweptBox* a, const SweptBox* b,
+                                       const double dvx, const double dvy,
+                                       const double timeStep) {
+  const double gapX = b->xmin - a->xmax > a->xmin - b->xmax
+                      ? b->xmin - a->xmax : a->xmin - b->xmax;
+  const double gapY = b->ymin - a->ymax > a->ymin - b->ymax
+                      ? b->ymin - a->ymax : a->ymin - b->ymax;
+  const unsigned int framesX = Kinetic_framesToClose(gapX,
+                                                     fabs(dvx) * timeStep);
+  const unsigned int framesY = Kinetic_framesToClose(gapY,
+                                                     fabs(dvy) * timeStep);
+  return framesX > framesY ? framesX : framesY;
+}
+
+// Returns how many frames, starting with the current one, a line with swept
+// box box and velocity (vx, vy) certainly cannot hit a wall on, at most
+// KINETIC_HORIZON_FRAMES.  A frame's wall check sees the line where the far
+// side of its box is, so it is enough that the box stays inside the walls it
+// moves toward.
+static unsigned int Kinetic_wallFrames(const SweptBox* box, const double vx,
+                                       const double vy,
+                                       const double timeStep) {
+  const double gapX = vx > 0 ? BOX_XMAX - box->xmax : box->xmin - BOX_XMIN;
+  const double gapY = vy > 0 ? BOX_YMAX - box->ymax : box->ymin - BOX_YMIN;
+  const unsigned int framesX = Kinetic_framesToClose(gapX, fabs(vx) * timeStep);
+  const unsigned int framesY = Kinetic_framesToClose(gapY, fabs(vy) * timeStep);
+  return framesX < framesY ? framesX : framesY;
+}
+
+// Restores the heap property below event e, which may be later than its
+// children.
+static void Kinetic_siftDown(KineticEvent* events,
+                             const unsigned int numEvents, unsigned int e) {
+  const KineticEvent event = events[e];
+  while (2 * e + 1 < numEvents) {
+    unsigned int child = 2 * e + 1;
+    if (child + 1 < numEvents
+        && events[child + 1].frame < events[child].frame) {
+      child++;
+    }
+    if (event.frame <= events[child].frame) {
+      break;
+    }
+    events[e] = events[child];
+    e = child;
+  }
+  events[e] = event;
+}
+
+// Adds an event to the heap, which must have room for it.
+static void Kinetic_push(Kinetic* kinetic, const KineticEvent event) {
+  KineticEvent* events = kinetic->events;
+  unsigned int e = kinetic->numEvents++;
+  while (e > 0 && event.frame < events[(e - 1) / 2].frame) {
+    events[e] = events[(e - 1) / 2];
+    e = (e - 1) / 2;
+  }
+  events[e] = event;
+}
+
+// Removes and returns the earliest event.
+static KineticEvent Kinetic_pop(Kinetic* kinetic) {
+  KineticEvent* events = kinetic->events;
+  const KineticEvent event = events[0];
+  events[0] = events[--kinetic->numEvents];
+  Kinetic_siftDown(events, kinetic->numEvents, 0);
+  return event;
+}
+
+Kinetic* Kinetic_new() {
+  Kinetic* kinetic = malloc(sizeof(Kinetic));
+  if (kinetic == NULL) {
+    return NULL;
+  }
+
+  kinetic->events = NULL;
+  kinetic->numEvents = 0;
+  kinetic->eventsCapacity = 0;
+  kinetic->rescanFrame = 0;
+  kinetic->boxes = NULL;
+  kinetic->fatBoxes = NULL;
+  kinetic->capacity = 0;
+  kinetic->grid = Grid_new();
+  kinetic->pairs = CandidateList_make();
+  kinetic->numOfLines = 0;
+  kinetic->steppedUntil = 0;
+  kinetic->backoff = 1;
+  kinetic->numQuietFrames = 0;
+  if (kinetic->grid == NULL) {
+    Kinetic_delete(kinetic);
+    return NULL;
+  }
+  return kinetic;
+}
+
+void Kinetic_delete(Kinetic* kinetic) {
+  if (kinetic == NULL) {
+    return;
+  }
+  free(kinetic->events);
+  free(kinetic->boxes);
+  free(kinetic->fatBoxes);
+  Grid_delete(kinetic->grid);
+  CandidateList_delete(&kinetic->pairs);
+  free(kinetic);
+}
+
+void Kinetic_invalidate(Kinetic* kinetic) {
+  kinetic->numEvents = 0;
+}
+
+// Recomputes every event from the lines as they are at the start of frame.
+// Returns false if memory ran out.
+static bool Kinetic_rescan(Kinetic* kinetic, const double* p1x,
+                           const double* p1y, const double* p2x,
+                           const double* p2y, const double* vx,
+                           const double* vy, const double timeStep,
+                           const unsigned int numOfLines,
+                           const unsigned int frame) {
+  kinetic->numEvents = 0;
+  if (numOfLines > kinetic->capacity) {
+    free(kinetic->boxes);
+    free(kinetic->fatBoxes);
+    kinetic->boxes = malloc(numOfLines * sizeof(SweptBox));
+    kinetic->fatBoxes = malloc(numOfLines * sizeof(SweptBox));
+    if (kinetic->boxes == NULL || kinetic->fatBoxes == NULL) {
+      kinetic->capacity = 0;
+      return false;
+    }
+    kinetic->capacity = numOfLines;
+  }
+
+  // Find the pairs whose boxes might meet within the horizon: each box,
+  // stretched by the distance its line covers in that time, contains all of
+  // the line's boxes until then.
+  SweptBox* boxes = kinetic->boxes;
+  SweptBox* fatBoxes = kinetic->fatBoxes;
+  const double horizon = KINETIC_HORIZON_FRAMES * timeStep;
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    boxes[i] = SweptBox_make(p1x[i], p1y[i], p2x[i], p2y[i], vx[i], vy[i],
+                             timeStep);
+    const double dx = vx[i] * horizon;
+    const double dy = vy[i] * horizon;
+    fatBoxes[i].xmin = (dx < 0 ? boxes[i].xmin + dx : boxes[i].xmin)
+                       - KINETIC_SLACK;
+    fatBoxes[i].xmax = (dx > 0 ? boxes[i].xmax + dx : boxes[i].xmax)
+                       + KINETIC_SLACK;
+    fatBoxes[i].ymin = (dy < 0 ? boxes[i].ymin + dy : boxes[i].ymin)
+                       - KINETIC_SLACK;
+    fatBoxes[i].ymax = (dy > 0 ? boxes[i].ymax + dy : boxes[i].ymax)
+                       + KINETIC_SLACK;
+  }
+  CandidateList* pairs = &kinetic->pairs;
+  CandidateList_clear(pairs);
+  if (!Grid_findCandidates(kinetic->grid, fatBoxes, numOfLines, pairs)) {
+    return false;
+  }
+
+  const unsigned int numEvents = pairs->size + numOfLines + 1;
+  if (numEvents > kinetic->eventsCapacity) {
+    const unsigned int capacity = numEvents > 2 * kinetic->eventsCapacity
+                                  ? numEvents : 2 * kinetic->eventsCapacity;
+    KineticEvent* events = realloc(kinetic->events,
+                                   capacity * sizeof(KineticEvent));
+    if (events == NULL) {
+      return false;
+    }
+    kinetic->events = events;
+    kinetic->eventsCapacity = capacity;
+  }
+
+  // Gather the events that fall before the next rescan, then heapify them.
+  KineticEvent* events = kinetic->events;
+  unsigned int size = 0;
+  kinetic->rescanFrame = frame + KINETIC_HORIZON_FRAMES;
+  events[size++] = (KineticEvent) {
+    .frame = kinetic->rescanFrame, .i = KINETIC_RESCAN, .j = KINETIC_RESCAN
+  };
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    const unsigned int frames = Kinetic_wallFrames(&boxes[i], vx[i], vy[i],
+                                                   timeStep);
+    if (frames < KINETIC_HORIZON_FRAMES) {
+      events[size++] = (KineticEvent) {
+        .frame = frame + frames, .i = i, .j = KINETIC_WALL
+      };
+    }
+  }
+  for (unsigned int p = 0; p < pairs->size; p++) {
+    const unsigned int i = pairs->pairs[p].i;
+    const unsigned int j = pairs->pairs[p].j;
+    const unsigned int frames = Kinetic_pairFrames(&boxes[i], &boxes[j],
+                                                   vx[i] - vx[j],
+                                                   vy[i] - vy[j], timeStep);
+    if (frames < KINETIC_HORIZON_FRAMES) {
+      events[size++] = (KineticEvent) {
+        .frame = frame + frames, .i = i, .j = j
+      };
+    }
+  }
+  for (unsigned int e = size / 2; e-- > 0;) {
+    Kinetic_siftDown(events, size, e);
+  }
+  kinetic->numEvents = size;
+  kinetic->numOfLines = numOfLines;
+  return true;
+}
+
+bool Kinetic_isQuiet(Kinetic* kinetic, const double* p1x, const double* p1y,
+                     const double* p2x, const double* p2y, const double* vx,
+                     const double* vy, const double timeStep,
+                     const unsigned int numOfLines, const unsigned int frame) {
+  // Out-of-date events are recomputed from scratch, unless the scene has
+  // lately been too busy for that to pay.
+  const bool rescanned = kinetic->numEvents == 0
+                         || kinetic->numOfLines != numOfLines;
+  if (rescanned) {
+    if (frame < kinetic->steppedUntil) {
+      return false;
+    }
+    if (!Kinetic_rescan(kinetic, p1x, p1y, p2x, p2y, vx, vy, timeStep,
+                        numOfLines, frame)) {
+      kinetic->numEvents = 0;
+      return false;
+    }
+  }
+
+  // Recompute each event due on this frame from the lines' current boxes.
+  // An event that is still due makes the frame busy, and is checked again
+  // on the next.
+  bool quiet = true;
+  while (kinetic->numEvents > 0 && kinetic->events[0].frame <= frame) {
+    const KineticEvent event = Kinetic_pop(kinetic);
+    if (event.i == KINETIC_RESCAN) {
+      if (!Kinetic_rescan(kinetic, p1x, p1y, p2x, p2y, vx, vy, timeStep,
+                          numOfLines, frame)) {
+        kinetic->numEvents = 0;
+        return false;
+      }
+      continue;
+    }
+
+    const unsigned int i = event.i;
+    const SweptBox boxI = SweptBox_make(p1x[i], p1y[i], p2x[i], p2y[i],
+                                        vx[i], vy[i], timeStep);
+    unsigned int frames;
+    if (event.j == KINETIC_WALL) {
+      frames = Kinetic_wallFrames(&boxI, vx[i], vy[i], timeStep);
+    } else {
+      const unsigned int j = event.j;
+      const SweptBox boxJ = SweptBox_make(p1x[j], p1y[j], p2x[j], p2y[j],
+                                          vx[j], vy[j], timeStep);
+      frames = Kinetic_pairFrames(&boxI, &boxJ, vx[i] - vx[j], vy[i] - vy[j],
+                                  timeStep);
+    }
+    if (frames == 0) {
+      quiet = false;
+      frames = 1;
+    }
+    if (frame + frames < kinetic->rescanFrame) {
+      Kinetic_push(kinetic, (KineticEvent) {
+        .frame = frame + frames, .i = event.i, .j = event.j
+      });
+    }
+  }
+
+  // If recomputing after a collision found the very next frame busy, put off
+  // doing so again for longer and longer.
+  if (rescanned) {
+    if (quiet) {
+      kinetic->backoff = 1;
+    } else {
+      kinetic->steppedUntil = frame + kinetic->backoff;
+      kinetic->backoff = 2 * kinetic->backoff < KINETIC_MAX_BACKOFF
+                         ? 2 * kinetic->backoff : KINETIC_MAX_BACKOFF;
+    }
+  }
+  kinetic->numQuietFrames += quiet;
+  return quiet;
+}
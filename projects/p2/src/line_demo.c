@@ -29,12 +29,7 @@
 // #include "graphic_stuff.h"
 #include "line.h"
 #include "line_demo.h"
-
-static char* LineDemo_input_file_path;
-
-void LineDemo_setInputFile(char* input_file_path) {
-  LineDemo_input_file_path = input_file_path;
-}
+#include "scene.h"
 
 LineDemo* LineDemo_new() {
   LineDemo* lineDemo = malloc(sizeof(LineDemo));
@@ -42,9 +37,15 @@ LineDemo* LineDemo_new() {
     return NULL;
   }
 
+  lineDemo->inputFilePath = NULL;
   lineDemo->count = 0;
   lineDemo->numFrames = 0;
   lineDemo->collisionWorld = NULL;
+  lineDemo->broadPhase = BROAD_PHASE_GRID;
+  lineDemo->reference = false;
+  lineDemo->usePairCache = true;
+  lineDemo->useKinetic = false;
+  lineDemo->stats = NULL;
   return lineDemo;
 }
 
@@ -53,8 +54,9 @@ void LineDemo_delete(LineDemo* lineDemo) {
   free(lineDemo);
 }
 
-// Read in lines from line.in and add them into collision world for simulation.
-void LineDemo_createLines(LineDemo* lineDemo) {
+// Read in lines from a text (.in) file and add them into a new collision world.
+// Returns NULL, after printing a message, if the file cannot be read.
+static CollisionWorld* LineDemo_readText(const char* path) {
   unsigned int lineId = 0;
   unsigned int numOfLines;
   window_dimension px1;
@@ -65,49 +67,159 @@ void LineDemo_createLines(LineDemo* lineDemo) {
   window_dimension vy;
   int isGray;
   FILE *fin;
-  fin = fopen(LineDemo_input_file_path, "r");
+  fin = fopen(path, "r");
   if (fin == NULL) {
-    fprintf(stderr, "Input file not found (%s)\n", LineDemo_input_file_path);
-    exit(1);
+    fprintf(stderr, "Input file not found (%s)\n", path);
+    return NULL;
   }
 
-  fscanf(fin, "%d\n", &numOfLines);
-  lineDemo->collisionWorld = CollisionWorld_new(numOfLines);
+  if (fscanf(fin, "%u\n", &numOfLines) != 1 || numOfLines == 0) {
+    fprintf(stderr, "Missing line count (%s)\n", path);
+    fclose(fin);
+    return NULL;
+  }
+  CollisionWorld* collisionWorld = CollisionWorld_new(numOfLines);
+  if (collisionWorld == NULL) {
+    fprintf(stderr, "Out of memory loading %u lines (%s)\n", numOfLines, path);
+    fclose(fin);
+    return NULL;
+  }
 
+  int numRead;
   while (EOF
-      != fscanf(fin, "(%lf, %lf), (%lf, %lf), %lf, %lf, %d\n", &px1, &py1, &px2,
-                &py2, &vx, &vy, &isGray)) {
-    Line *line = malloc(sizeof(Line));
+      != (numRead = fscanf(fin, "(%lf, %lf), (%lf, %lf), %lf, %lf, %d\n",
+                           &px1, &py1, &px2, &py2, &vx, &vy, &isGray))) {
+    const bool valid = numRead == 7 && (isGray == RED || isGray == GRAY);
+    if (!valid || lineId == numOfLines) {
+      // The line count is on line 1 of the file.
+      if (!valid) {
+        fprintf(stderr, "%s:%u: expected (x1, y1), (x2, y2), vx, vy, color\n",
+                path, lineId + 2);
+      } else {
+        fprintf(stderr, "%s:%u: more than the %u lines declared\n", path,
+                lineId + 2, numOfLines);
+      }
+      CollisionWorld_delete(collisionWorld);
+      fclose(fin);
+      return NULL;
+    }
+    Line line;
 
     // convert window coordinates to box coordinates
-    windowToBox(&line->p1.x, &line->p1.y, px1, py1);
-    windowToBox(&line->p2.x, &line->p2.y, px2, py2);
+    windowToBox(&line.p1.x, &line.p1.y, px1, py1);
+    windowToBox(&line.p2.x, &line.p2.y, px2, py2);
 
     // convert window velocity to box velocity
-    velocityWindowToBox(&line->velocity.x, &line->velocity.y, vx, vy);
+    velocityWindowToBox(&line.velocity.x, &line.velocity.y, vx, vy);
 
     // store color
-    line->color = (Color) isGray;
+    line.color = (Color) isGray;
 
     // store line ID
-    line->id = lineId;
+    line.id = lineId;
     lineId++;
 
-    // transfer ownership of line to collisionWorld
-    CollisionWorld_addLine(lineDemo->collisionWorld, line);
+    // copy line into collisionWorld
+    CollisionWorld_addLine(collisionWorld, &line);
   }
   fclose(fin);
+  return collisionWorld;
+}
+
+// Read in lines from the input file, which may be a text or a binary scene
+// file, and add them into collision world for simulation.  A checkpoint
+// resumes the simulation it was saved from.
+bool LineDemo_createLines(LineDemo* lineDemo) {
+  if (Scene_isCheckpoint(lineDemo->inputFilePath)) {
+    lineDemo->collisionWorld = CollisionWorld_load(lineDemo->inputFilePath);
+    if (lineDemo->collisionWorld == NULL) {
+      return false;
+    }
+    lineDemo->count = lineDemo->collisionWorld->frame;
+  } else if (Scene_isBinary(lineDemo->inputFilePath)) {
+    lineDemo->collisionWorld = Scene_readBinary(lineDemo->inputFilePath);
+  } else {
+    lineDemo->collisionWorld = LineDemo_readText(lineDemo->inputFilePath);
+  }
+  if (lineDemo->collisionWorld == NULL) {
+    return false;
+  }
+  CollisionWorld_setBroadPhase(lineDemo->collisionWorld, lineDemo->broadPhase);
+  CollisionWorld_setReference(lineDemo->collisionWorld, lineDemo->reference);
+  CollisionWorld_setPairCache(lineDemo->collisionWorld,
+                              lineDemo->usePairCache);
+  CollisionWorld_setKinetic(lineDemo->collisionWorld, lineDemo->useKinetic);
+  CollisionWorld_setStats(lineDemo->collisionWorld, lineDemo->stats);
+  return true;
+}
+
+void LineDemo_setInputFile(LineDemo* lineDemo, const char* inputFilePath) {
+  lineDemo->inputFilePath = inputFilePath;
+}
+
+bool LineDemo_writeScene(LineDemo* lineDemo, const char* path) {
+  return Scene_writeBinary(path, lineDemo->collisionWorld);
+}
+
+bool LineDemo_saveCheckpoint(LineDemo* lineDemo, const char* path) {
+  return CollisionWorld_save(lineDemo->collisionWorld, path);
+}
+
+bool LineDemo_render(LineDemo* lineDemo, Raster* raster, const char* path) {
+  const CollisionWorld* collisionWorld = lineDemo->collisionWorld;
+  if (!Raster_draw(raster, collisionWorld->p1x, collisionWorld->p1y,
+                   collisionWorld->p2x, collisionWorld->p2y,
+                   collisionWorld->color, collisionWorld->numOfLines)) {
+    fprintf(stderr, "Out of memory rendering frame %u\n", lineDemo->count);
+    return false;
+  }
+  return Raster_writePpm(raster, path);
+}
+
+void LineDemo_setBroadPhase(LineDemo* lineDemo, const BroadPhase broadPhase) {
+  lineDemo->broadPhase = broadPhase;
+  if (lineDemo->collisionWorld != NULL) {
+    CollisionWorld_setBroadPhase(lineDemo->collisionWorld, broadPhase);
+  }
+}
+
+void LineDemo_setPairCache(LineDemo* lineDemo, const bool usePairCache) {
+  lineDemo->usePairCache = usePairCache;
+  if (lineDemo->collisionWorld != NULL) {
+    CollisionWorld_setPairCache(lineDemo->collisionWorld, usePairCache);
+  }
+}
+
+void LineDemo_setKinetic(LineDemo* lineDemo, const bool useKinetic) {
+  lineDemo->useKinetic = useKinetic;
+  if (lineDemo->collisionWorld != NULL) {
+    CollisionWorld_setKinetic(lineDemo->collisionWorld, useKinetic);
+  }
+}
+
+void LineDemo_setStats(LineDemo* lineDemo, CollisionStats* stats) {
+  lineDemo->stats = stats;
+  if (lineDemo->collisionWorld != NULL) {
+    CollisionWorld_setStats(lineDemo->collisionWorld, stats);
+  }
+}
+
+void LineDemo_setReference(LineDemo* lineDemo, const bool reference) {
+  lineDemo->reference = reference;
+  if (lineDemo->collisionWorld != NULL) {
+    CollisionWorld_setReference(lineDemo->collisionWorld, reference);
+  }
 }
 
 void LineDemo_setNumFrames(LineDemo* lineDemo, const unsigned int numFrames) {
   lineDemo->numFrames = numFrames;
 }
 
-void LineDemo_initLine(LineDemo* lineDemo) {
-  LineDemo_createLines(lineDemo);
+bool LineDemo_initLine(LineDemo* lineDemo) {
+  return LineDemo_createLines(lineDemo);
 }
 
-Line* LineDemo_getLine(LineDemo* lineDemo, const unsigned int index) {
+Line LineDemo_getLine(LineDemo* lineDemo, const unsigned int index) {
   return CollisionWorld_getLine(lineDemo->collisionWorld, index);
 }
 
@@ -123,6 +235,14 @@ unsigned int LineDemo_getNumLineLineCollisions(LineDemo* lineDemo) {
   return CollisionWorld_getNumLineLineCollisions(lineDemo->collisionWorld);
 }
 
+unsigned long long LineDemo_getNumPairsTested(LineDemo* lineDemo) {
+  return CollisionWorld_getNumPairsTested(lineDemo->collisionWorld);
+}
+
+unsigned long long LineDemo_getNumQuietFrames(LineDemo* lineDemo) {
+  return CollisionWorld_getNumQuietFrames(lineDemo->collisionWorld);
+}
+
 // The main simulation loop
 bool LineDemo_update(LineDemo* lineDemo) {
   lineDemo->count++;
@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pair_cache.h"
+
+PairCache* PairCache_new() {
+  PairCache* pairCache = malloc(sizeof(PairCache));
+  if (pairCache == NULL) {
+    return NULL;
+  }
+
+  pairCache->fatBoxes = NULL;
+  pairCache->builtBoxes = NULL;
+  pairCache->escaped = NULL;
+  pairCache->escapedLines = NULL;
+  pairCache->moved = NULL;
+  pairCache->movedLines = NULL;
+  pairCache->numMoved = 0;
+  pairCache->movedBoxes = NULL;
+  pairCache->movedGrid = Grid_new();
+  pairCache->movedPairs = CandidateList_make();
+  pairCache->capacity = 0;
+  pairCache->numOfLines = 0;
+  pairCache->pairs = CandidateList_make();
+  if (pairCache->movedGrid == NULL) {
+    free(pairCache);
+    return NULL;
+  }
+  return pairCache;
+}
+
+void PairCache_delete(PairCache* pairCache) {
+  if (pairCache == NULL) {
+    return;
+  }
+  free(pairCache->fatBoxes);
+  free(pairCache->builtBoxes);
+  free(pairCache->escaped);
+  free(pairCache->escapedLines);
+  free(pairCache->moved);
+  free(pairCache->movedLines);
+  free(pairCache->movedBoxes);
+  Grid_delete(pairCache->movedGrid);
+  CandidateList_delete(&pairCache->movedPairs);
+  CandidateList_delete(&pairCache->pairs);
+  free(pairCache);
+}
+
+void PairCache_invalidate(PairCache* pairCache) {
+  pairCache->numOfLines = 0;
+  CandidateList_clear(&pairCache->pairs);
+}
+
+// Grows the per-line arrays to hold numOfLines lines.  The flag arrays come
+// back cleared.
+static bool PairCache_reserve(PairCache* pairCache,
+                              const unsigned int numOfLines) {
+  if (numOfLines > pairCache->capacity) {
+    free(pairCache->fatBoxes);
+    free(pairCache->builtBoxes);
+    free(pairCache->escaped);
+    free(pairCache->escapedLines);
+    free(pairCache->moved);
+    free(pairCache->movedLines);
+    free(pairCache->movedBoxes);
+    pairCache->fatBoxes = malloc(numOfLines * sizeof(SweptBox));
+    pairCache->builtBoxes = malloc(numOfLines * sizeof(SweptBox));
+    pairCache->escaped = malloc(numOfLines * sizeof(unsigned char));
+    pairCache->escapedLines = malloc(numOfLines * sizeof(unsigned int));
+    pairCache->moved = malloc(numOfLines * sizeof(unsigned char));
+    pairCache->movedLines = malloc(numOfLines * sizeof(unsigned int));
+    pairCache->movedBoxes = malloc(numOfLines * sizeof(SweptBox));
+    pairCache->capacity = numOfLines;
+    if (pairCache->fatBoxes == NULL || pairCache->builtBoxes == NULL
+        || pairCache->escaped == NULL || pairCache->escapedLines == NULL
+        || pairCache->moved == NULL || pairCache->movedLines == NULL
+        || pairCache->movedBoxes == NULL) {
+      pairCache->capacity = 0;
+      return false;
+    }
+  }
+  memset(pairCache->escaped, 0, numOfLines * sizeof(unsigned char));
+  memset(pairCache->moved, 0, numOfLines * sizeof(unsigned char));
+  return true;
+}
+
+// Returns box grown by PAIR_CACHE_MARGIN_FRAMES frames of motion at velocity
+// (vx, vy) on every side.
+static inline SweptBox PairCache_inflate(const SweptBox* box, const double vx,
+                                         const double vy,
+                                         const double timeStep) {
+  const double marginX = fabs(vx) * timeStep * PAIR_CACHE_MARGIN_FRAMES;
+  const double marginY = fabs(vy) * timeStep * PAIR_CACHE_MARGIN_FRAMES;
+  SweptBox fatBox;
+  fatBox.xmin = box->xmin - marginX;
+  fatBox.xmax = box->xmax + marginX;
+  fatBox.ymin = box->ymin - marginY;
+  fatBox.ymax = box->ymax + marginY;
+  return fatBox;
+}
+
+// Inflates every line's box and finds all pairs again with the grid.
+static bool PairCache_rebuild(PairCache* pairCache, Grid* grid,
+                              const SweptBox* boxes, const double* vx,
+                              const double* vy, const double timeStep,
+                              const unsigned int numOfLines) {
+  PairCache_invalidate(pairCache);
+  if (!PairCache_reserve(pairCache, numOfLines)) {
+    return false;
+  }
+  SweptBox* fatBoxes = pairCache->fatBoxes;
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    fatBoxes[i] = PairCache_inflate(&boxes[i], vx[i], vy[i], timeStep);
+  }
+  memcpy(pairCache->builtBoxes, fatBoxes, numOfLines * sizeof(SweptBox));
+  pairCache->numMoved = 0;
+  if (!Grid_findCandidates(grid, pairCache->builtBoxes, numOfLines,
+                           &pairCache->pairs)) {
+    PairCache_invalidate(pairCache);
+    return false;
+  }
+  pairCache->numOfLines = numOfLines;
+  return true;
+}
+
+// Re-inflates the numEscaped lines in escapedLines and replaces their pairs.
+// Returns false if memory ran out.
+static bool PairCache_repair(PairCache* pairCache, const Grid* grid,
+                             const SweptBox* boxes, const double* vx,
+                             const double* vy, const double timeStep,
+                             const unsigned int numEscaped) {
+  SweptBox* fatBoxes = pairCache->fatBoxes;
+  const unsigned char* escaped = pairCache->escaped;
+  const unsigned int* escapedLines = pairCache->escapedLines;
+  unsigned char* moved = pairCache->moved;
+  unsigned int* movedLines = pairCache->movedLines;
+  CandidateList* pairs = &pairCache->pairs;
+
+  for (unsigned int e = 0; e < numEscaped; e++) {
+    const unsigned int i = escapedLines[e];
+    fatBoxes[i] = PairCache_inflate(&boxes[i], vx[i], vy[i], timeStep);
+    if (!moved[i]) {
+      moved[i] = 1;
+      movedLines[pairCache->numMoved++] = i;
+    }
+  }
+
+  // Drop every pair of an escaped line.
+  unsigned int kept = 0;
+  for (unsigned int p = 0; p < pairs->size; p++) {
+    const CandidatePair pair = pairs->pairs[p];
+    if (!escaped[pair.i] && !escaped[pair.j]) {
+      pairs->pairs[kept++] = pair;
+    }
+  }
+  pairs->size = kept;
+
+  // Find them again: the main grid knows the lines that have not moved since
+  // the last rebuild...
+  for (unsigned int e = 0; e < numEscaped; e++) {
+    const unsigned int i = escapedLines[e];
+    const unsigned int first = pairs->size;
+    Grid_findOverlaps(grid, pairCache->builtBoxes, &fatBoxes[i], i, pairs);
+    kept = first;
+    for (unsigned int p = first; p < pairs->size; p++) {
+      if (!moved[pairs->pairs[p].j]) {
+        pairs->pairs[kept++] = pairs->pairs[p];
+      }
+    }
+    pairs->size = kept;
+  }
+
+  // ...and a grid over the moved lines alone finds the pairs among them.
+  // Pairs of two lines that did not escape this frame are already cached.
+  const unsigned int numMoved = pairCache->numMoved;
+  SweptBox* movedBoxes = pairCache->movedBoxes;
+  for (unsigned int m = 0; m < numMoved; m++) {
+    movedBoxes[m] = fatBoxes[movedLines[m]];
+  }
+  CandidateList* movedPairs = &pairCache->movedPairs;
+  CandidateList_clear(movedPairs);
+  if (!Grid_findCandidates(pairCache->movedGrid, movedBoxes, numMoved,
+                           movedPairs)) {
+    return false;
+  }
+  for (unsigned int p = 0; p < movedPairs->size; p++) {
+    const unsigned int i = movedLines[movedPairs->pairs[p].i];
+    const unsigned int j = movedLines[movedPairs->pairs[p].j];
+    if (escaped[i] || escaped[j]) {
+      CandidateList_append(pairs, i, j);
+    }
+  }
+  return !pairs->overflowed;
+}
+
+bool PairCache_findCandidates(PairCache* pairCache, Grid* grid,
+                              const SweptBox* boxes, const double* vx,
+                              const double* vy, const double timeStep,
+                              const unsigned int numOfLines,
+                              CandidateList* candidates) {
+  if (pairCache->numOfLines != numOfLines || numOfLines < 2) {
+    if (!PairCache_rebuild(pairCache, grid, boxes, vx, vy, timeStep,
+                           numOfLines)) {
+      return false;
+    }
+  } else {
+    // Find the lines whose swept boxes left their inflated boxes.
+    const SweptBox* fatBoxes = pairCache->fatBoxes;
+    unsigned char* escaped = pairCache->escaped;
+    unsigned int* escapedLines = pairCache->escapedLines;
+    unsigned int numEscaped = 0;
+    unsigned int numNewlyMoved = 0;
+    for (unsigned int i = 0; i < numOfLines; i++) {
+      if (boxes[i].xmin < fatBoxes[i].xmin || boxes[i].xmax > fatBoxes[i].xmax
+          || boxes[i].ymin < fatBoxes[i].ymin
+          || boxes[i].ymax > fatBoxes[i].ymax) {
+        escaped[i] = 1;
+        escapedLines[numEscaped++] = i;
+        numNewlyMoved += !pairCache->moved[i];
+      }
+    }
+
+    // Rebuild once a good part of the main grid is stale.
+    bool valid = true;
+    if (pairCache->numMoved + numNewlyMoved
+        > numOfLines / PAIR_CACHE_MAX_MOVED) {
+      valid = false;
+    } else if (numEscaped > 0) {
+      valid = PairCache_repair(pairCache, grid, boxes, vx, vy, timeStep,
+                               numEscaped);
+    }
+    for (unsigned int e = 0; e < numEscaped; e++) {
+      escaped[escapedLines[e]] = 0;
+    }
+    if (!valid && !PairCache_rebuild(pairCache, grid, boxes, vx, vy,
+                                     timeStep, numOfLines)) {
+      return false;
+    }
+  }
+
+  // Only the cached pairs can intersect; pass on those whose swept boxes
+  // overlap this frame.
+  const CandidatePair* pairs = pairCache->pairs.pairs;
+  const unsigned int numPairs = pairCache->pairs.size;
+  for (unsigned int p = 0; p < numPairs; p++) {
+    if (SweptBox_overlap(&boxes[pairs[p].i], &boxes[pairs[p].j])) {
+      CandidateList_append(candidates, pairs[p].i, pairs[p].j);
+    }
+  }
+  return !candidates->overflowed;
+}
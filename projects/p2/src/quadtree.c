@@ -0,0 +1,283 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "quadtree.h"
+
+// Marks the end of a node's line list.
+#define QUADTREE_NONE UINT_MAX
+
+// Returns the index of the quadrant of node that fully contains box, or -1 if
+// the box straddles one of the node's split lines.  Quadrants are numbered
+// 0: (-x, -y), 1: (+x, -y), 2: (-x, +y), 3: (+x, +y).  A box touching a split
+// line belongs to neither side, so boxes in different quadrants can never
+// overlap.
+static inline int QuadTree_quadrantOf(const QuadTreeNode* node,
+                                      const SweptBox* box) {
+  int quadrant;
+  if (box->xmax < node->centerX) {
+    quadrant = 0;
+  } else if (box->xmin > node->centerX) {
+    quadrant = 1;
+  } else {
+    return -1;
+  }
+  if (box->ymax < node->centerY) {
+    return quadrant;
+  } else if (box->ymin > node->centerY) {
+    return quadrant + 2;
+  }
+  return -1;
+}
+
+// Takes 4 consecutive nodes from the arena.  Returns the index of the first,
+// or 0 if memory ran out.
+static unsigned int QuadTree_allocateChildren(QuadTree* quadTree) {
+  if (quadTree->numNodes + 4 > quadTree->nodesCapacity) {
+    const unsigned int capacity = 2 * quadTree->nodesCapacity + 64;
+    QuadTreeNode* nodes = realloc(quadTree->nodes,
+                                  capacity * sizeof(QuadTreeNode));
+    if (nodes == NULL) {
+      return 0;
+    }
+    quadTree->nodes = nodes;
+    quadTree->nodesCapacity = capacity;
+  }
+  const unsigned int first = quadTree->numNodes;
+  quadTree->numNodes += 4;
+  return first;
+}
+
+// Prepends line i to the line list of node n.
+static inline void QuadTree_push(QuadTree* quadTree, const unsigned int n,
+                                 const unsigned int i) {
+  QuadTreeNode* node = &quadTree->nodes[n];
+  quadTree->next[i] = node->head;
+  node->head = i;
+  node->count++;
+}
+
+// Turns leaf n into an internal node, moving each of its lines that fits in a
+// quadrant down into that quadrant's child, and splits any child that ends
+// up over capacity in turn.  Returns false if memory ran out.
+static bool QuadTree_split(QuadTree* quadTree, const unsigned int n) {
+  const unsigned int first = QuadTree_allocateChildren(quadTree);
+  if (first == 0) {
+    return false;
+  }
+
+  // The arena may have moved.
+  QuadTreeNode* node = &quadTree->nodes[n];
+  node->children = first;
+  for (int q = 0; q < 4; q++) {
+    QuadTreeNode* child = &quadTree->nodes[first + q];
+    const double signX = (q & 1) ? 1 : -1;
+    const double signY = (q & 2) ? 1 : -1;
+    child->children = 0;
+    child->depth = node->depth + 1;
+    child->head = QUADTREE_NONE;
+    child->count = 0;
+    child->halfWidth = node->halfWidth / 2;
+    child->halfHeight = node->halfHeight / 2;
+    child->centerX = node->centerX + signX * child->halfWidth;
+    child->centerY = node->centerY + signY * child->halfHeight;
+    child->region = node->region;
+    if (q & 1) {
+      child->region.xmin = node->centerX;
+    } else {
+      child->region.xmax = node->centerX;
+    }
+    if (q & 2) {
+      child->region.ymin = node->centerY;
+    } else {
+      child->region.ymax = node->centerY;
+    }
+  }
+
+  unsigned int i = node->head;
+  node->head = QUADTREE_NONE;
+  node->count = 0;
+  while (i != QUADTREE_NONE) {
+    const unsigned int nextI = quadTree->next[i];
+    const int q = QuadTree_quadrantOf(node, &quadTree->boxes[i]);
+    QuadTree_push(quadTree, q < 0 ? n : first + q, i);
+    i = nextI;
+  }
+
+  for (int q = 0; q < 4; q++) {
+    const QuadTreeNode* child = &quadTree->nodes[first + q];
+    if (child->count > quadTree->leafCapacity
+        && child->depth < quadTree->maxDepth
+        && !QuadTree_split(quadTree, first + q)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Stores line i in the deepest existing node that fully contains its box,
+// splitting that node if it is a leaf that is now over capacity.  Returns
+// false if memory ran out.
+static bool QuadTree_insert(QuadTree* quadTree, const unsigned int i) {
+  const SweptBox* box = &quadTree->boxes[i];
+  unsigned int n = 0;
+  while (quadTree->nodes[n].children != 0) {
+    const int q = QuadTree_quadrantOf(&quadTree->nodes[n], box);
+    if (q < 0) {
+      break;
+    }
+    n = quadTree->nodes[n].children + q;
+  }
+
+  QuadTree_push(quadTree, n, i);
+  const QuadTreeNode* node = &quadTree->nodes[n];
+  if (node->children == 0 && node->count > quadTree->leafCapacity
+      && node->depth < quadTree->maxDepth) {
+    return QuadTree_split(quadTree, n);
+  }
+  return true;
+}
+
+// Appends a candidate for every line stored in node n or below whose box
+// overlaps line i's.
+static void QuadTree_queryDescendants(const QuadTree* quadTree,
+                                      const unsigned int n,
+                                      const unsigned int i,
+                                      CandidateList* candidates) {
+  const QuadTreeNode* node = &quadTree->nodes[n];
+  const SweptBox* box = &quadTree->boxes[i];
+  if (!SweptBox_overlap(box, &node->region)) {
+    return;
+  }
+  for (unsigned int j = node->head; j != QUADTREE_NONE;
+       j = quadTree->next[j]) {
+    if (SweptBox_overlap(box, &quadTree->boxes[j])) {
+      CandidateList_append(candidates, i, j);
+    }
+  }
+  if (node->children != 0) {
+    for (int q = 0; q < 4; q++) {
+      QuadTree_queryDescendants(quadTree, node->children + q, i, candidates);
+    }
+  }
+}
+
+QuadTree* QuadTree_new(const unsigned int maxDepth,
+                       const unsigned int leafCapacity) {
+  QuadTree* quadTree = malloc(sizeof(QuadTree));
+  if (quadTree == NULL) {
+    return NULL;
+  }
+
+  quadTree->maxDepth = maxDepth;
+  quadTree->leafCapacity = leafCapacity;
+  quadTree->nodes = NULL;
+  quadTree->numNodes = 0;
+  quadTree->nodesCapacity = 0;
+  quadTree->boxes = NULL;
+  quadTree->next = NULL;
+  quadTree->linesCapacity = 0;
+  return quadTree;
+}
+
+void QuadTree_delete(QuadTree* quadTree) {
+  if (quadTree == NULL) {
+    return;
+  }
+  free(quadTree->nodes);
+  free(quadTree->next);
+  free(quadTree);
+}
+
+bool QuadTree_findCandidates(QuadTree* quadTree, const SweptBox* boxes,
+                             const unsigned int numOfLines,
+                             CandidateList* candidates) {
+  quadTree->boxes = boxes;
+  if (numOfLines > quadTree->linesCapacity) {
+    unsigned int* next = realloc(quadTree->next,
+                                 numOfLines * sizeof(unsigned int));
+    if (next == NULL) {
+      return false;
+    }
+    quadTree->next = next;
+    quadTree->linesCapacity = numOfLines;
+  }
+
+  // Empty the arena and plant the root, which covers the whole plane but
+  // splits at the center of the box.
+  quadTree->numNodes = 0;
+  if (quadTree->nodesCapacity == 0) {
+    quadTree->nodes = malloc(64 * sizeof(QuadTreeNode));
+    if (quadTree->nodes == NULL) {
+      return false;
+    }
+    quadTree->nodesCapacity = 64;
+  }
+  QuadTreeNode* root = &quadTree->nodes[quadTree->numNodes++];
+  root->children = 0;
+  root->depth = 0;
+  root->head = QUADTREE_NONE;
+  root->count = 0;
+  root->halfWidth = ((double) BOX_XMAX - BOX_XMIN) / 2;
+  root->halfHeight = ((double) BOX_YMAX - BOX_YMIN) / 2;
+  root->centerX = BOX_XMIN + root->halfWidth;
+  root->centerY = BOX_YMIN + root->halfHeight;
+  root->region.xmin = -INFINITY;
+  root->region.xmax = INFINITY;
+  root->region.ymin = -INFINITY;
+  root->region.ymax = INFINITY;
+
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    if (!QuadTree_insert(quadTree, i)) {
+      return false;
+    }
+  }
+
+  // A line can only overlap lines in its own node, in the node's ancestors,
+  // or in its descendants; boxes in other nodes are separated by a split
+  // line.  Pairing each line with the rest of its node and with its
+  // descendants therefore finds every overlapping pair once.
+  for (unsigned int n = 0; n < quadTree->numNodes; n++) {
+    const QuadTreeNode* node = &quadTree->nodes[n];
+    for (unsigned int i = node->head; i != QUADTREE_NONE;
+         i = quadTree->next[i]) {
+      const SweptBox* box = &quadTree->boxes[i];
+      for (unsigned int j = quadTree->next[i]; j != QUADTREE_NONE;
+           j = quadTree->next[j]) {
+        if (SweptBox_overlap(box, &quadTree->boxes[j])) {
+          CandidateList_append(candidates, i, j);
+        }
+      }
+      if (node->children != 0) {
+        for (int q = 0; q < 4; q++) {
+          QuadTree_queryDescendants(quadTree, node->children + q, i,
+                                    candidates);
+        }
+      }
+    }
+  }
+  return !candidates->overflowed;
+}
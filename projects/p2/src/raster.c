@@ -0,0 +1,314 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raster.h"
+
+// Bytes per pixel.
+#define RASTER_CHANNELS 3
+
+// The colors X11 calls "dark red" and "gray", which the graphics demo uses.
+static const unsigned char RASTER_RED[RASTER_CHANNELS] = {139, 0, 0};
+static const unsigned char RASTER_GRAY[RASTER_CHANNELS] = {190, 190, 190};
+
+// Furthest a pixel coordinate is allowed from the framebuffer, so that lines
+// far outside it neither overflow an int nor take long to skip.
+#define RASTER_COORDINATE_LIMIT 1000000.0
+
+Raster* Raster_new(const unsigned int width, const unsigned int height) {
+  Raster* raster = malloc(sizeof(Raster));
+  if (raster == NULL) {
+    return NULL;
+  }
+
+  raster->width = width;
+  raster->height = height;
+  raster->pixels = malloc((size_t) width * height * RASTER_CHANNELS);
+  raster->segments = NULL;
+  raster->capacity = 0;
+  raster->tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+  raster->tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+  raster->tileStarts = malloc((raster->tilesX * raster->tilesY + 1)
+                              * sizeof(unsigned int));
+  raster->tileSegments = NULL;
+  raster->tileSegmentsCapacity = 0;
+  if (raster->pixels == NULL || raster->tileStarts == NULL) {
+    Raster_delete(raster);
+    return NULL;
+  }
+  return raster;
+}
+
+void Raster_delete(Raster* raster) {
+  if (raster == NULL) {
+    return;
+  }
+  free(raster->pixels);
+  free(raster->segments);
+  free(raster->tileStarts);
+  free(raster->tileSegments);
+  free(raster);
+}
+
+// Converts a coordinate to pixels, truncating as the graphics demo does.  NaN,
+// which cannot be converted to an int, maps off the framebuffer.
+static inline int Raster_toPixel(const double x) {
+  if (isnan(x) || x < -RASTER_COORDINATE_LIMIT) {
+    return (int) -RASTER_COORDINATE_LIMIT;
+  }
+  if (x > RASTER_COORDINATE_LIMIT) {
+    return (int) RASTER_COORDINATE_LIMIT;
+  }
+  return (int) x;
+}
+
+// Returns num / den rounded to the nearest integer, halves rounded up.
+// Precondition: den > 0.
+static inline int64_t Raster_divideRounded(const int64_t num,
+                                           const int64_t den) {
+  const int64_t q = 2 * num + den;
+  const int64_t d = 2 * den;
+  return q >= 0 ? q / d : -((-q + d - 1) / d);
+}
+
+// Sets the pixel at (x, y) to rgb.
+static inline void Raster_plot(Raster* raster, const int x, const int y,
+                               const unsigned char* rgb) {
+  unsigned char* pixel = raster->pixels
+      + ((size_t) y * raster->width + x) * RASTER_CHANNELS;
+  pixel[0] = rgb[0];
+  pixel[1] = rgb[1];
+  pixel[2] = rgb[2];
+}
+
+// Draws the pixels of segment s that fall within [x0, x1) x [y0, y1).  A
+// line covers one pixel per column, or per row if it is steeper than 45
+// degrees, at the rounded position of the line.
+static void Raster_drawSegment(Raster* raster, const RasterSegment* s,
+                               const int x0, const int y0, const int x1,
+                               const int y1) {
+  const unsigned char* rgb = s->color == RED ? RASTER_RED : RASTER_GRAY;
+  const int dx = s->x2 - s->x1;
+  const int dy = s->y2 - s->y1;
+  if (abs(dx) >= abs(dy)) {
+    const int xa = dx >= 0 ? s->x1 : s->x2;
+    const int ya = dx >= 0 ? s->y1 : s->y2;
+    const int run = abs(dx);
+    const int rise = dx >= 0 ? dy : -dy;
+    const int first = xa > x0 ? xa : x0;
+    const int last = xa + run < x1 - 1 ? xa + run : x1 - 1;
+    for (int x = first; x <= last; x++) {
+      const int y = run == 0 ? ya : ya + (int) Raster_divideRounded(
+          (int64_t) (x - xa) * rise, run);
+      if (y >= y0 && y < y1) {
+        Raster_plot(raster, x, y, rgb);
+      }
+    }
+  } else {
+    const int ya = dy >= 0 ? s->y1 : s->y2;
+    const int xa = dy >= 0 ? s->x1 : s->x2;
+    const int run = abs(dy);
+    const int rise = dy >= 0 ? dx : -dx;
+    const int first = ya > y0 ? ya : y0;
+    const int last = ya + run < y1 - 1 ? ya + run : y1 - 1;
+    for (int y = first; y <= last; y++) {
+      const int x = xa + (int) Raster_divideRounded((int64_t) (y - ya) * rise,
+                                                    run);
+      if (x >= x0 && x < x1) {
+        Raster_plot(raster, x, y, rgb);
+      }
+    }
+  }
+}
+
+// Finds the range of tiles [*t0, *t1] that segment s's bounding box covers
+// along one axis of size pixels.  Returns false if it misses the framebuffer.
+static inline bool Raster_tileRange(const int a, const int b,
+                                    const unsigned int size, unsigned int* t0,
+                                    unsigned int* t1) {
+  const int lo = a < b ? a : b;
+  const int hi = a < b ? b : a;
+  if (hi < 0 || lo >= (int) size) {
+    return false;
+  }
+  *t0 = (lo > 0 ? lo : 0) / RASTER_TILE_SIZE;
+  *t1 = (hi < (int) size ? hi : (int) size - 1) / RASTER_TILE_SIZE;
+  return true;
+}
+
+// Buckets the segments into the tiles they overlap, in line order.  Returns
+// false if memory ran out.
+static bool Raster_binSegments(Raster* raster, const unsigned int numOfLines) {
+  const unsigned int numTiles = raster->tilesX * raster->tilesY;
+  unsigned int* tileStarts = raster->tileStarts;
+  memset(tileStarts, 0, (numTiles + 1) * sizeof(unsigned int));
+
+  // Count the segments in each tile, then turn the counts into offsets.
+  unsigned int total = 0;
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    const RasterSegment* s = &raster->segments[i];
+    unsigned int tx0, tx1, ty0, ty1;
+    if (!Raster_tileRange(s->x1, s->x2, raster->width, &tx0, &tx1)
+        || !Raster_tileRange(s->y1, s->y2, raster->height, &ty0, &ty1)) {
+      continue;
+    }
+    for (unsigned int ty = ty0; ty <= ty1; ty++) {
+      for (unsigned int tx = tx0; tx <= tx1; tx++) {
+        tileStarts[ty * raster->tilesX + tx]++;
+      }
+    }
+    total += (tx1 - tx0 + 1) * (ty1 - ty0 + 1);
+  }
+  unsigned int offset = 0;
+  for (unsigned int t = 0; t < numTiles; t++) {
+    const unsigned int count = tileStarts[t];
+    tileStarts[t] = offset;
+    offset += count;
+  }
+
+  if (total > raster->tileSegmentsCapacity) {
+    const unsigned int capacity = total > 2 * raster->tileSegmentsCapacity
+                                  ? total : 2 * raster->tileSegmentsCapacity;
+    free(raster->tileSegments);
+    raster->tileSegments = malloc(capacity * sizeof(unsigned int));
+    if (raster->tileSegments == NULL) {
+      raster->tileSegmentsCapacity = 0;
+      return false;
+    }
+    raster->tileSegmentsCapacity = capacity;
+  }
+
+  // Fill the tiles, advancing each tile's offset to the next tile's start,
+  // then shift the offsets back.
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    const RasterSegment* s = &raster->segments[i];
+    unsigned int tx0, tx1, ty0, ty1;
+    if (!Raster_tileRange(s->x1, s->x2, raster->width, &tx0, &tx1)
+        || !Raster_tileRange(s->y1, s->y2, raster->height, &ty0, &ty1)) {
+      continue;
+    }
+    for (unsigned int ty = ty0; ty <= ty1; ty++) {
+      for (unsigned int tx = tx0; tx <= tx1; tx++) {
+        raster->tileSegments[tileStarts[ty * raster->tilesX + tx]++] = i;
+      }
+    }
+  }
+  memmove(tileStarts + 1, tileStarts, numTiles * sizeof(unsigned int));
+  tileStarts[0] = 0;
+  return true;
+}
+
+bool Raster_draw(Raster* raster, const double* p1x, const double* p1y,
+                 const double* p2x, const double* p2y, const Color* color,
+                 const unsigned int numOfLines) {
+  if (numOfLines > raster->capacity) {
+    free(raster->segments);
+    raster->segments = malloc(numOfLines * sizeof(RasterSegment));
+    if (raster->segments == NULL) {
+      raster->capacity = 0;
+      return false;
+    }
+    raster->capacity = numOfLines;
+  }
+
+  const double scaleX = raster->width / ((double) BOX_XMAX - BOX_XMIN);
+  const double scaleY = raster->height / ((double) BOX_YMAX - BOX_YMIN);
+  RasterSegment* segments = raster->segments;
+  #pragma omp parallel for schedule(static)
+  for (unsigned int i = 0; i < numOfLines; i++) {
+    // A line with a NaN endpoint is not drawn: its segment lies entirely off
+    // the framebuffer, so no tile takes it.
+    if (isnan(p1x[i]) || isnan(p1y[i]) || isnan(p2x[i]) || isnan(p2y[i])) {
+      segments[i].x1 = segments[i].x2 = (int) -RASTER_COORDINATE_LIMIT;
+      segments[i].y1 = segments[i].y2 = (int) -RASTER_COORDINATE_LIMIT;
+      segments[i].color = color[i];
+      continue;
+    }
+    segments[i].x1 = Raster_toPixel((p1x[i] - BOX_XMIN) * scaleX);
+    segments[i].y1 = Raster_toPixel((p1y[i] - BOX_YMIN) * scaleY);
+    segments[i].x2 = Raster_toPixel((p2x[i] - BOX_XMIN) * scaleX);
+    segments[i].y2 = Raster_toPixel((p2y[i] - BOX_YMIN) * scaleY);
+    segments[i].color = color[i];
+  }
+  if (!Raster_binSegments(raster, numOfLines)) {
+    return false;
+  }
+
+  // Tiles hold very different numbers of lines, so they are handed out one
+  // at a time.
+  const unsigned int numTiles = raster->tilesX * raster->tilesY;
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (unsigned int t = 0; t < numTiles; t++) {
+    const int x0 = (t % raster->tilesX) * RASTER_TILE_SIZE;
+    const int y0 = (t / raster->tilesX) * RASTER_TILE_SIZE;
+    const int x1 = x0 + RASTER_TILE_SIZE < (int) raster->width
+                   ? x0 + RASTER_TILE_SIZE : (int) raster->width;
+    const int y1 = y0 + RASTER_TILE_SIZE < (int) raster->height
+                   ? y0 + RASTER_TILE_SIZE : (int) raster->height;
+    for (int y = y0; y < y1; y++) {
+      memset(raster->pixels
+             + ((size_t) y * raster->width + x0) * RASTER_CHANNELS, 0,
+             (size_t) (x1 - x0) * RASTER_CHANNELS);
+    }
+    const unsigned int* tileSegments = raster->tileSegments;
+    for (unsigned int k = raster->tileStarts[t];
+         k < raster->tileStarts[t + 1]; k++) {
+      if (segments[tileSegments[k]].color == RED) {
+        Raster_drawSegment(raster, &segments[tileSegments[k]], x0, y0, x1,
+                           y1);
+      }
+    }
+    for (unsigned int k = raster->tileStarts[t];
+         k < raster->tileStarts[t + 1]; k++) {
+      if (segments[tileSegments[k]].color != RED) {
+        Raster_drawSegment(raster, &segments[tileSegments[k]], x0, y0, x1,
+                           y1);
+      }
+    }
+  }
+  return true;
+}
+
+bool Raster_writePpm(const Raster* raster, const char* path) {
+  FILE* fout = fopen(path, "wb");
+  if (fout == NULL) {
+    perror(path);
+    return false;
+  }
+
+  const size_t size = (size_t) raster->width * raster->height
+                      * RASTER_CHANNELS;
+  const bool ok = fprintf(fout, "P6\n%u %u\n255\n", raster->width,
+                          raster->height) > 0
+      && fwrite(raster->pixels, 1, size, fout) == size;
+
+  if (fclose(fout) != 0 || !ok) {
+    fprintf(stderr, "Error writing image (%s)\n", path);
+    return false;
+  }
+  return true;
+}
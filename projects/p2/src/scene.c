@@ -0,0 +1,374 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "scene.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "line.h"
+
+// Size of the header, and of a line's attributes, in a binary scene file and
+// in a checkpoint.
+#define SCENE_HEADER_SIZE 16
+#define SCENE_LINE_SIZE (6 * sizeof(double) + 1)
+#define CHECKPOINT_HEADER_SIZE 40
+#define CHECKPOINT_LINE_SIZE (6 * sizeof(double) + sizeof(uint32_t) + 1)
+
+// Number of double columns following the header.
+#define SCENE_NUM_COLUMNS 6
+
+static uint32_t Scene_readUint32(const unsigned char* bytes) {
+  return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8
+      | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+static void Scene_writeUint32(unsigned char* bytes, const uint32_t value) {
+  bytes[0] = value;
+  bytes[1] = value >> 8;
+  bytes[2] = value >> 16;
+  bytes[3] = value >> 24;
+}
+
+static uint64_t Scene_readUint64(const unsigned char* bytes) {
+  return (uint64_t) Scene_readUint32(bytes)
+      | (uint64_t) Scene_readUint32(bytes + 4) << 32;
+}
+
+static void Scene_writeUint64(unsigned char* bytes, const uint64_t value) {
+  Scene_writeUint32(bytes, value);
+  Scene_writeUint32(bytes + 4, value >> 32);
+}
+
+static double Scene_readDouble(const unsigned char* bytes) {
+  const uint64_t bits = Scene_readUint64(bytes);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static void Scene_writeDouble(unsigned char* bytes, const double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  Scene_writeUint64(bytes, bits);
+}
+
+// Copy count little-endian doubles from the file into an array.  On
+// little-endian machines (all the ones we run on) this is a plain memcpy.
+static void Scene_readDoubles(double* restrict out,
+                              const unsigned char* restrict in,
+                              const unsigned int count) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  for (unsigned int i = 0; i < count; i++) {
+    out[i] = Scene_readDouble(in + i * sizeof(double));
+  }
+#else
+  memcpy(out, in, count * sizeof(double));
+#endif
+}
+
+// Write count doubles to the file, little-endian.
+static bool Scene_writeDoubles(FILE* fout, const double* values,
+                               const unsigned int count) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned char bytes[sizeof(double)];
+    Scene_writeDouble(bytes, values[i]);
+    if (fwrite(bytes, sizeof(bytes), 1, fout) != 1) {
+      return false;
+    }
+  }
+  return true;
+#else
+  return fwrite(values, sizeof(double), count, fout) == count;
+#endif
+}
+
+static bool Scene_hasMagic(const char* path, const char* expected) {
+  FILE* fin = fopen(path, "rb");
+  if (fin == NULL) {
+    return false;
+  }
+  char magic[4];
+  const bool hasMagic = fread(magic, 1, sizeof(magic), fin) == sizeof(magic)
+      && memcmp(magic, expected, sizeof(magic)) == 0;
+  fclose(fin);
+  return hasMagic;
+}
+
+bool Scene_isBinary(const char* path) {
+  return Scene_hasMagic(path, SCENE_MAGIC);
+}
+
+bool Scene_isCheckpoint(const char* path) {
+  return Scene_hasMagic(path, CHECKPOINT_MAGIC);
+}
+
+// Map the file at path into memory.  Mapping the file rather than reading it
+// makes the only copy the one into the collision world's arrays.  Returns
+// NULL, after printing a message, if the file cannot be mapped.
+static const unsigned char* Scene_map(const char* path, size_t* size) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Input file not found (%s)\n", path);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    fprintf(stderr, "Empty or unreadable file (%s)\n", path);
+    close(fd);
+    return NULL;
+  }
+  *size = st.st_size;
+  void* data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror("mmap");
+    return NULL;
+  }
+  madvise(data, *size, MADV_SEQUENTIAL);
+  return data;
+}
+
+// Check that the file at path, of the given size, starts with a header of
+// headerSize bytes with the magic number and version given, and holds the
+// lineSize bytes of every line after it.  Returns the number of lines, or 0
+// after printing a message if the file does not.
+static uint32_t Scene_checkHeader(const char* path,
+                                  const unsigned char* data,
+                                  const size_t size, const char* magic,
+                                  const uint32_t version,
+                                  const size_t headerSize,
+                                  const size_t lineSize) {
+  if (size < headerSize || memcmp(data, magic, 4) != 0) {
+    fprintf(stderr, "Not a %s file (%s)\n",
+            strcmp(magic, SCENE_MAGIC) == 0 ? "binary scene" : "checkpoint",
+            path);
+    return 0;
+  }
+  if (Scene_readUint32(data + 4) != version) {
+    fprintf(stderr, "Unsupported file version %u (%s)\n",
+            Scene_readUint32(data + 4), path);
+    return 0;
+  }
+  const uint32_t numOfLines = Scene_readUint32(data + 8);
+  if (numOfLines == 0
+      || size != headerSize + (uint64_t) numOfLines * lineSize) {
+    fprintf(stderr, "Truncated or corrupt file (%s)\n", path);
+    return 0;
+  }
+  return numOfLines;
+}
+
+// Check that every color is valid.
+static bool Scene_checkColors(const char* path, const unsigned char* colors,
+                              const uint32_t numOfLines) {
+  for (uint32_t i = 0; i < numOfLines; i++) {
+    if (colors[i] > GRAY) {
+      fprintf(stderr, "Invalid color %u for line %u (%s)\n", colors[i], i,
+              path);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Create a collision world holding numOfLines lines, whose positions and
+// velocities are read from the double columns at data and whose colors are
+// read from colors.
+static CollisionWorld* Scene_createWorld(const char* path,
+                                         const unsigned char* data,
+                                         const unsigned char* colors,
+                                         const uint32_t numOfLines) {
+  CollisionWorld* collisionWorld = CollisionWorld_new(numOfLines);
+  if (collisionWorld == NULL) {
+    fprintf(stderr, "Out of memory loading %u lines (%s)\n", numOfLines, path);
+    return NULL;
+  }
+  const unsigned int first = CollisionWorld_appendLines(collisionWorld,
+                                                        numOfLines);
+  double* columns[SCENE_NUM_COLUMNS] = {
+    collisionWorld->p1x + first, collisionWorld->p1y + first,
+    collisionWorld->p2x + first, collisionWorld->p2y + first,
+    collisionWorld->vx + first, collisionWorld->vy + first
+  };
+  for (int c = 0; c < SCENE_NUM_COLUMNS; c++) {
+    Scene_readDoubles(columns[c],
+                      data + (size_t) c * numOfLines * sizeof(double),
+                      numOfLines);
+  }
+  for (uint32_t i = 0; i < numOfLines; i++) {
+    collisionWorld->color[first + i] = (Color) colors[i];
+  }
+  return collisionWorld;
+}
+
+// Write the positions and velocities of a collision world's lines, as double
+// columns.
+static bool Scene_writeColumns(FILE* fout, CollisionWorld* collisionWorld) {
+  const double* columns[SCENE_NUM_COLUMNS] = {
+    collisionWorld->p1x, collisionWorld->p1y, collisionWorld->p2x,
+    collisionWorld->p2y, collisionWorld->vx, collisionWorld->vy
+  };
+  for (int c = 0; c < SCENE_NUM_COLUMNS; c++) {
+    if (!Scene_writeDoubles(fout, columns[c], collisionWorld->numOfLines)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Write the colors of a collision world's lines, one byte each.
+static bool Scene_writeColors(FILE* fout, CollisionWorld* collisionWorld) {
+  for (unsigned int i = 0; i < collisionWorld->numOfLines; i++) {
+    if (fputc(collisionWorld->color[i], fout) == EOF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+CollisionWorld* Scene_readBinary(const char* path) {
+  size_t size;
+  const unsigned char* data = Scene_map(path, &size);
+  if (data == NULL) {
+    return NULL;
+  }
+  CollisionWorld* collisionWorld = NULL;
+  const uint32_t numOfLines = Scene_checkHeader(path, data, size, SCENE_MAGIC,
+                                                SCENE_VERSION,
+                                                SCENE_HEADER_SIZE,
+                                                SCENE_LINE_SIZE);
+  if (numOfLines != 0) {
+    const unsigned char* columns = data + SCENE_HEADER_SIZE;
+    const unsigned char* colors = columns
+        + (size_t) SCENE_NUM_COLUMNS * numOfLines * sizeof(double);
+    if (Scene_checkColors(path, colors, numOfLines)) {
+      collisionWorld = Scene_createWorld(path, columns, colors, numOfLines);
+    }
+  }
+  munmap((void*) data, size);
+  return collisionWorld;
+}
+
+bool Scene_writeBinary(const char* path, CollisionWorld* collisionWorld) {
+  FILE* fout = fopen(path, "wb");
+  if (fout == NULL) {
+    perror(path);
+    return false;
+  }
+
+  unsigned char header[SCENE_HEADER_SIZE] = {0};
+  memcpy(header, SCENE_MAGIC, 4);
+  Scene_writeUint32(header + 4, SCENE_VERSION);
+  Scene_writeUint32(header + 8, collisionWorld->numOfLines);
+  const bool ok = fwrite(header, 1, sizeof(header), fout) == sizeof(header)
+      && Scene_writeColumns(fout, collisionWorld)
+      && Scene_writeColors(fout, collisionWorld);
+
+  if (fclose(fout) != 0 || !ok) {
+    fprintf(stderr, "Error writing scene file (%s)\n", path);
+    return false;
+  }
+  return true;
+}
+
+bool CollisionWorld_save(CollisionWorld* collisionWorld, const char* path) {
+  FILE* fout = fopen(path, "wb");
+  if (fout == NULL) {
+    perror(path);
+    return false;
+  }
+
+  unsigned char header[CHECKPOINT_HEADER_SIZE] = {0};
+  memcpy(header, CHECKPOINT_MAGIC, 4);
+  Scene_writeUint32(header + 4, CHECKPOINT_VERSION);
+  Scene_writeUint32(header + 8, collisionWorld->numOfLines);
+  Scene_writeUint32(header + 12, collisionWorld->frame);
+  Scene_writeDouble(header + 16, collisionWorld->timeStep);
+  Scene_writeUint32(header + 24, collisionWorld->numLineWallCollisions);
+  Scene_writeUint32(header + 28, collisionWorld->numLineLineCollisions);
+  Scene_writeUint64(header + 32, collisionWorld->numPairsTested);
+  bool ok = fwrite(header, 1, sizeof(header), fout) == sizeof(header)
+      && Scene_writeColumns(fout, collisionWorld);
+  for (unsigned int i = 0; ok && i < collisionWorld->numOfLines; i++) {
+    unsigned char id[sizeof(uint32_t)];
+    Scene_writeUint32(id, collisionWorld->id[i]);
+    ok = fwrite(id, sizeof(id), 1, fout) == 1;
+  }
+  ok = ok && Scene_writeColors(fout, collisionWorld);
+
+  if (fclose(fout) != 0 || !ok) {
+    fprintf(stderr, "Error writing checkpoint (%s)\n", path);
+    return false;
+  }
+  return true;
+}
+
+CollisionWorld* CollisionWorld_load(const char* path) {
+  size_t size;
+  const unsigned char* data = Scene_map(path, &size);
+  if (data == NULL) {
+    return NULL;
+  }
+  CollisionWorld* collisionWorld = NULL;
+  const uint32_t numOfLines = Scene_checkHeader(path, data, size,
+                                                CHECKPOINT_MAGIC,
+                                                CHECKPOINT_VERSION,
+                                                CHECKPOINT_HEADER_SIZE,
+                                                CHECKPOINT_LINE_SIZE);
+  if (numOfLines == 0) {
+    munmap((void*) data, size);
+    return NULL;
+  }
+
+  // Line IDs double as indices, so the saved IDs can only be 0, 1, ...
+  const unsigned char* columns = data + CHECKPOINT_HEADER_SIZE;
+  const unsigned char* ids = columns
+      + (size_t) SCENE_NUM_COLUMNS * numOfLines * sizeof(double);
+  const unsigned char* colors = ids + (size_t) numOfLines * sizeof(uint32_t);
+  bool valid = Scene_checkColors(path, colors, numOfLines);
+  for (uint32_t i = 0; valid && i < numOfLines; i++) {
+    if (Scene_readUint32(ids + i * sizeof(uint32_t)) != i) {
+      fprintf(stderr, "Line %u has ID %u (%s)\n", i,
+              Scene_readUint32(ids + i * sizeof(uint32_t)), path);
+      valid = false;
+    }
+  }
+  if (valid) {
+    collisionWorld = Scene_createWorld(path, columns, colors, numOfLines);
+  }
+  if (collisionWorld != NULL) {
+    collisionWorld->frame = Scene_readUint32(data + 12);
+    collisionWorld->timeStep = Scene_readDouble(data + 16);
+    collisionWorld->numLineWallCollisions = Scene_readUint32(data + 24);
+    collisionWorld->numLineLineCollisions = Scene_readUint32(data + 28);
+    collisionWorld->numPairsTested = Scene_readUint64(data + 32);
+  }
+  munmap((void*) data, size);
+  return collisionWorld;
+}
@@ -20,10 +20,17 @@
  * SOFTWARE.
  **/
 
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "batch.h"
 #include "fasttime.h"
 #include "line.h"
 #include "line_demo.h"
@@ -36,28 +43,214 @@
 static char* DEFAULT_INPUT_FILE_PATH = "data/mit.in";
 static char* input_file_path;
 
-// For non-graphic version
-void lineMain(LineDemo *lineDemo) {
+// Long options, and the values getopt_long returns for them.
+enum {
+  OPTION_CHECKPOINT_EVERY = 256,
+  OPTION_CHECKPOINT_PREFIX,
+  OPTION_RESUME,
+  OPTION_RENDER_EVERY,
+  OPTION_RENDER_PREFIX,
+  OPTION_RENDER_SIZE
+};
+static const struct option LONG_OPTIONS[] = {
+  {"checkpoint-every", required_argument, NULL, OPTION_CHECKPOINT_EVERY},
+  {"checkpoint-prefix", required_argument, NULL, OPTION_CHECKPOINT_PREFIX},
+  {"resume", required_argument, NULL, OPTION_RESUME},
+  {"render-every", required_argument, NULL, OPTION_RENDER_EVERY},
+  {"render-prefix", required_argument, NULL, OPTION_RENDER_PREFIX},
+  {"render-size", required_argument, NULL, OPTION_RENDER_SIZE},
+  {NULL, 0, NULL, 0}
+};
+
+// For non-graphic version.  If checkpointEvery is not 0, a checkpoint is
+// written to <checkpointPrefix>-<frame>.ckpt every checkpointEvery frames.
+// Likewise, if renderEvery is not 0, the frame is drawn with raster and
+// written to <renderPrefix>-<frame>.ppm every renderEvery frames.  Returns
+// false if a checkpoint or an image could not be written.
+bool lineMain(LineDemo *lineDemo, const unsigned int checkpointEvery,
+              const char* checkpointPrefix, const unsigned int renderEvery,
+              const char* renderPrefix, Raster* raster) {
   // Loop for updating line movement simulation
   while (true) {
     if (!LineDemo_update(lineDemo)) {
       break;
     }
+    if (checkpointEvery != 0 && lineDemo->count % checkpointEvery == 0) {
+      char path[FILENAME_MAX];
+      snprintf(path, sizeof(path), "%s-%u.ckpt", checkpointPrefix,
+               lineDemo->count);
+      if (!LineDemo_saveCheckpoint(lineDemo, path)) {
+        return false;
+      }
+    }
+    if (renderEvery != 0 && lineDemo->count % renderEvery == 0) {
+      char path[FILENAME_MAX];
+      snprintf(path, sizeof(path), "%s-%u.ppm", renderPrefix,
+               lineDemo->count);
+      if (!LineDemo_render(lineDemo, raster, path)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// For validation: run the current and the reference collision code side by
+// side, comparing the collision counts after every frame.  Returns the first
+// frame on which they differ, or 0 if they never do.
+unsigned int validateMain(LineDemo *lineDemo, LineDemo *referenceDemo) {
+  unsigned int frame = 0;
+  while (true) {
+    frame++;
+    const bool running = LineDemo_update(lineDemo);
+    LineDemo_update(referenceDemo);
+    if (LineDemo_getNumLineWallCollisions(lineDemo)
+        != LineDemo_getNumLineWallCollisions(referenceDemo)
+        || LineDemo_getNumLineLineCollisions(lineDemo)
+        != LineDemo_getNumLineLineCollisions(referenceDemo)) {
+      return frame;
+    }
+    if (!running) {
+      return 0;
+    }
   }
 }
 
+// Runs lineDemo against a reference simulation of the same input and prints
+// the validation report.  Returns 0 if the collision counts agree on every
+// frame, and 1 otherwise.
+int validate(LineDemo *lineDemo, BroadPhase broadPhase, bool pairCacheFlag,
+             bool kineticFlag, unsigned int numFrames) {
+  LineDemo *referenceDemo = LineDemo_new();
+  LineDemo_setBroadPhase(referenceDemo, broadPhase);
+  LineDemo_setPairCache(referenceDemo, pairCacheFlag);
+  LineDemo_setKinetic(referenceDemo, kineticFlag);
+  LineDemo_setReference(referenceDemo, true);
+  LineDemo_setInputFile(referenceDemo, input_file_path);
+  if (!LineDemo_initLine(referenceDemo)) {
+    LineDemo_delete(referenceDemo);
+    return 1;
+  }
+  LineDemo_setNumFrames(lineDemo, numFrames);
+  LineDemo_setNumFrames(referenceDemo, numFrames);
+
+  const unsigned int frame = validateMain(lineDemo, referenceDemo);
+  printf("---- VALIDATION ----\n");
+  printf("%u Line-Wall Collisions (reference: %u)\n",
+         LineDemo_getNumLineWallCollisions(lineDemo),
+         LineDemo_getNumLineWallCollisions(referenceDemo));
+  printf("%u Line-Line Collisions (reference: %u)\n",
+         LineDemo_getNumLineLineCollisions(lineDemo),
+         LineDemo_getNumLineLineCollisions(referenceDemo));
+  if (frame != 0) {
+    printf("FAILED: collision counts first differ on frame %u\n", frame);
+  } else {
+    printf("PASSED\n");
+  }
+  printf("---- END VALIDATION ----\n");
+
+  LineDemo_delete(referenceDemo);
+  return frame != 0;
+}
+
 int main(int argc, char *argv[]) {
   int optchar;
   bool graphicDemoFlag = false;
+  bool validateFlag = false;
+  bool pairCacheFlag = true;
+  bool kineticFlag = false;
+  char* sceneOutputPath = NULL;
+  char* statsPath = NULL;
+  char* manifestPath = NULL;
+  char* resumePath = NULL;
+  unsigned int checkpointEvery = 0;
+  const char* checkpointPrefix = "checkpoint";
+  unsigned int renderEvery = 0;
+  const char* renderPrefix = "frame";
+  unsigned int renderWidth = WINDOW_WIDTH;
+  unsigned int renderHeight = WINDOW_HEIGHT;
   unsigned int numFrames = 1;
+  BroadPhase broadPhase = BROAD_PHASE_GRID;
+  int numThreads = 0;
+  extern char* optarg;
   extern int optind;
 
   // Process command line options.
-  while ((optchar = getopt(argc, argv, "gi")) != -1) {
+  while ((optchar = getopt_long(argc, argv, "gib:t:VCkw:s:m:", LONG_OPTIONS,
+                                NULL)) != -1) {
     switch (optchar) {
       case 'g':
         graphicDemoFlag = true;
         break;
+      case 'b': {
+        int i = 0;
+        while (i < NUM_BROAD_PHASES
+               && strcmp(optarg, BroadPhase_name((BroadPhase) i))) {
+          i++;
+        }
+        if (i == NUM_BROAD_PHASES) {
+          fprintf(stderr, "Unknown broad phase: %s\n", optarg);
+          exit(-1);
+        }
+        broadPhase = (BroadPhase) i;
+        break;
+      }
+      case 't':
+        numThreads = atoi(optarg);
+        if (numThreads < 1) {
+          fprintf(stderr, "Number of threads must be positive: %s\n", optarg);
+          exit(-1);
+        }
+        break;
+      case 'V':
+        validateFlag = true;
+        break;
+      case 'C':
+        pairCacheFlag = false;
+        break;
+      case 'k':
+        kineticFlag = true;
+        break;
+      case 'w':
+        sceneOutputPath = optarg;
+        break;
+      case 's':
+        statsPath = optarg;
+        break;
+      case 'm':
+        manifestPath = optarg;
+        break;
+      case OPTION_CHECKPOINT_EVERY:
+        if (atoi(optarg) < 1) {
+          fprintf(stderr, "Checkpoint interval must be positive: %s\n",
+                  optarg);
+          exit(-1);
+        }
+        checkpointEvery = atoi(optarg);
+        break;
+      case OPTION_CHECKPOINT_PREFIX:
+        checkpointPrefix = optarg;
+        break;
+      case OPTION_RESUME:
+        resumePath = optarg;
+        break;
+      case OPTION_RENDER_EVERY:
+        if (atoi(optarg) < 1) {
+          fprintf(stderr, "Render interval must be positive: %s\n", optarg);
+          exit(-1);
+        }
+        renderEvery = atoi(optarg);
+        break;
+      case OPTION_RENDER_PREFIX:
+        renderPrefix = optarg;
+        break;
+      case OPTION_RENDER_SIZE:
+        if (sscanf(optarg, "%ux%u", &renderWidth, &renderHeight) != 2
+            || renderWidth < 1 || renderHeight < 1) {
+          fprintf(stderr, "Render size must be WIDTHxHEIGHT: %s\n", optarg);
+          exit(-1);
+        }
+        break;
       default:
         printf("Ignoring unrecognized option: %c\n", optchar);
         continue;
@@ -70,59 +263,188 @@ int main(int argc, char *argv[]) {
     argv[i] = argv[i + optind - 1];
   }
 
+  // Run a batch of jobs, if given a manifest.
+  if (manifestPath != NULL) {
+    Batch* batch = Batch_readManifest(manifestPath);
+    if (batch == NULL) {
+      exit(-1);
+    }
+    Batch_run(batch, broadPhase, pairCacheFlag, kineticFlag, numThreads);
+    Batch_print(batch);
+    const bool failed = Batch_numFailed(batch) > 0;
+    Batch_delete(batch);
+    return failed;
+  }
+
   // Check to make sure number of arguments is correct.
   if (remaining_args < 1) {
-    printf("Usage: %s [-g] <numFrames> [inputfile]\n", argv[0]);
+    printf("Usage: %s [-g] [-V] [-C] [-k] [-w scenefile] [-s statsfile] "
+           "[-b broadphase] [-t threads] [--checkpoint-every N] "
+           "[--resume checkpoint] [--render-every N] <numFrames> "
+           "[inputfile]\n", argv[0]);
+    printf("       %s [-C] [-k] [-b broadphase] [-t workers] -m manifest\n",
+           argv[0]);
     printf("  -g : show graphics\n");
+    printf("  -b : line-pair search: brute, grid (default), quadtree, sweep, "
+           "bvh or auto\n");
+    printf("  -t : number of threads (default: all cores)\n");
+    printf("  -V : validate against the reference collision code\n");
+    printf("  -C : run the broad phase every frame instead of caching its "
+           "pairs\n");
+    printf("  -k : skip the collision work of frames on which no collision "
+           "can happen\n");
+    printf("  -w : write the input as a binary scene file and exit\n");
+    printf("  -s : write per-phase statistics of every frame to statsfile, "
+           "as JSON lines\n");
+    printf("  -m : run every job (\"<inputfile> <numFrames>\" per line) in "
+           "manifest, one job per worker thread at a time\n");
+    printf("  --checkpoint-every N : write a checkpoint every N frames, to "
+           "checkpoint-<frame>.ckpt\n");
+    printf("  --checkpoint-prefix P : name checkpoints P-<frame>.ckpt "
+           "instead\n");
+    printf("  --resume file : resume from a checkpoint, up to frame "
+           "numFrames\n");
+    printf("  --render-every N : draw every Nth frame offscreen, to "
+           "frame-<frame>.ppm\n");
+    printf("  --render-prefix P : name images P-<frame>.ppm instead\n");
+    printf("  --render-size WxH : draw W x H pixel images (default: the "
+           "window size, %ux%u)\n", WINDOW_WIDTH, WINDOW_HEIGHT);
+    printf("  inputfile may be a text (.in) or a binary scene file, or a "
+           "checkpoint\n");
     exit(-1);
   }
 
   numFrames = atoi(argv[1]);
   printf("Number of frames = %u\n", numFrames);
 
-  if (remaining_args > 1) {
+  if (resumePath != NULL) {
+    input_file_path = resumePath;
+  } else if (remaining_args > 1) {
     input_file_path = argv[2];
   } else {
     input_file_path = DEFAULT_INPUT_FILE_PATH;
   }
   printf("Input file path is: %s\n", input_file_path);
 
+  if (numThreads > 0) {
+#ifdef _OPENMP
+    omp_set_num_threads(numThreads);
+#else
+    if (numThreads > 1) {
+      fprintf(stderr, "The executable was not compiled with OpenMP; running "
+        "on a single thread...\n");
+    }
+#endif
+  }
+
+  // Open the statistics file, if asked for one.
+  FILE* statsFile = NULL;
+  CollisionStats* stats = NULL;
+  if (statsPath != NULL) {
+#if COLLISION_STATS
+    statsFile = fopen(statsPath, "w");
+    if (statsFile == NULL) {
+      perror(statsPath);
+      exit(-1);
+    }
+    stats = CollisionStats_new(statsFile);
+#else
+    fprintf(stderr, "The executable was compiled without statistics (STATS=0); "
+      "ignoring -s...\n");
+#endif
+  }
+
   // Create and initialize the Line simulation environment.
   LineDemo *lineDemo = LineDemo_new();
-  LineDemo_setInputFile(input_file_path);
-  LineDemo_initLine(lineDemo);
-  LineDemo_setNumFrames(lineDemo, numFrames);
+  LineDemo_setBroadPhase(lineDemo, broadPhase);
+  LineDemo_setPairCache(lineDemo, pairCacheFlag);
+  LineDemo_setKinetic(lineDemo, kineticFlag);
+  LineDemo_setStats(lineDemo, stats);
+  LineDemo_setInputFile(lineDemo, input_file_path);
 
-  const fasttime_t start_time = gettime();
-
-#ifndef PROFILE_BUILD
-  if (graphicDemoFlag) {
-    graphicMain(argc, argv, lineDemo, false);
+  // Every exit from here on goes through the cleanup below, so that the
+  // statistics summary is written and the statistics file closed.
+  int status = 0;
+  bool run = false;
+  bool simulated = false;
+  Raster* raster = NULL;
+  if (!LineDemo_initLine(lineDemo)) {
+    status = 1;
+  } else if (sceneOutputPath != NULL) {
+    if (LineDemo_writeScene(lineDemo, sceneOutputPath)) {
+      printf("Wrote %u lines to %s\n", LineDemo_getNumOfLines(lineDemo),
+             sceneOutputPath);
+    } else {
+      status = 1;
+    }
+  } else if (validateFlag) {
+    status = validate(lineDemo, broadPhase, pairCacheFlag, kineticFlag,
+                      numFrames);
+    simulated = true;
   } else {
-    lineMain(lineDemo);
+    LineDemo_setNumFrames(lineDemo, numFrames);
+    if (renderEvery != 0) {
+      raster = Raster_new(renderWidth, renderHeight);
+      if (raster == NULL) {
+        fprintf(stderr, "Out of memory for a %ux%u image\n", renderWidth,
+                renderHeight);
+        status = 1;
+      }
+    }
+    run = status == 0;
   }
+
+  if (run) {
+    const fasttime_t start_time = gettime();
+
+#ifndef PROFILE_BUILD
+    if (graphicDemoFlag) {
+      graphicMain(argc, argv, lineDemo, false);
+    } else if (!lineMain(lineDemo, checkpointEvery, checkpointPrefix,
+                         renderEvery, renderPrefix, raster)) {
+      status = 1;
+    }
 #else
-  if (graphicDemoFlag) {
-    fprintf(stderr, "The executable was not compiled with graphics enabled. Please "
-      "recompile with X11 to enable graphics; running non-GUI demo...\n");
-  }
-  lineMain(lineDemo);
+    if (graphicDemoFlag) {
+      fprintf(stderr, "The executable was not compiled with graphics enabled. Please "
+        "recompile with X11 to enable graphics; running non-GUI demo...\n");
+    }
+    if (!lineMain(lineDemo, checkpointEvery, checkpointPrefix, renderEvery,
+                  renderPrefix, raster)) {
+      status = 1;
+    }
 #endif
 
-  const fasttime_t end_time = gettime();
+    const fasttime_t end_time = gettime();
+    simulated = true;
 
-  // Output results.
-  printf("---- RESULTS ----\n");
-  printf("Elapsed execution time: %fs\n",
-         tdiff(start_time, end_time));
-  printf("%u Line-Wall Collisions\n",
-         LineDemo_getNumLineWallCollisions(lineDemo));
-  printf("%u Line-Line Collisions\n",
-         LineDemo_getNumLineLineCollisions(lineDemo));
-  printf("---- END RESULTS ----\n");
+    // Output results.
+    printf("---- RESULTS ----\n");
+    printf("Elapsed execution time: %fs\n",
+           tdiff(start_time, end_time));
+    printf("%u Line-Wall Collisions\n",
+           LineDemo_getNumLineWallCollisions(lineDemo));
+    printf("%u Line-Line Collisions\n",
+           LineDemo_getNumLineLineCollisions(lineDemo));
+    printf("%llu Line Pairs Tested\n", LineDemo_getNumPairsTested(lineDemo));
+    if (kineticFlag) {
+      printf("%llu Quiet Frames\n", LineDemo_getNumQuietFrames(lineDemo));
+    }
+    printf("---- END RESULTS ----\n");
+  }
+  if (simulated && stats != NULL) {
+    printf("---- STATS ----\n");
+    CollisionStats_print(stats, stdout);
+    printf("---- END STATS ----\n");
+  }
 
   // delete objects
   LineDemo_delete(lineDemo);
+  Raster_delete(raster);
+  CollisionStats_delete(stats);
+  if (statsFile != NULL) {
+    fclose(statsFile);
+  }
 
-  return 0;
+  return status;
 }
@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2012 the Massachusetts Institute of Technology
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "sweep_and_prune.h"
+
+// Returns true if endpoint a sorts strictly before endpoint b.
+static inline bool SweepEndpoint_less(const SweepEndpoint* a,
+                                      const SweepEndpoint* b) {
+  return a->value < b->value
+      || (a->value == b->value && (a->key & 1) < (b->key & 1));
+}
+
+// qsort comparator for endpoints.
+static int SweepEndpoint_compare(const void* a, const void* b) {
+  if (SweepEndpoint_less(a, b)) {
+    return -1;
+  }
+  return SweepEndpoint_less(b, a) ? 1 : 0;
+}
+
+// (Re)allocates the per-line arrays for numOfLines lines and lays the
+// endpoints out in line order.  Returns false if memory ran out.
+static bool SweepAndPrune_reset(SweepAndPrune* sweepAndPrune,
+                                const unsigned int numOfLines) {
+  free(sweepAndPrune->endpoints);
+  free(sweepAndPrune->active);
+  free(sweepAndPrune->activeIndex);
+  sweepAndPrune->endpoints = malloc(2 * numOfLines * sizeof(SweepEndpoint));
+  sweepAndPrune->active = malloc(numOfLines * sizeof(unsigned int));
+  sweepAndPrune->activeIndex = malloc(numOfLines * sizeof(unsigned int));
+  if (sweepAndPrune->endpoints == NULL || sweepAndPrune->active == NULL
+      || sweepAndPrune->activeIndex == NULL) {
+    sweepAndPrune->numOfLines = 0;
+    return false;
+  }
+
+  for (unsigned int k = 0; k < 2 * numOfLines; k++) {
+    sweepAndPrune->endpoints[k].key = k;
+  }
+  sweepAndPrune->numOfLines = numOfLines;
+  return true;
+}
+
+SweepAndPrune* SweepAndPrune_new() {
+  SweepAndPrune* sweepAndPrune = malloc(sizeof(SweepAndPrune));
+  if (sweepAndPrune == NULL) {
+    return NULL;
+  }
+
+  sweepAndPrune->endpoints = NULL;
+  sweepAndPrune->numOfLines = 0;
+  sweepAndPrune->active = NULL;
+  sweepAndPrune->activeIndex = NULL;
+  return sweepAndPrune;
+}
+
+void SweepAndPrune_delete(SweepAndPrune* sweepAndPrune) {
+  if (sweepAndPrune == NULL) {
+    return;
+  }
+  free(sweepAndPrune->endpoints);
+  free(sweepAndPrune->active);
+  free(sweepAndPrune->activeIndex);
+  free(sweepAndPrune);
+}
+
+bool SweepAndPrune_findCandidates(SweepAndPrune* sweepAndPrune,
+                                  const SweptBox* boxes,
+                                  const unsigned int numOfLines,
+                                  CandidateList* candidates) {
+  const bool coherent = numOfLines == sweepAndPrune->numOfLines;
+  if (!coherent && !SweepAndPrune_reset(sweepAndPrune, numOfLines)) {
+    return false;
+  }
+
+  SweepEndpoint* endpoints = sweepAndPrune->endpoints;
+  const unsigned int numEndpoints = 2 * numOfLines;
+
+  // Refresh the endpoints in place, then repair last frame's order with an
+  // insertion sort, which costs O(n + number of swaps).  Without a previous
+  // frame there is no order to repair, so sort from scratch.
+  for (unsigned int k = 0; k < numEndpoints; k++) {
+    const SweptBox* box = &boxes[endpoints[k].key >> 1];
+    endpoints[k].value = (endpoints[k].key & 1) ? box->xmax : box->xmin;
+  }
+  if (!coherent) {
+    qsort(endpoints, numEndpoints, sizeof(SweepEndpoint),
+          SweepEndpoint_compare);
+  }
+  for (unsigned int k = 1; k < numEndpoints; k++) {
+    const SweepEndpoint endpoint = endpoints[k];
+    unsigned int m = k;
+    while (m > 0 && SweepEndpoint_less(&endpoint, &endpoints[m - 1])) {
+      endpoints[m] = endpoints[m - 1];
+      m--;
+    }
+    endpoints[m] = endpoint;
+  }
+
+  // Sweep from left to right.  When a box's interval opens, it overlaps in x
+  // exactly the boxes whose intervals are open, so only y remains to check.
+  unsigned int* active = sweepAndPrune->active;
+  unsigned int* activeIndex = sweepAndPrune->activeIndex;
+  unsigned int numActive = 0;
+  for (unsigned int k = 0; k < numEndpoints; k++) {
+    const unsigned int i = endpoints[k].key >> 1;
+    if (endpoints[k].key & 1) {
+      // Close the interval; move the last active line into its slot.
+      const unsigned int last = active[--numActive];
+      active[activeIndex[i]] = last;
+      activeIndex[last] = activeIndex[i];
+      continue;
+    }
+
+    const SweptBox* box = &boxes[i];
+    for (unsigned int a = 0; a < numActive; a++) {
+      const unsigned int j = active[a];
+      if (box->ymin <= boxes[j].ymax && boxes[j].ymin <= box->ymax) {
+        CandidateList_append(candidates, i, j);
+      }
+    }
+    activeIndex[i] = numActive;
+    active[numActive++] = i;
+  }
+  assert(numActive == 0);
+  return !candidates->overflowed;
+}
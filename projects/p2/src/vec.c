@@ -20,6 +20,7 @@
  * SOFTWARE.
  **/
 
+#include <float.h>
 #include <math.h>
 
 #include "line.h"
@@ -62,6 +63,44 @@ double Vec_angle(Vec vector1, Vec vector2) {
   return Vec_argument(vector1) - Vec_argument(vector2);
 }
 
+// Bound, in units of DBL_EPSILON, on the angle below which
+// Vec_compareArguments falls back to the sign of Vec_angle.
+#ifndef ARGUMENT_TOLERANCE
+#define ARGUMENT_TOLERANCE 16
+#endif
+
+// Returns the sign (-1, 0 or 1) of Vec_angle(vector1, vector2).
+static int Vec_compareArgumentsRounded(Vec vector1, Vec vector2) {
+  const double angle = Vec_angle(vector1, vector2);
+  return (angle > 0) - (angle < 0);
+}
+
+int Vec_compareArguments(Vec vector1, Vec vector2) {
+  // atan2 maps vectors with the sign bit of y set to [-pi, -0], and the rest
+  // to [+0, pi].
+  const bool lower1 = signbit(vector1.y);
+  const bool lower2 = signbit(vector2.y);
+  if (lower1 != lower2) {
+    // The difference of arguments from opposite half-planes cannot round to
+    // zero unless both vectors lie on the x axis.
+    if (vector1.y != 0 || vector2.y != 0) {
+      return lower1 ? -1 : 1;
+    }
+    return Vec_compareArgumentsRounded(vector1, vector2);
+  }
+  // Within a half-plane, the argument grows counterclockwise.  When the angle
+  // between the vectors is within the rounding error of atan2 and of the
+  // cross product, including parallel vectors, the sign of the rounded
+  // difference decides instead.
+  const vec_dimension cross = Vec_crossProduct(vector1, vector2);
+  const vec_dimension tolerance = ARGUMENT_TOLERANCE * DBL_EPSILON;
+  if (cross * cross <= tolerance * tolerance
+      * Vec_dotProduct(vector1, vector1) * Vec_dotProduct(vector2, vector2)) {
+    return Vec_compareArgumentsRounded(vector1, vector2);
+  }
+  return cross > 0 ? -1 : 1;
+}
+
 vec_dimension Vec_component(Vec vector1, Vec vector2) {
   return Vec_length(vector1) * cos(Vec_angle(vector1, vector2));
 }
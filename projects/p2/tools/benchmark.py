@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+
+"""Collision scaling benchmark for the screensaver.
+
+Runs the screensaver with each engine (broad phase) over a grid of generated
+scenes (distribution x line count x seed), and reports frames per second,
+line pairs tested per frame and collision events per frame, as CSV or JSON
+lines on stdout.  Scenes are generated with gen_scene.py into --scene-dir and
+reused by later runs.  Usage, from projects/p2:
+
+  tools/benchmark.py --counts 1000,10000,100000 --engines grid,sweep
+"""
+
+import argparse
+import csv
+import json
+import os
+import re
+import subprocess
+import sys
+
+import gen_scene
+
+# -b broad phase and extra flags for every engine.
+ENGINES = {
+    'brute': ['-b', 'brute'],
+    'grid': ['-b', 'grid'],
+    'grid-nocache': ['-b', 'grid', '-C'],
+    'quadtree': ['-b', 'quadtree'],
+    'sweep': ['-b', 'sweep'],
+    'bvh': ['-b', 'bvh'],
+    'auto': ['-b', 'auto'],
+}
+
+FIELDS = ('distribution', 'lines', 'seed', 'engine', 'frames', 'seconds',
+          'frames_per_sec', 'pairs_per_frame', 'line_line_per_frame',
+          'line_wall_per_frame')
+
+RESULT_PATTERNS = {
+    'seconds': r'Elapsed execution time: ([0-9.]+)s',
+    'line_wall': r'(\d+) Line-Wall Collisions',
+    'line_line': r'(\d+) Line-Line Collisions',
+    'pairs': r'(\d+) Line Pairs Tested',
+}
+
+
+def comma_list(text):
+    return [item for item in text.split(',') if item]
+
+
+def scene_path(scene_dir, distribution, lines, seed):
+    return os.path.join(scene_dir, '%s-%d-%d.scn' % (distribution, lines, seed))
+
+
+def run(screensaver, engine, frames, scene, threads):
+    """Runs one simulation and returns the parsed results."""
+    command = [screensaver] + ENGINES[engine]
+    if threads:
+        command += ['-t', str(threads)]
+    command += [str(frames), scene]
+    output = subprocess.run(command, stdout=subprocess.PIPE, check=True,
+                            universal_newlines=True).stdout
+    results = {}
+    for name, pattern in RESULT_PATTERNS.items():
+        match = re.search(pattern, output)
+        if match is None:
+            raise RuntimeError('no %s in the output of %s'
+                               % (name, ' '.join(command)))
+        results[name] = float(match.group(1))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__.split('\n')[0])
+    parser.add_argument('--distributions', type=comma_list,
+                        default=list(gen_scene.DISTRIBUTIONS),
+                        help='comma-separated (default: all)')
+    parser.add_argument('--counts', type=comma_list,
+                        default=['1000', '10000', '100000'],
+                        help='comma-separated line counts (default: '
+                             '1000,10000,100000)')
+    parser.add_argument('--seeds', type=comma_list, default=['0'],
+                        help='comma-separated (default: 0)')
+    parser.add_argument('--engines', type=comma_list,
+                        default=['grid', 'quadtree', 'sweep', 'bvh'],
+                        help='comma-separated, from %s (default: '
+                             'grid,quadtree,sweep,bvh)'
+                             % ','.join(sorted(ENGINES)))
+    parser.add_argument('--frames', type=int, default=100,
+                        help='frames per run (default: 100)')
+    parser.add_argument('--threads', type=int, default=0,
+                        help='threads per run (default: all cores)')
+    parser.add_argument('--max-brute-lines', type=int, default=2000,
+                        help='skip brute force above this many lines')
+    parser.add_argument('--format', choices=('csv', 'json'), default='csv')
+    parser.add_argument('--scene-dir', default='bench_scenes')
+    parser.add_argument('--screensaver', default='./screensaver')
+    args = parser.parse_args()
+
+    for distribution in args.distributions:
+        if distribution not in gen_scene.DISTRIBUTIONS:
+            parser.error('unknown distribution: %s' % distribution)
+    for engine in args.engines:
+        if engine not in ENGINES:
+            parser.error('unknown engine: %s' % engine)
+    os.makedirs(args.scene_dir, exist_ok=True)
+
+    writer = None
+    if args.format == 'csv':
+        writer = csv.DictWriter(sys.stdout, fieldnames=FIELDS)
+        writer.writeheader()
+    for distribution in args.distributions:
+        for lines in map(int, args.counts):
+            for seed in map(int, args.seeds):
+                scene = scene_path(args.scene_dir, distribution, lines, seed)
+                if not os.path.exists(scene):
+                    gen_scene.write_scene(scene, distribution, lines,
+                                          seed=seed)
+                for engine in args.engines:
+                    if engine == 'brute' and lines > args.max_brute_lines:
+                        continue
+                    results = run(args.screensaver, engine, args.frames, scene,
+                                  args.threads)
+                    # The screensaver simulates one frame more than asked.
+                    frames = args.frames + 1
+                    row = {
+                        'distribution': distribution,
+                        'lines': lines,
+                        'seed': seed,
+                        'engine': engine,
+                        'frames': frames,
+                        'seconds': results['seconds'],
+                        'frames_per_sec': round(frames / results['seconds'], 2),
+                        'pairs_per_frame': round(results['pairs'] / frames, 1),
+                        'line_line_per_frame':
+                            round(results['line_line'] / frames, 2),
+                        'line_wall_per_frame':
+                            round(results['line_wall'] / frames, 2),
+                    }
+                    if writer is not None:
+                        writer.writerow(row)
+                    else:
+                        print(json.dumps(row))
+                    sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
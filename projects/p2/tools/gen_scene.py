@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+
+"""Synthetic scene generator for the screensaver.
+
+Writes a scene of randomly placed lines, either in the text (.in) format or,
+for any other extension, in the binary scene format described in
+include/scene.h.  Scenes are deterministic: the same arguments and seed always
+give the same file.
+
+Distributions:
+  uniform    lines anywhere in the window, moving in random directions
+  clustered  lines in Gaussian clusters around random centers
+  explosion  lines near the center of the window, flying outwards
+  stripes    bands of vertical lines, alternate bands moving left and right
+  gas        lines packed into the middle quarter of the window, with
+             Gaussian velocities
+
+Lengths and speeds are in pixels and pixels per time step of the 1180x800
+window, as in the text format.  Usage:
+
+  tools/gen_scene.py -d clustered -n 100000 --seed 7 scenes/clustered.scn
+"""
+
+import argparse
+import math
+import random
+import struct
+import sys
+from array import array
+
+# Keep these in sync with include/line.h and include/scene.h.
+WINDOW_WIDTH = 1180
+WINDOW_HEIGHT = 800
+BOX_MIN = 0.5
+BOX_SIZE = 1.0 - 0.5
+SCENE_MAGIC = b'LSCN'
+SCENE_VERSION = 1
+
+DISTRIBUTIONS = ('uniform', 'clustered', 'explosion', 'stripes', 'gas')
+LENGTHS = ('fixed', 'uniform', 'exponential')
+
+# Lines keep this far from the walls, in pixels.
+MARGIN = 1.0
+
+# Standard deviation of a cluster, and radius of the explosion, in pixels.
+CLUSTER_SIGMA = 0.08 * WINDOW_WIDTH
+EXPLOSION_RADIUS = 0.2 * WINDOW_HEIGHT
+
+# Roughly the fraction of the window each distribution starts out covering.
+COVERAGE = {
+    'uniform': 1.0,
+    'clustered': 8 * 2 * math.pi * CLUSTER_SIGMA ** 2
+                 / (WINDOW_WIDTH * WINDOW_HEIGHT),
+    'explosion': math.pi * EXPLOSION_RADIUS ** 2
+                 / (WINDOW_WIDTH * WINDOW_HEIGHT),
+    'stripes': 1.0,
+    'gas': 0.25,
+}
+
+
+def default_mean_length(distribution, num_lines):
+    """A length that keeps the lines from overlapping much at any count."""
+    area = COVERAGE[distribution] * WINDOW_WIDTH * WINDOW_HEIGHT
+    return min(50.0, 0.5 * math.sqrt(area / num_lines))
+
+
+def draw_length(rng, kind, mean):
+    if kind == 'fixed':
+        return mean
+    if kind == 'uniform':
+        return rng.uniform(0.5 * mean, 1.5 * mean)
+    return min(max(rng.expovariate(1.0 / mean), 0.1 * mean), 10.0 * mean)
+
+
+def clamp(value, low, high):
+    return min(max(value, low), high)
+
+
+def place(cx, cy, length, angle):
+    """Endpoints of a line centered near (cx, cy), moved inside the window."""
+    dx = 0.5 * length * math.cos(angle)
+    dy = 0.5 * length * math.sin(angle)
+    cx = clamp(cx, MARGIN + abs(dx), WINDOW_WIDTH - MARGIN - abs(dx))
+    cy = clamp(cy, MARGIN + abs(dy), WINDOW_HEIGHT - MARGIN - abs(dy))
+    return cx - dx, cy - dy, cx + dx, cy + dy
+
+
+def random_velocity(rng, speed):
+    angle = rng.uniform(0, 2 * math.pi)
+    magnitude = rng.uniform(0, speed)
+    return magnitude * math.cos(angle), magnitude * math.sin(angle)
+
+
+def generate(distribution, num_lines, length_kind, mean_length, speed, seed):
+    """Yields (x1, y1, x2, y2, vx, vy, color) for every line, in pixels."""
+    rng = random.Random('%s/%d/%d' % (distribution, num_lines, seed))
+    centers = [(rng.uniform(0, WINDOW_WIDTH), rng.uniform(0, WINDOW_HEIGHT))
+               for _ in range(8)]
+    band_height = max(1.2 * mean_length, 2 * MARGIN)
+    num_bands = max(1, int(WINDOW_HEIGHT / band_height))
+
+    for i in range(num_lines):
+        length = draw_length(rng, length_kind, mean_length)
+        angle = rng.uniform(0, math.pi)
+        if distribution == 'uniform':
+            cx = rng.uniform(0, WINDOW_WIDTH)
+            cy = rng.uniform(0, WINDOW_HEIGHT)
+            vx, vy = random_velocity(rng, speed)
+        elif distribution == 'clustered':
+            cx, cy = centers[rng.randrange(len(centers))]
+            cx = rng.gauss(cx, CLUSTER_SIGMA)
+            cy = rng.gauss(cy, CLUSTER_SIGMA)
+            vx, vy = random_velocity(rng, speed)
+        elif distribution == 'explosion':
+            radius = EXPLOSION_RADIUS * math.sqrt(rng.random())
+            direction = rng.uniform(0, 2 * math.pi)
+            cx = 0.5 * WINDOW_WIDTH + radius * math.cos(direction)
+            cy = 0.5 * WINDOW_HEIGHT + radius * math.sin(direction)
+            magnitude = speed * rng.uniform(0.5, 1.0)
+            vx = magnitude * math.cos(direction)
+            vy = magnitude * math.sin(direction)
+            angle = direction + 0.5 * math.pi
+        elif distribution == 'stripes':
+            band = rng.randrange(num_bands)
+            cx = rng.uniform(0, WINDOW_WIDTH)
+            cy = (band + 0.5) * WINDOW_HEIGHT / num_bands
+            vx, vy = (speed if band % 2 == 0 else -speed), 0.0
+            angle = 0.5 * math.pi
+        else:  # gas
+            cx = rng.uniform(0.25, 0.75) * WINDOW_WIDTH
+            cy = rng.uniform(0.25, 0.75) * WINDOW_HEIGHT
+            vx = rng.gauss(0, speed)
+            vy = rng.gauss(0, speed)
+        x1, y1, x2, y2 = place(cx, cy, length, angle)
+        yield x1, y1, x2, y2, vx, vy, rng.randrange(2)
+
+
+def quantize(value):
+    """Rounds a value as the text format does, so both formats agree."""
+    return float('%f' % value)
+
+
+def write_text(path, lines):
+    with open(path, 'w') as out:
+        out.write('%d\n' % len(lines))
+        for x1, y1, x2, y2, vx, vy, color in lines:
+            out.write('(%f, %f), (%f, %f), %f, %f, %d\n'
+                      % (x1, y1, x2, y2, vx, vy, color))
+
+
+def write_binary(path, lines):
+    # Same conversions as windowToBox and velocityWindowToBox in line.h.
+    columns = [array('d') for _ in range(6)]
+    colors = bytearray()
+    for x1, y1, x2, y2, vx, vy, color in lines:
+        columns[0].append(quantize(x1) / WINDOW_WIDTH * BOX_SIZE + BOX_MIN)
+        columns[1].append(quantize(y1) / WINDOW_HEIGHT * BOX_SIZE + BOX_MIN)
+        columns[2].append(quantize(x2) / WINDOW_WIDTH * BOX_SIZE + BOX_MIN)
+        columns[3].append(quantize(y2) / WINDOW_HEIGHT * BOX_SIZE + BOX_MIN)
+        columns[4].append(quantize(vx) / WINDOW_WIDTH * BOX_SIZE)
+        columns[5].append(quantize(vy) / WINDOW_HEIGHT * BOX_SIZE)
+        colors.append(color)
+    if sys.byteorder != 'little':
+        for column in columns:
+            column.byteswap()
+    with open(path, 'wb') as out:
+        out.write(SCENE_MAGIC + struct.pack('<III', SCENE_VERSION, len(lines),
+                                            0))
+        for column in columns:
+            column.tofile(out)
+        out.write(colors)
+
+
+def write_scene(path, distribution, num_lines, length_kind='uniform',
+                mean_length=None, speed=1.0, seed=0):
+    """Generates a scene and writes it to path; see the module docstring."""
+    if mean_length is None:
+        mean_length = default_mean_length(distribution, num_lines)
+    lines = list(generate(distribution, num_lines, length_kind, mean_length,
+                          speed, seed))
+    if path.endswith('.in'):
+        write_text(path, lines)
+    else:
+        write_binary(path, lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__.split('\n')[0],
+        epilog='Writes text if output ends in .in, and a binary scene '
+               'otherwise.')
+    parser.add_argument('output', help='file to write')
+    parser.add_argument('-d', '--distribution', choices=DISTRIBUTIONS,
+                        default='uniform')
+    parser.add_argument('-n', '--lines', type=int, default=1000,
+                        help='number of lines (default: 1000)')
+    parser.add_argument('--length', choices=LENGTHS, default='uniform',
+                        help='distribution of line lengths (default: uniform '
+                             'in [0.5, 1.5] times the mean)')
+    parser.add_argument('--mean-length', type=float, default=None,
+                        help='mean line length in pixels (default: half the '
+                             'initial mean spacing between lines, at most '
+                             '50)')
+    parser.add_argument('--speed', type=float, default=1.0,
+                        help='line speed in pixels per time step (default: 1)')
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+    if args.lines < 1:
+        parser.error('a scene needs at least one line')
+    write_scene(args.output, args.distribution, args.lines, args.length,
+                args.mean_length, args.speed, args.seed)
+
+
+if __name__ == '__main__':
+    main()